@@ -25,6 +25,7 @@ from datetime import datetime
 from pathlib import Path
 sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
 from hierarchical_predictor import load_hierarchical_predictor
+from import_generation import bump_import_generation
 
 warnings.filterwarnings('ignore')
 
@@ -495,6 +496,8 @@ def run_auto_classify(candidate_file, db_name, threshold, resume=False):
             break
     
     client.close()
+    if total_updated > 0:
+        bump_import_generation(db_name)
     
     # Save results
     result_file = candidate_file.replace('.csv', '_results.json')
@@ -20,6 +20,7 @@ from functools import partial
 from datetime import datetime
 sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
 from hierarchical_predictor import load_hierarchical_predictor
+from import_generation import bump_import_generation
 
 warnings.filterwarnings('ignore')
 
@@ -406,6 +407,8 @@ def run_web_mode(input_file, output_file, db_name, host, port, threshold):
         update_progress(pct, f"Writing: {i+1}/{feat_total}, Updated {updated_count}", "classify")
     
     client.close()
+    if updated_count > 0:
+        bump_import_generation(db_name)
     
     high_conf_count = sum(1 for r in results if r.get('status') == 'high_confidence')
     
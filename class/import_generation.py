@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+"""
+Import generation counter shared with the C++ tools (include/tdlight/query_cache.h).
+
+Each database has a counter in /tmp/tdlight_import_gen_<db>. Writers bump it
+after changing the data; the web server drops cached query results and reloads
+its object catalog when it changes.
+"""
+
+import fcntl
+import re
+
+
+def import_generation_path(db_name):
+    """Counter file of a database; characters outside [A-Za-z0-9_] become '_'"""
+    safe = re.sub(r"[^A-Za-z0-9_]", "_", db_name or "") or "_"
+    return f"/tmp/tdlight_import_gen_{safe}"
+
+
+def bump_import_generation(db_name):
+    """Bump the database's import generation so cached query results are dropped"""
+    try:
+        with open(import_generation_path(db_name), "a+") as f:
+            fcntl.flock(f, fcntl.LOCK_EX)
+            f.seek(0)
+            text = f.read().strip()
+            f.seek(0)
+            f.truncate()
+            f.write(f"{int(text) + 1 if text else 1}\n")
+    except (OSError, ValueError) as e:
+        print(f"[WARN] Cannot bump import generation of {db_name}: {e}")
@@ -0,0 +1,129 @@
+/**
+ * @file async_query.h
+ * @brief Asynchronous TDengine queries (taos_query_a / taos_fetch_rows_a).
+ *
+ * taos_query() blocks the calling thread until the first block is ready,
+ * so one connection can only serve one query at a time. query_async()
+ * submits the statement and returns immediately; the TDengine client
+ * thread then delivers each block to a handler, and the returned future
+ * resolves once the result set is exhausted. Many queries can be in
+ * flight on a single connection this way.
+ *
+ * Typical use:
+ *
+ *   auto f = tdlight::query_async(conn, sql,
+ *       [&](tdlight::ResultReader& reader, int rows) { ... });
+ *   tdlight::AsyncResult r = f.get();
+ *   if (r.code != 0) { ... r.error ... }
+ *
+ * Handlers run on a TDengine client thread. Handlers of different
+ * queries may run concurrently, so each query should write to its own
+ * output.
+ */
+
+#ifndef TDLIGHT_ASYNC_QUERY_H
+#define TDLIGHT_ASYNC_QUERY_H
+
+#include <string>
+#include <future>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <taos.h>
+#include "result_reader.h"
+
+namespace tdlight {
+
+/** Called once per fetched block; reader.column()/str() address it. */
+using BlockHandler = std::function<void(ResultReader& reader, int rows)>;
+
+/** Outcome of one asynchronous query. */
+struct AsyncResult {
+    int code = 0;                     // 0 on success
+    std::string error;
+    long long rows = 0;               // rows delivered to the handler
+    double first_block_ms = 0;        // submit -> query callback
+    double total_ms = 0;              // submit -> last block handled
+};
+
+namespace detail {
+
+struct AsyncQueryState {
+    BlockHandler handler;
+    std::promise<AsyncResult> promise;
+    std::unique_ptr<ResultReader> reader;
+    AsyncResult result;
+    std::chrono::steady_clock::time_point start;
+
+    double elapsed_ms() const {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Resolve the future and free the state (and with it the result set)
+inline void finish_async(AsyncQueryState* state, int code, const std::string& error) {
+    state->result.code = code;
+    state->result.error = error;
+    state->result.total_ms = state->elapsed_ms();
+    state->promise.set_value(state->result);
+    delete state;
+}
+
+inline void on_async_fetch(void* param, TAOS_RES* res, int num_rows) {
+    auto* state = static_cast<AsyncQueryState*>(param);
+    if (num_rows < 0) {
+        const char* msg = taos_errstr(res);
+        finish_async(state, num_rows, msg ? msg : "fetch failed");
+        return;
+    }
+    if (num_rows == 0) {
+        finish_async(state, 0, "");
+        return;
+    }
+
+    state->reader->attach_block(num_rows);
+    try {
+        state->handler(*state->reader, num_rows);
+    } catch (const std::exception& e) {
+        finish_async(state, -1, e.what());
+        return;
+    }
+    state->result.rows += num_rows;
+    taos_fetch_rows_a(res, on_async_fetch, state);
+}
+
+inline void on_async_query(void* param, TAOS_RES* res, int code) {
+    auto* state = static_cast<AsyncQueryState*>(param);
+    state->result.first_block_ms = state->elapsed_ms();
+    state->reader.reset(new ResultReader(res));
+    if (code != 0 || !state->reader->ok()) {
+        std::string error = state->reader->error();
+        finish_async(state, code != 0 ? code : state->reader->error_code(),
+                     error.empty() ? "query failed" : error);
+        return;
+    }
+    taos_fetch_rows_a(res, on_async_fetch, state);
+}
+
+} // namespace detail
+
+/**
+ * Submit @p sql on @p conn without blocking.
+ * @p on_block receives every block of the result; the future resolves
+ * after the last one (or on the first error).
+ */
+inline std::future<AsyncResult> query_async(TAOS* conn, const std::string& sql,
+                                            BlockHandler on_block) {
+    auto* state = new detail::AsyncQueryState();
+    state->handler = std::move(on_block);
+    state->start = std::chrono::steady_clock::now();
+    std::future<AsyncResult> future = state->promise.get_future();
+    taos_query_a(conn, sql.c_str(), detail::on_async_query, state);
+    return future;
+}
+
+} // namespace tdlight
+
+#endif // TDLIGHT_ASYNC_QUERY_H
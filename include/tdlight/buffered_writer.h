@@ -0,0 +1,118 @@
+/**
+ * @file buffered_writer.h
+ * @brief Large-buffer text writer with std::to_chars number formatting.
+ *
+ * ostream formatting goes through locale and precision state for every
+ * value. BufferedWriter appends into one contiguous buffer with
+ * std::to_chars and hands full buffers to a sink (a file, a socket, ...),
+ * so writing N rows costs O(1) memory and no per-value allocation.
+ */
+
+#ifndef TDLIGHT_BUFFERED_WRITER_H
+#define TDLIGHT_BUFFERED_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+namespace tdlight {
+
+class BufferedWriter {
+public:
+    /** Receives each full buffer; returns false on a write error. */
+    using Sink = std::function<bool(const char* data, size_t size)>;
+
+    explicit BufferedWriter(Sink sink, size_t capacity = 1 << 20)
+        : sink_(std::move(sink)), buf_(capacity < 4096 ? 4096 : capacity) {}
+
+    /** Write to a stdio stream (not closed by the writer). */
+    explicit BufferedWriter(FILE* file, size_t capacity = 1 << 20)
+        : BufferedWriter([file](const char* data, size_t size) {
+              return std::fwrite(data, 1, size, file) == size;
+          }, capacity) {}
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    ~BufferedWriter() { flush(); }
+
+    BufferedWriter& put(char c) {
+        if (pos_ == buf_.size()) flush();
+        buf_[pos_++] = c;
+        return *this;
+    }
+
+    BufferedWriter& put(std::string_view s) {
+        if (s.size() > buf_.size() - pos_) {
+            flush();
+            if (s.size() > buf_.size()) {
+                emit(s.data(), s.size());
+                return *this;
+            }
+        }
+        std::memcpy(buf_.data() + pos_, s.data(), s.size());
+        pos_ += s.size();
+        return *this;
+    }
+
+    BufferedWriter& put_int(int64_t v) {
+        reserve(24);
+        pos_ = std::to_chars(buf_.data() + pos_, buf_.data() + buf_.size(), v).ptr - buf_.data();
+        return *this;
+    }
+
+    /** Fixed notation with @p precision digits after the point. */
+    BufferedWriter& put_fixed(double v, int precision) {
+        reserve(400);
+        auto r = std::to_chars(buf_.data() + pos_, buf_.data() + buf_.size(), v,
+                               std::chars_format::fixed, precision);
+        pos_ = r.ptr - buf_.data();
+        return *this;
+    }
+
+    /** Shortest representation that round-trips (for JSON, ...). */
+    BufferedWriter& put_double(double v) {
+        reserve(32);
+        pos_ = std::to_chars(buf_.data() + pos_, buf_.data() + buf_.size(), v).ptr - buf_.data();
+        return *this;
+    }
+
+    /** Hand buffered bytes to the sink. */
+    bool flush() {
+        if (pos_ > 0) {
+            emit(buf_.data(), pos_);
+            pos_ = 0;
+        }
+        return ok_;
+    }
+
+    bool ok() const { return ok_; }
+
+    /** Bytes handed to the sink plus bytes still buffered. */
+    uint64_t bytes_written() const { return written_ + pos_; }
+
+private:
+    void reserve(size_t n) {
+        if (buf_.size() - pos_ < n) flush();
+    }
+
+    void emit(const char* data, size_t size) {
+        if (ok_ && !sink_(data, size)) ok_ = false;
+        written_ += size;
+    }
+
+    Sink sink_;
+    std::vector<char> buf_;
+    size_t pos_ = 0;
+    uint64_t written_ = 0;
+    bool ok_ = true;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_BUFFERED_WRITER_H
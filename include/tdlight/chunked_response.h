@@ -0,0 +1,198 @@
+/**
+ * @file chunked_response.h
+ * @brief HTTP/1.1 response streamed to a socket with chunked encoding.
+ *
+ * Building a large JSON body in a string before sending it holds the
+ * whole result twice and delays the first byte until the last row has
+ * been fetched. A ChunkedResponse hands out a BufferedWriter whose full
+ * buffers go out as "Transfer-Encoding: chunked" chunks, so rows can be
+ * serialized straight from a fetch loop in O(buffer) memory. A body that
+ * never fills the buffer is sent as an ordinary Content-Length response.
+ * With gzip enabled, chunks are compressed as one gzip stream (bodies
+ * under kGzipMinBytes are sent as they are).
+ *
+ * Typical use (socket in blocking mode, HTTP/1.1 client):
+ *
+ *   tdlight::ChunkedResponse stream(fd, keep_alive, http_accepts_gzip(request));
+ *   tdlight::BufferedWriter& out = stream.begin("application/json");
+ *   ... out.put(...) for each row ...
+ *   if (!stream.finish()) ... client went away, close the socket ...
+ */
+
+#ifndef TDLIGHT_CHUNKED_RESPONSE_H
+#define TDLIGHT_CHUNKED_RESPONSE_H
+
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "buffered_writer.h"
+#include "http_compress.h"
+
+namespace tdlight {
+
+class ChunkedResponse {
+public:
+    ChunkedResponse(int fd, bool keep_alive, bool gzip = false, size_t capacity = 64 << 10)
+        : fd_(fd), keep_alive_(keep_alive), gzip_(gzip), capacity_(capacity) {}
+
+    ChunkedResponse(const ChunkedResponse&) = delete;
+    ChunkedResponse& operator=(const ChunkedResponse&) = delete;
+
+    /** Start a 200 response with @p content_type; call once. */
+    BufferedWriter& begin(const std::string& content_type) {
+        content_type_ = content_type;
+        gzip_ = gzip_ && http_compressible(content_type);
+        writer_ = std::make_unique<BufferedWriter>(
+            [this](const char* data, size_t size) { return send_chunk(data, size); }, capacity_);
+        return *writer_;
+    }
+
+    bool started() const { return writer_ != nullptr; }
+
+    /** Send what is buffered and end the body; false if the client went away. */
+    bool finish() {
+        if (!writer_ || finished_) return ok_;
+        finished_ = true;
+        writer_->flush();
+        if (!headers_sent_) {
+            send_chunk("", 0);
+        } else if (chunked_) {
+            if (encoder_) {
+                std::string tail;
+                ok_ = ok_ && encoder_->write(nullptr, 0, tail, true) && send_framed("", tail.data(), tail.size());
+            }
+            iovec end{const_cast<char*>("0\r\n\r\n"), 5};
+            ok_ = ok_ && send_all(&end, 1);
+        }
+        return ok_;
+    }
+
+    /**
+     * Give up on a started response: nothing more is sent, in particular
+     * not the terminating chunk, so the client cannot mistake a truncated
+     * body for a complete one. finish() then returns false and the
+     * connection must be closed.
+     */
+    void abort() {
+        aborted_ = true;
+        finished_ = true;
+        ok_ = false;
+    }
+
+    bool aborted() const { return aborted_; }
+
+    /**
+     * Drop a started response whose headers have not gone out yet (the
+     * body still fits in the buffer), so the caller can send an error
+     * response instead. False if it is too late for that.
+     */
+    bool discard() {
+        if (headers_sent_) return false;
+        ok_ = false;            // the writer's final flush sends nothing
+        writer_.reset();
+        ok_ = true;
+        finished_ = false;
+        return true;
+    }
+
+    /** Body bytes produced so far. */
+    uint64_t bytes() const { return writer_ ? writer_->bytes_written() : 0; }
+
+private:
+    std::string headers(const std::string& framing, bool gzip) const {
+        return "HTTP/1.1 200 OK\r\n"
+               "Content-Type: " + content_type_ + "\r\n"
+               "Access-Control-Allow-Origin: *\r\n" +
+               (gzip ? "Content-Encoding: gzip\r\n" : "") +
+               (gzip_ ? "Vary: Accept-Encoding\r\n" : "") + framing + "\r\n"
+               "Connection: " + (keep_alive_ ? "keep-alive" : "close") + "\r\n"
+               "\r\n";
+    }
+
+    bool send_chunk(const char* data, size_t size) {
+        if (!ok_) return false;
+        std::string head;
+        if (!headers_sent_) {
+            headers_sent_ = true;
+            // Everything fits in one buffer: no need for chunked framing
+            if (finished_) {
+                std::string packed;
+                bool gzip = gzip_ && size >= kGzipMinBytes;
+                if (gzip) {
+                    packed = gzip_compress(std::string_view(data, size), Z_BEST_SPEED);
+                    data = packed.data();
+                    size = packed.size();
+                }
+                head = headers("Content-Length: " + std::to_string(size), gzip);
+                iovec iov[2] = {{&head[0], head.size()}, {const_cast<char*>(data), size}};
+                return ok_ = send_all(iov, 2);
+            }
+            chunked_ = true;
+            if (gzip_) encoder_ = std::make_unique<GzipEncoder>(Z_BEST_SPEED);
+            head = headers("Transfer-Encoding: chunked", gzip_);
+        }
+        if (encoder_) {
+            std::string packed;
+            if (!encoder_->write(data, size, packed)) return ok_ = false;
+            return ok_ = send_framed(head, packed.data(), packed.size());
+        }
+        return ok_ = send_framed(head, data, size);
+    }
+
+    // @p head (if any) followed by one chunk holding @p data
+    bool send_framed(std::string head, const char* data, size_t size) {
+        if (size == 0) {
+            iovec iov{&head[0], head.size()};
+            return head.empty() || send_all(&iov, 1);
+        }
+        char size_line[24];
+        int n = std::snprintf(size_line, sizeof(size_line), "%zx\r\n", size);
+        iovec iov[4] = {{&head[0], head.size()}, {size_line, static_cast<size_t>(n)},
+                        {const_cast<char*>(data), size}, {const_cast<char*>("\r\n"), 2}};
+        return send_all(iov, 4);
+    }
+
+    bool send_all(iovec* iov, int count) {
+        while (count > 0) {
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t sent = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            size_t left = static_cast<size_t>(sent);
+            while (count > 0 && left >= iov->iov_len) {
+                left -= iov->iov_len;
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+                iov->iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+    int fd_;
+    bool keep_alive_;
+    bool gzip_;
+    size_t capacity_;
+    std::string content_type_;
+    std::unique_ptr<BufferedWriter> writer_;
+    std::unique_ptr<GzipEncoder> encoder_;
+    bool headers_sent_ = false;
+    bool chunked_ = false;
+    bool finished_ = false;
+    bool aborted_ = false;
+    bool ok_ = true;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_CHUNKED_RESPONSE_H
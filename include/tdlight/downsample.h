@@ -0,0 +1,156 @@
+/**
+ * @file downsample.h
+ * @brief Shape-preserving downsampling of light curves for plotting.
+ *
+ * A chart a few hundred pixels wide cannot show more than a few hundred
+ * distinct points per series, so long light curves are reduced before
+ * they are sent. Both methods return indices into the input (sorted, no
+ * duplicates), so callers keep every column of the selected epochs:
+ *
+ *   lttb_indices()   - Largest-Triangle-Three-Buckets: one point per
+ *                      bucket, chosen to keep the visual shape.
+ *   minmax_indices() - brightest and faintest point per equal-time
+ *                      bucket: keeps every outburst and eclipse.
+ *
+ * downsample_groups() applies either method to each group (band) of an
+ * interleaved series.
+ */
+
+#ifndef TDLIGHT_DOWNSAMPLE_H
+#define TDLIGHT_DOWNSAMPLE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace tdlight {
+
+enum class DownsampleMethod { LTTB, MinMax };
+
+/** "lttb" (default) or "minmax"; returns false for anything else. */
+inline bool parse_downsample_method(const std::string& name, DownsampleMethod& method) {
+    if (name.empty() || name == "lttb") { method = DownsampleMethod::LTTB; return true; }
+    if (name == "minmax") { method = DownsampleMethod::MinMax; return true; }
+    return false;
+}
+
+/**
+ * LTTB over @p n points with ascending @p x. Returns at most
+ * @p max_points indices, always including the first and last point.
+ */
+inline std::vector<size_t> lttb_indices(const double* x, const double* y, size_t n, size_t max_points) {
+    std::vector<size_t> out;
+    if (n <= max_points || max_points < 3) {
+        out.resize(n);
+        for (size_t i = 0; i < n; i++) out[i] = i;
+        return out;
+    }
+
+    out.reserve(max_points);
+    const double every = static_cast<double>(n - 2) / static_cast<double>(max_points - 2);
+    size_t a = 0;
+    out.push_back(0);
+
+    for (size_t bucket = 0; bucket < max_points - 2; bucket++) {
+        // Average of the next bucket is the third triangle corner
+        size_t avg_start = static_cast<size_t>(std::floor((bucket + 1) * every)) + 1;
+        size_t avg_end = std::min(static_cast<size_t>(std::floor((bucket + 2) * every)) + 1, n);
+        if (avg_start >= avg_end) avg_start = avg_end - 1;
+        double avg_x = 0, avg_y = 0;
+        for (size_t i = avg_start; i < avg_end; i++) {
+            avg_x += x[i];
+            avg_y += y[i];
+        }
+        avg_x /= static_cast<double>(avg_end - avg_start);
+        avg_y /= static_cast<double>(avg_end - avg_start);
+
+        // Point of this bucket spanning the largest triangle with a and the average
+        size_t start = static_cast<size_t>(std::floor(bucket * every)) + 1;
+        size_t end = std::min(static_cast<size_t>(std::floor((bucket + 1) * every)) + 1, n - 1);
+        size_t best = start;
+        double best_area = -1;
+        for (size_t i = start; i < end; i++) {
+            double area = std::fabs((x[a] - avg_x) * (y[i] - y[a]) - (x[a] - x[i]) * (avg_y - y[a]));
+            if (area > best_area) {
+                best_area = area;
+                best = i;
+            }
+        }
+        out.push_back(best);
+        a = best;
+    }
+    out.push_back(n - 1);
+    return out;
+}
+
+/**
+ * Minimum and maximum of @p y in each of max_points / 2 equal-width
+ * buckets of @p x (ascending), plus the first and last point.
+ */
+inline std::vector<size_t> minmax_indices(const double* x, const double* y, size_t n, size_t max_points) {
+    std::vector<size_t> out;
+    if (n <= max_points || max_points < 4) {
+        out.resize(n);
+        for (size_t i = 0; i < n; i++) out[i] = i;
+        return out;
+    }
+
+    size_t buckets = (max_points - 2) / 2;
+    double span = x[n - 1] - x[0];
+    out.push_back(0);
+    size_t i = 1;
+    for (size_t b = 0; b < buckets && i < n - 1; b++) {
+        double upper = b + 1 == buckets ? x[n - 1] : x[0] + span * static_cast<double>(b + 1) / buckets;
+        size_t lo = i, hi = i;
+        size_t j = i;
+        for (; j < n - 1 && (x[j] < upper || b + 1 == buckets); j++) {
+            if (y[j] < y[lo]) lo = j;
+            if (y[j] > y[hi]) hi = j;
+        }
+        if (j > i) {
+            out.push_back(std::min(lo, hi));
+            if (hi != lo) out.push_back(std::max(lo, hi));
+        }
+        i = j;
+    }
+    out.push_back(n - 1);
+    return out;
+}
+
+/**
+ * Downsample each group of a time-ordered series separately.
+ * @p group[i] names the group of point i (e.g. its band); at most
+ * @p max_points points are kept per group. Returns the kept indices in
+ * input order.
+ */
+inline std::vector<size_t> downsample_groups(const std::vector<double>& x, const std::vector<double>& y,
+                                             const std::vector<std::string>& group, size_t max_points,
+                                             DownsampleMethod method) {
+    std::map<std::string, std::vector<size_t>> members;
+    for (size_t i = 0; i < x.size(); i++) members[group[i]].push_back(i);
+
+    std::vector<size_t> kept;
+    std::vector<double> gx, gy;
+    for (const auto& entry : members) {
+        const std::vector<size_t>& idx = entry.second;
+        gx.resize(idx.size());
+        gy.resize(idx.size());
+        for (size_t k = 0; k < idx.size(); k++) {
+            gx[k] = x[idx[k]];
+            gy[k] = y[idx[k]];
+        }
+        std::vector<size_t> picked = method == DownsampleMethod::MinMax
+            ? minmax_indices(gx.data(), gy.data(), idx.size(), max_points)
+            : lttb_indices(gx.data(), gy.data(), idx.size(), max_points);
+        for (size_t k : picked) kept.push_back(idx[k]);
+    }
+    std::sort(kept.begin(), kept.end());
+    return kept;
+}
+
+} // namespace tdlight
+
+#endif // TDLIGHT_DOWNSAMPLE_H
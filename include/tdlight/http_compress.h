@@ -0,0 +1,151 @@
+/**
+ * @file http_compress.h
+ * @brief gzip Content-Encoding for HTTP responses (zlib).
+ *
+ * JSON object lists compress 5-10x. GzipEncoder is an incremental gzip
+ * stream (used for chunked bodies); http_compress_response() compresses
+ * a complete response in place when the client sent
+ * "Accept-Encoding: gzip", the body is text and large enough to be
+ * worth it. Link with -lz.
+ */
+
+#ifndef TDLIGHT_HTTP_COMPRESS_H
+#define TDLIGHT_HTTP_COMPRESS_H
+
+#include <string>
+#include <string_view>
+#include <cctype>
+#include <cstdlib>
+#include <zlib.h>
+#include "http_server.h"
+
+namespace tdlight {
+
+/** Bodies smaller than this are sent uncompressed. */
+constexpr size_t kGzipMinBytes = 1024;
+
+class GzipEncoder {
+public:
+    explicit GzipEncoder(int level = Z_DEFAULT_COMPRESSION) {
+        // windowBits 15 + 16: gzip header and trailer instead of zlib's
+        ok_ = deflateInit2(&zs_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~GzipEncoder() {
+        deflateEnd(&zs_);
+    }
+
+    GzipEncoder(const GzipEncoder&) = delete;
+    GzipEncoder& operator=(const GzipEncoder&) = delete;
+
+    /**
+     * Compress @p size bytes and append the output produced so far to
+     * @p out; @p finish flushes everything and ends the stream.
+     */
+    bool write(const char* data, size_t size, std::string& out, bool finish = false) {
+        if (!ok_) return false;
+        zs_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs_.avail_in = static_cast<uInt>(size);
+        char buf[16384];
+        do {
+            zs_.next_out = reinterpret_cast<Bytef*>(buf);
+            zs_.avail_out = sizeof(buf);
+            if (deflate(&zs_, finish ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR) return ok_ = false;
+            out.append(buf, sizeof(buf) - zs_.avail_out);
+        } while (zs_.avail_out == 0);
+        return true;
+    }
+
+    bool ok() const { return ok_; }
+
+private:
+    z_stream zs_{};
+    bool ok_ = false;
+};
+
+/** gzip of @p data in one call ("" on failure). */
+inline std::string gzip_compress(std::string_view data, int level = Z_DEFAULT_COMPRESSION) {
+    std::string out;
+    GzipEncoder encoder(level);
+    if (!encoder.write(data.data(), data.size(), out, true)) return "";
+    return out;
+}
+
+/** True if "Accept-Encoding" lists gzip (or *) with a non-zero q. */
+inline bool http_accepts_gzip(std::string_view request) {
+    std::string_view accept = http_header(request, "Accept-Encoding");
+    while (!accept.empty()) {
+        size_t comma = accept.find(',');
+        std::string_view item = accept.substr(0, comma);
+        accept = comma == std::string_view::npos ? std::string_view() : accept.substr(comma + 1);
+
+        size_t semi = item.find(';');
+        std::string_view name = item.substr(0, semi);
+        while (!name.empty() && name.front() == ' ') name.remove_prefix(1);
+        while (!name.empty() && name.back() == ' ') name.remove_suffix(1);
+        std::string lower;
+        for (char c : name) lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (lower != "gzip" && lower != "x-gzip" && lower != "*") continue;
+
+        if (semi != std::string_view::npos) {
+            size_t q = item.find("q=", semi);
+            if (q != std::string_view::npos && std::strtod(std::string(item.substr(q + 2)).c_str(), nullptr) <= 0) {
+                continue;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+/** Text bodies worth compressing (JSON, JavaScript, HTML, ...). */
+inline bool http_compressible(std::string_view content_type) {
+    return content_type.substr(0, 5) == "text/" || content_type.find("json") != std::string_view::npos ||
+           content_type.find("javascript") != std::string_view::npos ||
+           content_type.find("xml") != std::string_view::npos;
+}
+
+/**
+ * gzip the body of a complete response in place (Content-Encoding,
+ * Vary and Content-Length are set). Leaves the response alone unless
+ * @p accepts_gzip, the body has at least @p min_bytes of compressible
+ * text and is not encoded already. Returns true if it compressed.
+ */
+inline bool http_compress_response(std::string& response, bool accepts_gzip, size_t min_bytes = kGzipMinBytes,
+                                   int level = Z_BEST_SPEED) {
+    if (!accepts_gzip) return false;
+    size_t header_end = response.find("\r\n\r\n");
+    if (header_end == std::string::npos || response.size() - header_end - 4 < min_bytes) return false;
+    std::string_view head(response.data(), header_end + 4);
+    if (!http_compressible(http_header(head, "Content-Type")) || !http_header(head, "Content-Encoding").empty()) {
+        return false;
+    }
+
+    std::string body = gzip_compress(std::string_view(response).substr(header_end + 4), level);
+    if (body.empty()) return false;
+
+    // Rebuild the header block without the old Content-Length
+    std::string out;
+    out.reserve(header_end + 128 + body.size());
+    size_t pos = 0;
+    while (pos < header_end) {
+        size_t eol = response.find("\r\n", pos);
+        if (eol == std::string::npos || eol > header_end) eol = header_end;
+        std::string_view line(response.data() + pos, eol - pos);
+        bool content_length = line.size() >= 15 && line[14] == ':';
+        for (size_t i = 0; i < 14 && content_length; i++) {
+            content_length = std::tolower(static_cast<unsigned char>(line[i])) == "content-length"[i];
+        }
+        if (!content_length) out.append(line).append("\r\n");
+        pos = eol + 2;
+    }
+    out += "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\nContent-Length: " + std::to_string(body.size()) +
+           "\r\n\r\n";
+    out += body;
+    response.swap(out);
+    return true;
+}
+
+} // namespace tdlight
+
+#endif // TDLIGHT_HTTP_COMPRESS_H
@@ -0,0 +1,533 @@
+/**
+ * @file http_server.h
+ * @brief epoll-based HTTP/1.1 server core with a fixed worker pool.
+ *
+ * One event-loop thread accepts connections and reads requests on
+ * non-blocking sockets until they are complete (headers plus
+ * Content-Length body). Complete requests are handed to a fixed pool
+ * of worker threads, which call the handler with the socket switched
+ * back to blocking mode. Open connections, queued/running requests and
+ * request size are bounded; over the limit a client gets 503/413
+ * instead of a new thread.
+ *
+ * Connections are persistent: a handler returning KeepAlive gives the
+ * socket back to the event loop, which serves the next request on it
+ * (pipelined requests already buffered included, one at a time so
+ * responses stay in order) and closes it after an idle timeout.
+ *
+ * Typical use:
+ *
+ *   tdlight::HttpServer server(limits, [](int fd, std::string& request) {
+ *       ... send a response on fd ...
+ *       return tdlight::HttpServer::Disposition::Close;
+ *   });
+ *   if (!server.listen("0.0.0.0", 5001, error)) ...
+ *   server.run();   // until stop()
+ */
+
+#ifndef TDLIGHT_HTTP_SERVER_H
+#define TDLIGHT_HTTP_SERVER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace tdlight {
+
+/**
+ * Value of header @p name (case-insensitive) in the header block of
+ * @p request, without surrounding whitespace; empty if absent.
+ */
+inline std::string_view http_header(std::string_view request, std::string_view name) {
+    size_t end = request.find("\r\n\r\n");
+    if (end == std::string_view::npos) end = request.size();
+    size_t pos = request.find("\r\n");
+    while (pos != std::string_view::npos && pos < end) {
+        size_t line = pos + 2;
+        size_t eol = request.find("\r\n", line);
+        if (eol == std::string_view::npos || eol > end) eol = end;
+        if (eol - line > name.size() && request[line + name.size()] == ':') {
+            bool match = true;
+            for (size_t i = 0; i < name.size() && match; i++) {
+                match = std::tolower(static_cast<unsigned char>(request[line + i])) ==
+                        std::tolower(static_cast<unsigned char>(name[i]));
+            }
+            if (match) {
+                std::string_view value = request.substr(line + name.size() + 1, eol - line - name.size() - 1);
+                while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+                while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+                return value;
+            }
+        }
+        pos = eol < end ? eol : std::string_view::npos;
+    }
+    return {};
+}
+
+/**
+ * Length of the first complete request at the start of @p buf: 0 while
+ * more bytes are needed, -1 if the request is malformed (bad
+ * Content-Length or a chunked request body, which is not supported).
+ */
+inline long long http_request_length(std::string_view buf) {
+    size_t header_end = buf.find("\r\n\r\n");
+    if (header_end == std::string_view::npos) return 0;
+    size_t body_start = header_end + 4;
+
+    std::string_view head = buf.substr(0, body_start);
+    if (!http_header(head, "Transfer-Encoding").empty()) return -1;
+
+    long long content_length = 0;
+    std::string_view cl = http_header(head, "Content-Length");
+    if (!cl.empty()) {
+        for (char c : cl) {
+            if (c < '0' || c > '9' || content_length > (1LL << 40)) return -1;
+            content_length = content_length * 10 + (c - '0');
+        }
+    }
+    long long total = static_cast<long long>(body_start) + content_length;
+    return static_cast<long long>(buf.size()) >= total ? total : 0;
+}
+
+/**
+ * True if the client expects the connection to stay open after
+ * @p request: HTTP/1.1 unless "Connection: close", HTTP/1.0 only with
+ * "Connection: keep-alive".
+ */
+inline bool http_keep_alive(std::string_view request) {
+    auto iequals = [](std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    };
+    std::string_view connection = http_header(request, "Connection");
+    if (iequals(connection, "close")) return false;
+    std::string_view line = request.substr(0, request.find("\r\n"));
+    bool http10 = line.size() >= 8 && line.substr(line.size() - 8) == "HTTP/1.0";
+    return !http10 || iequals(connection, "keep-alive");
+}
+
+/**
+ * Make a complete response safe on a persistent connection: add
+ * Content-Length when it is missing (the body is everything after the
+ * header block) and a Connection header matching @p keep_alive.
+ */
+inline void http_frame_response(std::string& response, bool keep_alive) {
+    size_t header_end = response.find("\r\n\r\n");
+    if (header_end == std::string::npos) return;
+    std::string extra;
+    std::string_view head(response.data(), header_end + 4);
+    if (http_header(head, "Content-Length").empty() && http_header(head, "Transfer-Encoding").empty()) {
+        extra += "\r\nContent-Length: " + std::to_string(response.size() - header_end - 4);
+    }
+    if (http_header(head, "Connection").empty()) {
+        extra += keep_alive ? "\r\nConnection: keep-alive" : "\r\nConnection: close";
+    }
+    response.insert(header_end, extra);
+}
+
+/** Bounds on the server's resources; 0 workers = hardware threads. */
+struct HttpServerLimits {
+    size_t workers = 0;                       // threads running the handler
+    size_t max_connections = 1024;            // open client sockets
+    size_t max_inflight = 256;                // requests queued or being handled
+    size_t max_request_bytes = 64u << 20;     // headers + body
+    int read_timeout_s = 30;                  // time to receive a whole request
+    int idle_timeout_s = 15;                  // keep-alive connection without a request
+    int write_timeout_s = 30;                 // one send to a client that stopped reading
+};
+
+class HttpServer {
+public:
+    /** What happens to the socket after the handler returns. */
+    enum class Disposition {
+        Close,          // the server closes it
+        KeepAlive,      // read the next request from the same connection
+        Detached        // the handler took ownership (e.g. a long-lived stream)
+    };
+
+    /**
+     * Called on a worker with a blocking socket and one complete request;
+     * sends on it time out after HttpServerLimits::write_timeout_s.
+     */
+    using Handler = std::function<Disposition(int fd, std::string& request)>;
+
+    HttpServer(const HttpServerLimits& limits, Handler handler)
+        : limits_(limits), handler_(std::move(handler)) {
+        if (limits_.workers == 0) {
+            limits_.workers = std::max(4u, std::thread::hardware_concurrency());
+        }
+        if (limits_.max_connections == 0) limits_.max_connections = 1;
+        if (limits_.max_inflight == 0) limits_.max_inflight = 1;
+    }
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    ~HttpServer() {
+        stop();
+        stop_workers();
+        for (auto& entry : conns_) ::close(entry.first);
+        for (auto& job : returned_) ::close(job.fd);
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+        if (wake_fd_ >= 0) ::close(wake_fd_);
+    }
+
+    /** Bind and listen on @p host:@p port; on failure @p error says why. */
+    bool listen(const std::string& host, int port, std::string& error) {
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            error = std::string("socket: ") + std::strerror(errno);
+            return false;
+        }
+        int opt = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+        setsockopt(listen_fd_, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (host.empty() || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            addr.sin_addr.s_addr = INADDR_ANY;
+        }
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            error = "bind port " + std::to_string(port) + ": " + std::strerror(errno);
+            return false;
+        }
+        if (::listen(listen_fd_, SOMAXCONN) < 0) {
+            error = std::string("listen: ") + std::strerror(errno);
+            return false;
+        }
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            error = std::string("epoll: ") + std::strerror(errno);
+            return false;
+        }
+        watch(listen_fd_);
+        watch(wake_fd_);
+        return true;
+    }
+
+    /** Run the event loop in the calling thread until stop(). */
+    void run() {
+        start_workers();
+        std::vector<epoll_event> events(256);
+        auto last_sweep = std::chrono::steady_clock::now();
+
+        while (!stopping_) {
+            int n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), 1000);
+            if (n < 0 && errno != EINTR) {
+                std::cerr << "[ERROR] epoll_wait: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd_) accept_all();
+                else if (fd == wake_fd_) take_returned();
+                else if (events[i].events & (EPOLLERR | EPOLLHUP)) drop(fd);
+                else read_ready(fd);
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_sweep >= std::chrono::seconds(1)) {
+                sweep_timeouts(now);
+                last_sweep = now;
+            }
+        }
+        stop_workers();
+    }
+
+    /** Ask run() to return; safe from any thread or a signal handler. */
+    void stop() {
+        stopping_ = true;
+        if (wake_fd_ >= 0) {
+            uint64_t one = 1;
+            ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+
+    const HttpServerLimits& limits() const { return limits_; }
+    size_t open_connections() const { return open_.load(); }
+    size_t inflight() const { return inflight_.load(); }
+
+private:
+    struct Conn {
+        std::string buf;                                // bytes of the next request(s)
+        std::chrono::steady_clock::time_point since;    // idle since / request started
+        bool served = false;                            // back for keep-alive after a response
+    };
+
+    struct Job {
+        int fd;
+        std::string request;
+        std::string rest;       // pipelined bytes after the request
+    };
+
+    void watch(int fd) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    static void reject(int fd, const char* status) {
+        std::string response = std::string("HTTP/1.1 ") + status +
+                               "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        ssize_t ignored = ::send(fd, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        (void)ignored;
+    }
+
+    void accept_all() {
+        while (true) {
+            int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    std::cerr << "[ERROR] accept: " << std::strerror(errno) << std::endl;
+                }
+                if (errno == EINTR) continue;
+                return;
+            }
+            if (open_ >= limits_.max_connections && !evict_idle()) {
+                reject(fd, "503 Service Unavailable");
+                ::close(fd);
+                continue;
+            }
+            open_++;
+            conns_[fd] = Conn{std::string(), std::chrono::steady_clock::now()};
+            watch(fd);
+        }
+    }
+
+    /**
+     * Close the longest-idle keep-alive connection to make room; false if
+     * none. Connections that have not had a response yet are never
+     * evicted: an empty buffer there means the first request is on its way.
+     */
+    bool evict_idle() {
+        int oldest = -1;
+        std::chrono::steady_clock::time_point since{};
+        for (const auto& entry : conns_) {
+            const Conn& conn = entry.second;
+            if (conn.served && conn.buf.empty() && (oldest < 0 || conn.since < since)) {
+                oldest = entry.first;
+                since = conn.since;
+            }
+        }
+        if (oldest < 0) return false;
+        drop(oldest);
+        return true;
+    }
+
+    /** Re-watch connections handed back by workers after a KeepAlive. */
+    void take_returned() {
+        uint64_t value;
+        while (::read(wake_fd_, &value, sizeof(value)) > 0) {}
+
+        std::deque<Job> returned;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            returned.swap(returned_);
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (Job& job : returned) {
+            int fd = job.fd;
+            auto it = conns_.emplace(fd, Conn{std::move(job.rest), now, true}).first;
+            watch(fd);
+            if (!it->second.buf.empty()) dispatch(fd, it);
+        }
+    }
+
+    /** Close a connection still owned by the event loop. */
+    void drop(int fd) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        if (conns_.erase(fd)) open_--;
+    }
+
+    void read_ready(int fd) {
+        auto it = conns_.find(fd);
+        if (it == conns_.end()) return;
+        std::string& buf = it->second.buf;
+
+        char chunk[16384];
+        while (true) {
+            ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (got > 0) {
+                if (buf.empty()) it->second.since = std::chrono::steady_clock::now();
+                buf.append(chunk, static_cast<size_t>(got));
+                if (buf.size() > limits_.max_request_bytes) {
+                    reject(fd, "413 Payload Too Large");
+                    drop(fd);
+                    return;
+                }
+                continue;
+            }
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            drop(fd);                 // peer closed or error
+            return;
+        }
+        dispatch(fd, it);
+    }
+
+    /** Queue the first request buffered on @p fd if it is complete. */
+    void dispatch(int fd, std::unordered_map<int, Conn>::iterator it) {
+        std::string& buf = it->second.buf;
+        long long length = http_request_length(buf);
+        if (length < 0) {
+            reject(fd, "400 Bad Request");
+            drop(fd);
+            return;
+        }
+        if (length == 0) return;
+
+        if (inflight_ >= limits_.max_inflight) {
+            reject(fd, "503 Service Unavailable");
+            drop(fd);
+            return;
+        }
+
+        // The worker owns the socket from here on
+        Job job{fd, buf.substr(0, static_cast<size_t>(length)), buf.substr(static_cast<size_t>(length))};
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        conns_.erase(it);
+        inflight_++;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        jobs_cv_.notify_one();
+    }
+
+    void sweep_timeouts(std::chrono::steady_clock::time_point now) {
+        std::vector<int> expired;
+        for (const auto& entry : conns_) {
+            int timeout = entry.second.buf.empty() ? limits_.idle_timeout_s : limits_.read_timeout_s;
+            if (now - entry.second.since > std::chrono::seconds(timeout)) {
+                expired.push_back(entry.first);
+            }
+        }
+        for (int fd : expired) {
+            if (!conns_[fd].buf.empty()) reject(fd, "408 Request Timeout");
+            drop(fd);
+        }
+    }
+
+    void start_workers() {
+        if (!workers_.empty()) return;
+        workers_stopping_ = false;
+        for (size_t i = 0; i < limits_.workers; i++) {
+            workers_.emplace_back([this] { work(); });
+        }
+    }
+
+    void stop_workers() {
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            workers_stopping_ = true;
+        }
+        jobs_cv_.notify_all();
+        for (auto& t : workers_) t.join();
+        workers_.clear();
+        for (auto& job : jobs_) ::close(job.fd);
+        jobs_.clear();
+    }
+
+    void work() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(jobs_mutex_);
+                jobs_cv_.wait(lock, [this] { return workers_stopping_ || !jobs_.empty(); });
+                if (jobs_.empty()) return;
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+
+            // The handler sends blocking; a client that stops reading makes
+            // send() fail after write_timeout_s instead of holding the worker
+            int flags = fcntl(job.fd, F_GETFL);
+            if (flags != -1) fcntl(job.fd, F_SETFL, flags & ~O_NONBLOCK);
+            timeval send_timeout{limits_.write_timeout_s, 0};
+            setsockopt(job.fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+            Disposition disposition = Disposition::Close;
+            try {
+                disposition = handler_(job.fd, job.request);
+            } catch (const std::exception& e) {
+                std::cerr << "[ERROR] Exception handling client: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "[ERROR] Unknown exception handling client" << std::endl;
+            }
+            if (disposition == Disposition::KeepAlive && !stopping_) {
+                if (flags != -1) fcntl(job.fd, F_SETFL, flags | O_NONBLOCK);
+                {
+                    std::lock_guard<std::mutex> lock(jobs_mutex_);
+                    returned_.push_back(Job{job.fd, std::string(), std::move(job.rest)});
+                }
+                inflight_--;
+                uint64_t one = 1;
+                ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+                (void)ignored;
+                continue;
+            }
+            if (disposition != Disposition::Detached) ::close(job.fd);
+            open_--;
+            inflight_--;
+        }
+    }
+
+    HttpServerLimits limits_;
+    Handler handler_;
+
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::unordered_map<int, Conn> conns_;     // event-loop thread only
+
+    std::atomic<size_t> open_{0};             // accepted and not yet closed/detached
+    std::atomic<size_t> inflight_{0};         // queued or in a handler
+
+    std::vector<std::thread> workers_;
+    std::deque<Job> jobs_;
+    std::deque<Job> returned_;                // kept-alive sockets for the event loop
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_cv_;
+    bool workers_stopping_ = false;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_HTTP_SERVER_H
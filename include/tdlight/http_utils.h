@@ -28,6 +28,7 @@ inline std::string response(int status_code, const std::string& content_type,
         case 400: status_text = "Bad Request"; break;
         case 404: status_text = "Not Found"; break;
         case 500: status_text = "Internal Server Error"; break;
+        case 503: status_text = "Service Unavailable"; break;
         default:  status_text = "Unknown"; break;
     }
     
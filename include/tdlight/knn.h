@@ -0,0 +1,127 @@
+/**
+ * @file knn.h
+ * @brief k-nearest-neighbour search over HEALPix pixels by expanding rings.
+ *
+ * There is no good cone radius for "the closest K sources": too small
+ * finds nothing, too large reads a whole field. expand_rings() starts
+ * with the disc around the target pixel and doubles its radius, reading
+ * only the pixels not covered yet. A bounded heap keeps the K best
+ * candidates; the search stops once the K-th distance is within the
+ * radius already covered, because every unread source is farther away.
+ *
+ * Typical use:
+ *
+ *   tdlight::KnnHeap<Obj> heap(k);
+ *   tdlight::expand_rings(base, ra, dec, heap, [&](const std::vector<int>& pixels) {
+ *       ... query pixels, heap.offer(distance_deg, obj) for each row ...
+ *   });
+ *   auto nearest = heap.take_sorted();
+ */
+
+#ifndef TDLIGHT_KNN_H
+#define TDLIGHT_KNN_H
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <healpix_cxx/healpix_base.h>
+#include <healpix_cxx/pointing.h>
+
+namespace tdlight {
+
+/** The K smallest (distance, item) pairs seen so far. */
+template<typename T>
+class KnnHeap {
+public:
+    explicit KnnHeap(size_t k) : k_(k) { heap_.reserve(k); }
+
+    size_t k() const { return k_; }
+    size_t size() const { return heap_.size(); }
+    bool full() const { return heap_.size() >= k_; }
+
+    /** Distance of the current K-th neighbour (infinity until full). */
+    double worst() const {
+        return full() && !heap_.empty() ? heap_.front().first : std::numeric_limits<double>::infinity();
+    }
+
+    /** Cheap pre-check so callers can skip building rejected items. */
+    bool accepts(double distance) const { return k_ > 0 && distance < worst(); }
+
+    void offer(double distance, T item) {
+        if (!accepts(distance)) return;
+        if (full()) {
+            std::pop_heap(heap_.begin(), heap_.end(), less_);
+            heap_.pop_back();
+        }
+        heap_.emplace_back(distance, std::move(item));
+        std::push_heap(heap_.begin(), heap_.end(), less_);
+    }
+
+    /** Neighbours in increasing distance; empties the heap. */
+    std::vector<std::pair<double, T>> take_sorted() {
+        std::sort_heap(heap_.begin(), heap_.end(), less_);
+        std::vector<std::pair<double, T>> sorted = std::move(heap_);
+        heap_.clear();
+        return sorted;
+    }
+
+private:
+    static bool less_(const std::pair<double, T>& a, const std::pair<double, T>& b) {
+        return a.first < b.first;
+    }
+
+    size_t k_;
+    std::vector<std::pair<double, T>> heap_;    // max-heap on distance
+};
+
+/** How far a search had to go. */
+struct KnnProgress {
+    int rings = 0;                    // pixel batches read
+    int pixels = 0;                   // pixels read in total
+    double radius_deg = 0;            // radius fully covered at the end
+};
+
+/**
+ * Grow discs around (@p ra, @p dec) and hand each batch of newly covered
+ * NESTED pixels to @p visit, which offers its rows to @p heap. Stops when
+ * the heap holds K neighbours no farther than the covered radius, or when
+ * @p max_radius_deg has been covered (the heap may then hold fewer than
+ * K items; callers should ignore offers beyond that radius).
+ */
+template<typename T, typename Visit>
+KnnProgress expand_rings(const Healpix_Base& base, double ra, double dec, KnnHeap<T>& heap,
+                         Visit visit, double max_radius_deg = 180.0) {
+    const double deg = 3.14159265358979323846 / 180.0;
+    pointing center((90.0 - dec) * deg, ra * deg);
+
+    KnnProgress progress;
+    rangeset<int> covered;
+    int fact = base.Scheme() == NEST ? 4 : 1;
+    double radius_deg = std::min(max_radius_deg, base.max_pixrad() / deg);
+
+    while (true) {
+        // Inclusive discs contain every pixel that overlaps the disc, so all
+        // sources within radius_deg have been read after this batch
+        rangeset<int> disc;
+        base.query_disc_inclusive(center, std::min(radius_deg, 180.0) * deg, disc, fact);
+        std::vector<int> fresh = disc.op_andnot(covered).toVector();
+        covered = disc.op_or(covered);
+
+        if (!fresh.empty()) {
+            progress.rings++;
+            progress.pixels += static_cast<int>(fresh.size());
+            visit(fresh);
+        }
+        progress.radius_deg = radius_deg;
+
+        if (heap.full() && heap.worst() <= radius_deg) break;
+        if (radius_deg >= max_radius_deg || radius_deg >= 180.0) break;
+        radius_deg = std::min(max_radius_deg, radius_deg * 2);
+    }
+    return progress;
+}
+
+} // namespace tdlight
+
+#endif // TDLIGHT_KNN_H
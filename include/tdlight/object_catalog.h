@@ -0,0 +1,120 @@
+/**
+ * @file object_catalog.h
+ * @brief Compact in-memory table of per-source tags, sorted by HEALPix pixel.
+ *
+ * Listing, cone and lookup endpoints otherwise aggregate sensor_data
+ * (GROUP BY healpix_id, source_id) on every request. An ObjectCatalog
+ * holds one 48-byte row per source (class and band interned), sorted by
+ * (healpix_id, source_id), so a pixel is a binary search and a source_id
+ * lookup goes through a secondary index. A catalog is immutable once
+ * finish() has run; callers rebuild a new one and swap it in.
+ */
+
+#ifndef TDLIGHT_OBJECT_CATALOG_H
+#define TDLIGHT_OBJECT_CATALOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+namespace tdlight {
+
+struct CatalogObject {
+    int64_t healpix_id;
+    int64_t source_id;
+    double ra, dec;
+    int64_t count;          // observations
+    uint32_t cls;           // index into ObjectCatalog::label()
+    uint32_t band;
+};
+
+class ObjectCatalog {
+public:
+    ObjectCatalog(std::string database, uint64_t generation)
+        : database_(std::move(database)), generation_(generation) {
+        intern("");             // label 0 = missing tag
+    }
+
+    void add(int64_t healpix_id, int64_t source_id, double ra, double dec, int64_t count,
+             std::string_view cls, std::string_view band) {
+        objects_.push_back(CatalogObject{healpix_id, source_id, ra, dec, count, intern(cls), intern(band)});
+    }
+
+    /** Sort and index; call once after the last add(). */
+    void finish() {
+        std::sort(objects_.begin(), objects_.end(), [](const CatalogObject& a, const CatalogObject& b) {
+            return a.healpix_id != b.healpix_id ? a.healpix_id < b.healpix_id : a.source_id < b.source_id;
+        });
+        objects_.shrink_to_fit();
+        by_source_.resize(objects_.size());
+        for (uint32_t i = 0; i < by_source_.size(); i++) by_source_[i] = i;
+        std::sort(by_source_.begin(), by_source_.end(), [this](uint32_t a, uint32_t b) {
+            return objects_[a].source_id < objects_[b].source_id;
+        });
+        label_index_.clear();
+    }
+
+    const std::string& database() const { return database_; }
+    uint64_t generation() const { return generation_; }
+    size_t size() const { return objects_.size(); }
+    const std::vector<CatalogObject>& objects() const { return objects_; }
+
+    /** Class/band text of a label index ("" if the tag was missing). */
+    const std::string& label(uint32_t index) const { return labels_[index]; }
+
+    /** Objects of one NESTED pixel as [first, last). */
+    std::pair<const CatalogObject*, const CatalogObject*> pixel(int64_t healpix_id) const {
+        auto lo = std::lower_bound(objects_.begin(), objects_.end(), healpix_id,
+            [](const CatalogObject& o, int64_t id) { return o.healpix_id < id; });
+        auto hi = lo;
+        while (hi != objects_.end() && hi->healpix_id == healpix_id) ++hi;
+        return {objects_.data() + (lo - objects_.begin()), objects_.data() + (hi - objects_.begin())};
+    }
+
+    /** Objects of the NESTED pixels first..last (inclusive) as [first, last). */
+    std::pair<const CatalogObject*, const CatalogObject*> pixel_range(int64_t first, int64_t last) const {
+        auto by_pixel = [](const CatalogObject& o, int64_t id) { return o.healpix_id < id; };
+        auto lo = std::lower_bound(objects_.begin(), objects_.end(), first, by_pixel);
+        auto hi = std::lower_bound(lo, objects_.end(), last + 1, by_pixel);
+        return {objects_.data() + (lo - objects_.begin()), objects_.data() + (hi - objects_.begin())};
+    }
+
+    /** First object with @p source_id, or nullptr. */
+    const CatalogObject* find_source(int64_t source_id) const {
+        auto it = std::lower_bound(by_source_.begin(), by_source_.end(), source_id,
+            [this](uint32_t i, int64_t id) { return objects_[i].source_id < id; });
+        if (it == by_source_.end() || objects_[*it].source_id != source_id) return nullptr;
+        return &objects_[*it];
+    }
+
+    /** Approximate heap footprint. */
+    size_t memory_bytes() const {
+        size_t bytes = objects_.capacity() * sizeof(CatalogObject) + by_source_.capacity() * sizeof(uint32_t);
+        for (const auto& l : labels_) bytes += sizeof(std::string) + l.capacity();
+        return bytes;
+    }
+
+private:
+    uint32_t intern(std::string_view text) {
+        auto it = label_index_.find(std::string(text));
+        if (it != label_index_.end()) return it->second;
+        uint32_t index = static_cast<uint32_t>(labels_.size());
+        labels_.emplace_back(text);
+        label_index_.emplace(labels_.back(), index);
+        return index;
+    }
+
+    std::string database_;
+    uint64_t generation_;
+    std::vector<CatalogObject> objects_;      // sorted by (healpix_id, source_id)
+    std::vector<uint32_t> by_source_;         // indices sorted by source_id
+    std::vector<std::string> labels_;
+    std::unordered_map<std::string, uint32_t> label_index_;   // build time only
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_OBJECT_CATALOG_H
@@ -0,0 +1,378 @@
+/**
+ * @file progress_hub.h
+ * @brief Server-Sent Events fan-out of progress files, driven by inotify.
+ *
+ * Import and classification jobs report progress by rewriting small
+ * JSON files in /tmp. Polling those files from one thread per SSE
+ * client costs a file read per client every few tens of milliseconds.
+ * A ProgressHub runs one thread that watches the files' directories
+ * with inotify, re-reads a topic once per burst of changes (kRefreshMs
+ * after the first) and sends the new snapshot to every subscriber of
+ * that topic on non-blocking sockets. Subscribers cost a socket and a few
+ * strings, not a thread. Without inotify the hub polls every
+ * kPollFallbackMs instead, still once for all subscribers.
+ *
+ * Typical use:
+ *
+ *   tdlight::ProgressHub hub;
+ *   int topic = hub.add_topic({"/tmp/job_progress.json"}, [] { ... read it ... });
+ *   hub.start(error);
+ *   ...
+ *   hub.subscribe(fd, topic, [](const ProgressHub::Snapshot& s) { ... Send / Skip / SendAndClose ... });
+ */
+
+#ifndef TDLIGHT_PROGRESS_HUB_H
+#define TDLIGHT_PROGRESS_HUB_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+
+namespace tdlight {
+
+class ProgressHub {
+public:
+    /** State of a topic as built by its Reader. */
+    struct Snapshot {
+        std::string data;               // event payload (one line of JSON)
+        bool exists = false;            // the progress file was present
+        timespec mtime{};               // of the progress file
+    };
+
+    enum class Verdict {
+        Skip,           // not for this subscriber (yet)
+        Send,           // send it if it differs from the last one sent
+        SendAndClose    // send it, then end the stream
+    };
+
+    using Reader = std::function<Snapshot()>;
+    using Filter = std::function<Verdict(const Snapshot&)>;
+
+    static constexpr int kRefreshMs = 50;           // coalesce bursts of writes
+    static constexpr int kPollFallbackMs = 250;     // when inotify is unavailable
+    static constexpr int kHeartbeatSec = 2;
+    static constexpr size_t kMaxOutbox = 1 << 20;   // slower readers are dropped
+
+    ProgressHub() = default;
+    ProgressHub(const ProgressHub&) = delete;
+    ProgressHub& operator=(const ProgressHub&) = delete;
+
+    ~ProgressHub() {
+        stop();
+        for (auto& entry : subscribers_) ::close(entry.first);
+        for (auto& pending : pending_) ::close(pending.fd);
+        if (inotify_fd_ >= 0) ::close(inotify_fd_);
+        if (wake_fd_ >= 0) ::close(wake_fd_);
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    }
+
+    /**
+     * Register a topic before start(): @p read builds its snapshot and is
+     * called again whenever one of @p paths is written, created or removed.
+     */
+    int add_topic(std::vector<std::string> paths, Reader read) {
+        topics_.push_back(Topic{std::move(paths), std::move(read), false});
+        return static_cast<int>(topics_.size() - 1);
+    }
+
+    /** Start the hub thread; on failure @p error says why. */
+    bool start(std::string& error) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            error = std::string("epoll: ") + std::strerror(errno);
+            return false;
+        }
+        watch(wake_fd_, EPOLLIN);
+
+        inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd_ < 0) {
+            std::cerr << "[WARN] inotify unavailable (" << std::strerror(errno)
+                      << "), polling progress files" << std::endl;
+        } else {
+            for (const Topic& topic : topics_) {
+                for (const std::string& path : topic.paths) add_watch(path);
+            }
+            watch(inotify_fd_, EPOLLIN);
+        }
+
+        thread_ = std::thread([this] { run(); });
+        return true;
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        stopping_ = true;
+        wake();
+        thread_.join();
+    }
+
+    /**
+     * Take over @p fd (a blocking or non-blocking socket whose request has
+     * been read): send the SSE header and the topic's current snapshot,
+     * then every change that @p filter lets through. The hub closes @p fd.
+     */
+    void subscribe(int fd, int topic, Filter filter) {
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            pending_.push_back(Pending{fd, topic, std::move(filter)});
+        }
+        wake();
+    }
+
+    size_t subscribers() const { return count_.load(); }
+
+private:
+    struct Topic {
+        std::vector<std::string> paths;
+        Reader read;
+        bool dirty;
+    };
+
+    struct Pending {
+        int fd;
+        int topic;
+        Filter filter;
+    };
+
+    struct Subscriber {
+        int topic;
+        Filter filter;
+        std::string last_sent;
+        std::string outbox;
+        time_t last_write;
+        bool closing;
+    };
+
+    void watch(int fd, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void wake() {
+        if (wake_fd_ < 0) return;
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    // Directories are watched rather than files, so a file that is
+    // created later or replaced by rename() is still seen
+    void add_watch(const std::string& path) {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+        for (const auto& entry : dirs_) {
+            if (entry.second == dir) return;
+        }
+        int wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+                                   IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+        if (wd < 0) {
+            std::cerr << "[WARN] Cannot watch " << dir << ": " << std::strerror(errno) << std::endl;
+            return;
+        }
+        dirs_[wd] = dir;
+    }
+
+    void read_inotify() {
+        alignas(inotify_event) char buf[8192];
+        while (true) {
+            ssize_t n = ::read(inotify_fd_, buf, sizeof(buf));
+            if (n <= 0) return;
+            for (char* p = buf; p < buf + n;) {
+                auto* ev = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + ev->len;
+                auto dir = dirs_.find(ev->wd);
+                if (dir == dirs_.end() || ev->len == 0) continue;
+                std::string path = (dir->second == "/" ? "" : dir->second) + "/" + ev->name;
+                for (Topic& topic : topics_) {
+                    for (const std::string& watched : topic.paths) {
+                        if (watched == path) topic.dirty = true;
+                    }
+                }
+            }
+        }
+    }
+
+    void adopt_pending() {
+        uint64_t value;
+        while (::read(wake_fd_, &value, sizeof(value)) > 0) {}
+
+        std::deque<Pending> pending;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            pending.swap(pending_);
+        }
+        for (Pending& p : pending) {
+            int flags = fcntl(p.fd, F_GETFL, 0);
+            if (flags != -1) fcntl(p.fd, F_SETFL, flags | O_NONBLOCK);
+            Subscriber& sub = subscribers_[p.fd];
+            sub = Subscriber{p.topic, std::move(p.filter), std::string(), std::string(), time(nullptr), false};
+            count_ = subscribers_.size();
+            watch(p.fd, EPOLLRDHUP);
+            sub.outbox = "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/event-stream\r\n"
+                         "Cache-Control: no-cache\r\n"
+                         "Connection: keep-alive\r\n"
+                         "Access-Control-Allow-Origin: *\r\n"
+                         "\r\n";
+            // A new subscriber gets the state as of now
+            deliver(p.fd, topics_[p.topic].read());
+        }
+    }
+
+    void deliver(int fd, const Snapshot& snapshot) {
+        auto it = subscribers_.find(fd);
+        if (it == subscribers_.end() || it->second.closing) return;
+        Subscriber& sub = it->second;
+        Verdict verdict = sub.filter(snapshot);
+        if (verdict != Verdict::Skip && snapshot.data != sub.last_sent) {
+            sub.last_sent = snapshot.data;
+            sub.outbox += "data: " + snapshot.data + "\n\n";
+            sub.closing = verdict == Verdict::SendAndClose;
+        }
+        flush(fd);
+    }
+
+    void flush(int fd) {
+        auto it = subscribers_.find(fd);
+        if (it == subscribers_.end()) return;
+        Subscriber& sub = it->second;
+        while (!sub.outbox.empty()) {
+            ssize_t sent = ::send(fd, sub.outbox.data(), sub.outbox.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) return drop(fd);
+                break;
+            }
+            sub.outbox.erase(0, static_cast<size_t>(sent));
+            sub.last_write = time(nullptr);
+        }
+        if (sub.outbox.size() > kMaxOutbox) return drop(fd);
+        if (sub.outbox.empty() && sub.closing) return drop(fd);
+
+        epoll_event ev{};
+        ev.events = EPOLLRDHUP;
+        if (!sub.outbox.empty()) ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    void drop(int fd) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        subscribers_.erase(fd);
+        count_ = subscribers_.size();
+    }
+
+    void refresh(Topic& topic, int index) {
+        topic.dirty = false;
+        std::vector<int> fds;
+        for (const auto& entry : subscribers_) {
+            if (entry.second.topic == index) fds.push_back(entry.first);
+        }
+        if (fds.empty()) return;
+        Snapshot snapshot = topic.read();
+        for (int fd : fds) deliver(fd, snapshot);
+    }
+
+    void heartbeat() {
+        time_t now = time(nullptr);
+        std::vector<int> idle;
+        for (const auto& entry : subscribers_) {
+            if (entry.second.outbox.empty() && now - entry.second.last_write >= kHeartbeatSec) {
+                idle.push_back(entry.first);
+            }
+        }
+        for (int fd : idle) {
+            subscribers_[fd].outbox = ": keep-alive\n\n";
+            flush(fd);
+        }
+    }
+
+    // Changed topics are re-read kRefreshMs after their first event, so a
+    // file caught between truncation and rewrite is not sent half-written
+    void run() {
+        using clock = std::chrono::steady_clock;
+        std::vector<epoll_event> events(64);
+        auto dirty_since = clock::now();
+        bool dirty = false;
+        auto last_heartbeat = clock::now();
+
+        while (!stopping_) {
+            int period = inotify_fd_ < 0 ? kPollFallbackMs : kRefreshMs;
+            int timeout = 1000;
+            if (dirty || inotify_fd_ < 0) {
+                auto since = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - dirty_since).count();
+                timeout = std::max<int>(0, period - static_cast<int>(since));
+            }
+
+            int n = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout);
+            if (n < 0 && errno != EINTR) {
+                std::cerr << "[ERROR] ProgressHub epoll_wait: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd_) adopt_pending();
+                else if (fd == inotify_fd_) read_inotify();
+                else if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) drop(fd);
+                else if (events[i].events & EPOLLOUT) flush(fd);
+            }
+
+            auto now = clock::now();
+            if (inotify_fd_ < 0) {
+                for (Topic& topic : topics_) topic.dirty = true;
+            }
+            bool any = false;
+            for (const Topic& topic : topics_) any = any || topic.dirty;
+            if (any && !dirty) {
+                dirty = true;
+                dirty_since = now;
+            }
+            if (dirty && now - dirty_since >= std::chrono::milliseconds(period)) {
+                for (size_t t = 0; t < topics_.size(); t++) {
+                    if (topics_[t].dirty) refresh(topics_[t], static_cast<int>(t));
+                }
+                dirty = false;
+            }
+            if (now - last_heartbeat >= std::chrono::seconds(1)) {
+                heartbeat();
+                last_heartbeat = now;
+            }
+        }
+    }
+
+    std::vector<Topic> topics_;
+    std::unordered_map<int, std::string> dirs_;         // inotify watch -> directory
+    std::unordered_map<int, Subscriber> subscribers_;   // hub thread only
+    std::deque<Pending> pending_;
+    std::mutex pending_mutex_;
+    std::atomic<size_t> count_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    int inotify_fd_ = -1;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_PROGRESS_HUB_H
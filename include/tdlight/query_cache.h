@@ -0,0 +1,265 @@
+/**
+ * @file query_cache.h
+ * @brief Byte-budgeted LRU cache for spatial query results.
+ *
+ * Cone searches are answered from the rows of a HEALPix pixel set, so two
+ * cones that cover the same pixels (and use the same time filter) read the
+ * same rows. QueryCache keeps those candidate rows keyed by the normalized
+ * pixel set; callers then apply their exact distance filter.
+ *
+ * Entries are tagged with the database's import generation, a counter
+ * stored in /tmp that the importers bump when they finish. An entry from
+ * an older generation is treated as a miss and dropped.
+ *
+ * ShardedQueryCache splits the key space over several QueryCaches so
+ * that concurrent readers rarely contend for the same lock.
+ */
+
+#ifndef TDLIGHT_QUERY_CACHE_H
+#define TDLIGHT_QUERY_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+namespace tdlight {
+
+// ==================== Import generation ====================
+
+/**
+ * Counter file of @p database. Characters outside [A-Za-z0-9_] become
+ * '_' so a database name cannot point outside /tmp (class/import_generation.py
+ * maps names the same way).
+ */
+inline std::string import_generation_path(const std::string& database) {
+    std::string safe = database.empty() ? "_" : database;
+    for (char& c : safe) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') c = '_';
+    }
+    return "/tmp/tdlight_import_gen_" + safe;
+}
+
+/** Current import generation of @p database (0 if never bumped). */
+inline uint64_t import_generation(const std::string& database) {
+    std::ifstream f(import_generation_path(database));
+    uint64_t gen = 0;
+    f >> gen;
+    return gen;
+}
+
+/**
+ * Increment the import generation of @p database. Called by the
+ * importers once all rows are written; returns the new generation.
+ */
+inline uint64_t bump_import_generation(const std::string& database) {
+    int fd = open(import_generation_path(database).c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return 0;
+    flock(fd, LOCK_EX);
+
+    char buf[32] = {0};
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    uint64_t gen = (n > 0 ? std::strtoull(buf, nullptr, 10) : 0) + 1;
+
+    std::string text = std::to_string(gen) + "\n";
+    if (ftruncate(fd, 0) != 0 ||
+        pwrite(fd, text.data(), text.size(), 0) != (ssize_t)text.size()) {
+        gen = 0;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return gen;
+}
+
+// ==================== Cache keys ====================
+
+/**
+ * Canonical key for a pixel set plus an extra filter (time condition,
+ * LIMIT, ...). Pixels are sorted, de-duplicated and written as ranges,
+ * so equal sets give equal keys whatever order they were produced in.
+ */
+inline std::string pixel_set_key(std::vector<int> pixels, const std::string& filter) {
+    std::sort(pixels.begin(), pixels.end());
+    pixels.erase(std::unique(pixels.begin(), pixels.end()), pixels.end());
+
+    std::string key;
+    for (size_t i = 0; i < pixels.size();) {
+        size_t j = i;
+        while (j + 1 < pixels.size() && pixels[j + 1] == pixels[j] + 1) j++;
+        if (!key.empty()) key += ',';
+        key += std::to_string(pixels[i]);
+        if (j > i) key += '-' + std::to_string(pixels[j]);
+        i = j + 1;
+    }
+    key += '|';
+    key += filter;
+    return key;
+}
+
+// ==================== LRU cache ====================
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+};
+
+/**
+ * Thread-safe LRU cache of immutable values with a total byte budget.
+ * Values are shared, so a hit costs a reference count, not a copy.
+ */
+template<typename V>
+class QueryCache {
+public:
+    using Value = std::shared_ptr<const V>;
+
+    explicit QueryCache(size_t byte_budget) : budget_(byte_budget) {}
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    /** Look up @p key; entries from another generation are dropped. */
+    Value get(const std::string& key, uint64_t generation) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            stats_.misses++;
+            return nullptr;
+        }
+        if (it->second->generation != generation) {
+            erase(it->second);
+            stats_.misses++;
+            return nullptr;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        stats_.hits++;
+        return it->second->value;
+    }
+
+    /**
+     * Insert or replace @p key. @p bytes is the caller's estimate of the
+     * value's footprint; values larger than the whole budget are not kept.
+     */
+    void put(const std::string& key, Value value, size_t bytes, uint64_t generation) {
+        bytes += key.size();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end()) erase(it->second);
+        if (bytes > budget_) return;
+
+        while (bytes_ + bytes > budget_ && !lru_.empty()) {
+            erase(std::prev(lru_.end()));
+            stats_.evictions++;
+        }
+        lru_.push_front(Entry{key, std::move(value), bytes, generation});
+        index_[key] = lru_.begin();
+        bytes_ += bytes;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lru_.clear();
+        index_.clear();
+        bytes_ = 0;
+    }
+
+    CacheStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        CacheStats s = stats_;
+        s.entries = lru_.size();
+        s.bytes = bytes_;
+        s.budget = budget_;
+        return s;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        Value value;
+        size_t bytes;
+        uint64_t generation;
+    };
+    using Iterator = typename std::list<Entry>::iterator;
+
+    void erase(Iterator it) {
+        bytes_ -= it->bytes;
+        index_.erase(it->key);
+        lru_.erase(it);
+    }
+
+    size_t budget_;
+    size_t bytes_ = 0;
+    std::list<Entry> lru_;                               // front = most recent
+    std::unordered_map<std::string, Iterator> index_;
+    CacheStats stats_;
+    mutable std::mutex mutex_;
+};
+
+/**
+ * QueryCache split into @p shards independently locked LRUs by key hash;
+ * each shard gets an equal part of the byte budget.
+ */
+template<typename V>
+class ShardedQueryCache {
+public:
+    using Value = typename QueryCache<V>::Value;
+
+    explicit ShardedQueryCache(size_t byte_budget, size_t shards = 16) {
+        if (shards == 0) shards = 1;
+        for (size_t i = 0; i < shards; i++) {
+            shards_.emplace_back(new QueryCache<V>(byte_budget / shards));
+        }
+    }
+
+    Value get(const std::string& key, uint64_t generation) {
+        return shard(key).get(key, generation);
+    }
+
+    void put(const std::string& key, Value value, size_t bytes, uint64_t generation) {
+        shard(key).put(key, std::move(value), bytes, generation);
+    }
+
+    void clear() {
+        for (auto& s : shards_) s->clear();
+    }
+
+    /** Totals over all shards. */
+    CacheStats stats() const {
+        CacheStats total;
+        for (const auto& s : shards_) {
+            CacheStats part = s->stats();
+            total.hits += part.hits;
+            total.misses += part.misses;
+            total.evictions += part.evictions;
+            total.entries += part.entries;
+            total.bytes += part.bytes;
+            total.budget += part.budget;
+        }
+        return total;
+    }
+
+private:
+    QueryCache<V>& shard(const std::string& key) {
+        return *shards_[std::hash<std::string>()(key) % shards_.size()];
+    }
+
+    std::vector<std::unique_ptr<QueryCache<V>>> shards_;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_QUERY_CACHE_H
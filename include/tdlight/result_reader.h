@@ -0,0 +1,246 @@
+/**
+ * @file result_reader.h
+ * @brief Block-wise columnar reader for TDengine query results.
+ *
+ * taos_fetch_row() hands out one row at a time, so every field costs a
+ * library call plus a pointer chase. This reader pulls a whole block
+ * with taos_fetch_block() and exposes each column as a typed span over
+ * the client buffer, which lets callers loop over plain arrays.
+ *
+ * Typical use:
+ *
+ *   tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+ *   if (!reader.ok()) { ... reader.error() ... }
+ *   while (int n = reader.next_block()) {
+ *       auto ts = reader.column<int64_t>(0);
+ *       for (int r = 0; r < n; r++) { ... ts[r] ... reader.str(1, r) ... }
+ *   }
+ */
+
+#ifndef TDLIGHT_RESULT_READER_H
+#define TDLIGHT_RESULT_READER_H
+
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <taos.h>
+
+namespace tdlight {
+
+/**
+ * Read-only view of one fixed-width column inside the current block.
+ */
+template<typename T>
+class ColumnSpan {
+public:
+    ColumnSpan() = default;
+    ColumnSpan(const T* data, int size) : data_(data), size_(size) {}
+
+    const T& operator[](int i) const { return data_[i]; }
+    const T* data() const { return data_; }
+    int size() const { return size_; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+private:
+    const T* data_ = nullptr;
+    int size_ = 0;
+};
+
+class ResultReader {
+public:
+    /**
+     * Wrap a result set. It is freed in the destructor unless @p owned is
+     * false (e.g. taos_stmt_use_result(), which the statement keeps).
+     */
+    explicit ResultReader(TAOS_RES* res, bool owned = true) : res_(res), owned_(owned) {
+        code_ = taos_errno(res_);
+        if (code_ != 0) {
+            const char* msg = taos_errstr(res_);
+            error_ = msg ? msg : "unknown error";
+            return;
+        }
+        num_fields_ = taos_num_fields(res_);
+        fields_ = taos_fetch_fields(res_);
+        nulls_.resize(num_fields_);
+        null_ready_.assign(num_fields_, 0);
+    }
+
+    /** Execute @p sql on @p conn and wrap the result. */
+    static ResultReader query(TAOS* conn, const std::string& sql) {
+        return ResultReader(taos_query(conn, sql.c_str()));
+    }
+
+    ResultReader(ResultReader&& other) noexcept { *this = std::move(other); }
+    ResultReader& operator=(ResultReader&& other) noexcept {
+        if (this != &other) {
+            if (res_ && owned_) taos_free_result(res_);
+            res_ = other.res_;              other.res_ = nullptr;
+            owned_ = other.owned_;
+            code_ = other.code_;
+            error_ = std::move(other.error_);
+            num_fields_ = other.num_fields_;
+            fields_ = other.fields_;
+            block_ = other.block_;
+            rows_ = other.rows_;
+            nulls_ = std::move(other.nulls_);
+            null_capacity_ = other.null_capacity_;
+            null_ready_ = std::move(other.null_ready_);
+        }
+        return *this;
+    }
+    ResultReader(const ResultReader&) = delete;
+    ResultReader& operator=(const ResultReader&) = delete;
+
+    ~ResultReader() {
+        if (res_ && owned_) taos_free_result(res_);
+    }
+
+    bool ok() const { return code_ == 0; }
+    int error_code() const { return code_; }
+    const std::string& error() const { return error_; }
+
+    int num_fields() const { return num_fields_; }
+    int field_type(int col) const { return fields_[col].type; }
+    const char* field_name(int col) const { return fields_[col].name; }
+
+    /**
+     * Fetch the next block. Returns its row count, 0 at the end of the
+     * result set or on error (check ok() afterwards).
+     */
+    int next_block() {
+        rows_ = 0;
+        block_ = nullptr;
+        if (!ok() || res_ == nullptr) return 0;
+
+        int n = taos_fetch_block(res_, &block_);
+        if (n <= 0) {
+            int code = taos_errno(res_);
+            if (code != 0) {
+                code_ = code;
+                error_ = taos_errstr(res_);
+            }
+            block_ = nullptr;
+            return 0;
+        }
+        rows_ = n;
+        std::fill(null_ready_.begin(), null_ready_.end(), 0);
+        return rows_;
+    }
+
+    /**
+     * Make the block just delivered by taos_fetch_rows_a() current.
+     * Used by the asynchronous path instead of next_block().
+     */
+    int attach_block(int rows) {
+        TAOS_ROW* block = res_ ? taos_result_block(res_) : nullptr;
+        block_ = block ? *block : nullptr;
+        rows_ = block_ ? rows : 0;
+        std::fill(null_ready_.begin(), null_ready_.end(), 0);
+        return rows_;
+    }
+
+    /** Rows in the current block. */
+    int rows() const { return rows_; }
+
+    /**
+     * Typed span over a fixed-width column of the current block.
+     * T must match the column width (int64_t for BIGINT/TIMESTAMP,
+     * double for DOUBLE, int32_t for INT, ...).
+     */
+    template<typename T>
+    ColumnSpan<T> column(int col) const {
+        return ColumnSpan<T>(reinterpret_cast<const T*>(block_[col]), rows_);
+    }
+
+    /** NULL test for any column, computed once per column per block. */
+    bool is_null(int col, int row) {
+        if (!null_ready_[col]) {
+            if (null_capacity_ < rows_) {
+                for (auto& n : nulls_) n.reset();
+                null_capacity_ = rows_;
+            }
+            if (!nulls_[col]) nulls_[col].reset(new bool[null_capacity_]);
+            int rows = rows_;
+            if (taos_is_null_by_column(res_, col, nulls_[col].get(), &rows) != 0) {
+                std::memset(nulls_[col].get(), 0, sizeof(bool) * rows_);
+            }
+            null_ready_[col] = 1;
+        }
+        return nulls_[col][row];
+    }
+
+    /**
+     * Value of a BINARY/VARCHAR/NCHAR column (NCHAR is already UTF-8).
+     * Empty for NULL.
+     */
+    std::string_view str(int col, int row) const {
+        const int* offsets = taos_get_column_data_offset(res_, col);
+        if (offsets == nullptr || offsets[row] < 0) return std::string_view();
+        const char* p = static_cast<const char*>(block_[col]) + offsets[row];
+        uint16_t len;
+        std::memcpy(&len, p, sizeof(len));
+        return std::string_view(p + sizeof(len), len);
+    }
+
+    /** Integer value of any integral/timestamp/bool column. */
+    int64_t get_int64(int col, int row) const {
+        const void* base = block_[col];
+        switch (fields_[col].type) {
+            case TSDB_DATA_TYPE_BOOL:
+            case TSDB_DATA_TYPE_TINYINT:   return static_cast<const int8_t*>(base)[row];
+            case TSDB_DATA_TYPE_UTINYINT:  return static_cast<const uint8_t*>(base)[row];
+            case TSDB_DATA_TYPE_SMALLINT:  return static_cast<const int16_t*>(base)[row];
+            case TSDB_DATA_TYPE_USMALLINT: return static_cast<const uint16_t*>(base)[row];
+            case TSDB_DATA_TYPE_INT:       return static_cast<const int32_t*>(base)[row];
+            case TSDB_DATA_TYPE_UINT:      return static_cast<const uint32_t*>(base)[row];
+            case TSDB_DATA_TYPE_BIGINT:
+            case TSDB_DATA_TYPE_TIMESTAMP:
+            case TSDB_DATA_TYPE_UBIGINT:   return static_cast<const int64_t*>(base)[row];
+            case TSDB_DATA_TYPE_FLOAT:     return static_cast<int64_t>(static_cast<const float*>(base)[row]);
+            case TSDB_DATA_TYPE_DOUBLE:    return static_cast<int64_t>(static_cast<const double*>(base)[row]);
+            default:                       return 0;
+        }
+    }
+
+    /** Floating-point value of any numeric column. */
+    double get_double(int col, int row) const {
+        switch (fields_[col].type) {
+            case TSDB_DATA_TYPE_DOUBLE: return static_cast<const double*>(block_[col])[row];
+            case TSDB_DATA_TYPE_FLOAT:  return static_cast<const float*>(block_[col])[row];
+            default:                    return static_cast<double>(get_int64(col, row));
+        }
+    }
+
+    /** Free the result set early, e.g. before closing its connection. */
+    void close() {
+        if (res_ && owned_) taos_free_result(res_);
+        res_ = nullptr;
+        block_ = nullptr;
+        rows_ = 0;
+    }
+
+    /** Underlying result handle (still owned by the reader). */
+    TAOS_RES* handle() const { return res_; }
+
+private:
+    TAOS_RES* res_ = nullptr;
+    bool owned_ = true;
+    int code_ = 0;
+    std::string error_;
+    int num_fields_ = 0;
+    TAOS_FIELD* fields_ = nullptr;
+    TAOS_ROW block_ = nullptr;
+    int rows_ = 0;
+    std::vector<std::unique_ptr<bool[]>> nulls_;
+    int null_capacity_ = 0;
+    std::vector<char> null_ready_;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_RESULT_READER_H
@@ -0,0 +1,99 @@
+/**
+ * @file sky_density.h
+ * @brief Per-pixel source counts at every HEALPix order, pre-encoded.
+ *
+ * A sky heat map needs the number of sources in each pixel, not a
+ * sample of objects. SkyDensity takes the counts at the table's order
+ * (NESTED, so the four children of pixel p are 4p..4p+3), sums them
+ * down to order 0 and encodes every order once as a little-endian
+ * array. Serving a map is then a lookup of a ready string.
+ *
+ * Encoding of one order (24-byte header, then the counts):
+ *
+ *   0   "TDHD"
+ *   4   u16 version (1)
+ *   6   u16 order
+ *   8   u32 npix = 12 * 4^order
+ *   12  u32 largest count
+ *   16  u64 total sources
+ *   24  u32[npix] sources per NESTED pixel
+ */
+
+#ifndef TDLIGHT_SKY_DENSITY_H
+#define TDLIGHT_SKY_DENSITY_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+namespace tdlight {
+
+class SkyDensity {
+public:
+    /** @p counts has one entry per NESTED pixel at @p order (12 * 4^order). */
+    SkyDensity(std::vector<uint32_t> counts, int order) {
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "density maps are written in host order");
+        counts.resize(npix(order));
+        encoded_.resize(order + 1);
+        for (int o = order; o >= 0; o--) {
+            encoded_[o] = encode(counts, o);
+            if (o == 0) break;
+            std::vector<uint32_t> parent(npix(o - 1));
+            for (size_t p = 0; p < parent.size(); p++) {
+                parent[p] = counts[4 * p] + counts[4 * p + 1] + counts[4 * p + 2] + counts[4 * p + 3];
+            }
+            counts.swap(parent);
+        }
+        for (uint32_t c : counts) total_ += c;
+    }
+
+    static size_t npix(int order) { return size_t(12) << (2 * order); }
+
+    /** Add one source at NESTED pixel @p pixel of @p order (ignored if out of range). */
+    static void count(std::vector<uint32_t>& counts, int order, int64_t pixel) {
+        if (counts.size() != npix(order)) counts.assign(npix(order), 0);
+        if (pixel >= 0 && static_cast<size_t>(pixel) < counts.size()) counts[pixel]++;
+    }
+
+    int max_order() const { return static_cast<int>(encoded_.size()) - 1; }
+    uint64_t total() const { return total_; }
+
+    /** Encoded map at @p order, 0 <= order <= max_order(). */
+    const std::string& encoded(int order) const { return encoded_[order]; }
+
+    /** Approximate heap footprint. */
+    size_t memory_bytes() const {
+        size_t bytes = 0;
+        for (const auto& e : encoded_) bytes += e.capacity();
+        return bytes;
+    }
+
+private:
+    std::string encode(const std::vector<uint32_t>& counts, int order) const {
+        std::string out(24 + counts.size() * 4, '\0');
+        char* p = &out[0];
+        auto put = [&p](const void* v, size_t len) { std::memcpy(p, v, len); p += len; };
+        uint16_t version = 1, ord = static_cast<uint16_t>(order);
+        uint32_t n = static_cast<uint32_t>(counts.size());
+        uint32_t largest = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+        uint64_t total = 0;
+        for (uint32_t c : counts) total += c;
+        put("TDHD", 4);
+        put(&version, 2);
+        put(&ord, 2);
+        put(&n, 4);
+        put(&largest, 4);
+        put(&total, 8);
+        put(counts.data(), counts.size() * 4);
+        return out;
+    }
+
+    std::vector<std::string> encoded_;
+    uint64_t total_ = 0;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_SKY_DENSITY_H
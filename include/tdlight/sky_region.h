@@ -0,0 +1,527 @@
+/**
+ * @file sky_region.h
+ * @brief Polygon, RA/Dec box and MOC footprints as HEALPix pixel sets plus exact tests.
+ *
+ * A region query runs in two steps: the footprint is turned into the
+ * NESTED HEALPix pixels that may contain matching rows (pruning on the
+ * healpix_id tag), then every candidate row is tested exactly against
+ * the footprint. The exact test works on whole blocks of ra/dec values
+ * so it can run directly over ResultReader column spans.
+ *
+ * Typical use:
+ *
+ *   tdlight::SkyPolygon poly(tdlight::parse_vertex_list("10,20,12,20,11,22"));
+ *   std::vector<int> pixels = poly.pixels(healpix_base);
+ *   ...
+ *   poly.contains(ra.data(), dec.data(), n, inside.data());
+ */
+
+#ifndef TDLIGHT_SKY_REGION_H
+#define TDLIGHT_SKY_REGION_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <healpix_cxx/healpix_base.h>
+#include <healpix_cxx/pointing.h>
+#include <healpix_cxx/moc.h>
+#include <healpix_cxx/moc_fitsio.h>
+
+namespace tdlight {
+
+namespace detail {
+
+constexpr double kDeg2Rad = 3.14159265358979323846 / 180.0;
+
+struct Vec3 {
+    double x, y, z;
+};
+
+inline Vec3 radec_to_vec(double ra_deg, double dec_deg) {
+    double ra = ra_deg * kDeg2Rad, dec = dec_deg * kDeg2Rad;
+    return {std::cos(dec) * std::cos(ra), std::cos(dec) * std::sin(ra), std::sin(dec)};
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+inline double dot(const Vec3& a, const Vec3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 normalized(const Vec3& a) {
+    double n = std::sqrt(dot(a, a));
+    return {a.x / n, a.y / n, a.z / n};
+}
+
+} // namespace detail
+
+/** Parse "ra1,dec1,ra2,dec2,..." (degrees) into vertex pairs. */
+inline std::vector<std::pair<double, double>> parse_vertex_list(const std::string& text) {
+    std::vector<double> values;
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t used = 0;
+        double v = 0;
+        try {
+            v = std::stod(item, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0) throw std::invalid_argument("Invalid polygon coordinate: '" + item + "'");
+        values.push_back(v);
+    }
+    if (values.size() % 2 != 0) {
+        throw std::invalid_argument("Polygon needs ra,dec pairs");
+    }
+    std::vector<std::pair<double, double>> vertices;
+    for (size_t i = 0; i < values.size(); i += 2) {
+        vertices.emplace_back(values[i], values[i + 1]);
+    }
+    return vertices;
+}
+
+/**
+ * healpix_id condition for a sorted pixel set. Footprints cover long
+ * runs of consecutive NESTED pixels, which are written as BETWEEN
+ * ranges instead of thousands of IN entries.
+ */
+inline std::string pixel_condition(const std::vector<int>& pixels) {
+    std::vector<std::string> terms;
+    std::ostringstream singles;
+    int single_count = 0;
+    for (size_t i = 0; i < pixels.size();) {
+        size_t j = i;
+        while (j + 1 < pixels.size() && pixels[j + 1] == pixels[j] + 1) j++;
+        if (j - i >= 2) {
+            terms.push_back("healpix_id BETWEEN " + std::to_string(pixels[i]) + " AND " + std::to_string(pixels[j]));
+        } else {
+            for (size_t k = i; k <= j; k++) {
+                singles << (single_count++ ? "," : "") << pixels[k];
+            }
+        }
+        i = j + 1;
+    }
+    if (single_count > 0) terms.push_back("healpix_id IN (" + singles.str() + ")");
+
+    std::string cond;
+    for (size_t i = 0; i < terms.size(); i++) {
+        if (i > 0) cond += " OR ";
+        cond += terms[i];
+    }
+    return terms.size() > 1 ? "(" + cond + ")" : cond;
+}
+
+/** A sky footprint that can be pruned with HEALPix and tested exactly. */
+class SkyRegion {
+public:
+    virtual ~SkyRegion() = default;
+
+    /** NESTED pixels of @p base that may contain points of the region. */
+    virtual std::vector<int> pixels(const Healpix_Base& base) const = 0;
+
+    /**
+     * Exact membership of @p n points (degrees): sets inside[i] to 1 or 0.
+     */
+    virtual void contains(const double* ra, const double* dec, int n, uint8_t* inside) const = 0;
+
+    /** One-line description for logs. */
+    virtual std::string describe() const = 0;
+};
+
+/**
+ * Simple spherical polygon (edges are great-circle arcs) smaller than a
+ * hemisphere, vertices in either winding order. Non-convex polygons are
+ * split into triangles by ear clipping in the gnomonic projection about
+ * the vertex centroid, which maps great circles to straight lines, so
+ * the pieces cover the polygon exactly.
+ */
+class SkyPolygon : public SkyRegion {
+public:
+    explicit SkyPolygon(const std::vector<std::pair<double, double>>& vertices) {
+        using namespace detail;
+        for (const auto& v : vertices) {
+            if (v.second < -90.0 || v.second > 90.0) {
+                throw std::invalid_argument("Polygon DEC out of range [-90, 90]");
+            }
+            Vec3 p = radec_to_vec(v.first, v.second);
+            if (!points_.empty() && dot(p, points_.back()) > 1.0 - 1e-15) continue;   // repeated vertex
+            points_.push_back(p);
+        }
+        if (points_.size() > 1 && dot(points_.front(), points_.back()) > 1.0 - 1e-15) points_.pop_back();
+        if (points_.size() < 3) throw std::invalid_argument("Polygon needs at least 3 distinct vertices");
+        vertex_count_ = points_.size();
+
+        // Gnomonic frame about the centroid; every vertex must lie in its hemisphere
+        Vec3 sum{0, 0, 0};
+        for (const auto& p : points_) sum = {sum.x + p.x, sum.y + p.y, sum.z + p.z};
+        if (dot(sum, sum) < 1e-20) throw std::invalid_argument("Polygon is larger than a hemisphere");
+        Vec3 c = normalized(sum);
+        for (const auto& p : points_) {
+            if (dot(p, c) <= 1e-9) throw std::invalid_argument("Polygon is larger than a hemisphere");
+        }
+        Vec3 axis = std::fabs(c.z) < 0.9 ? Vec3{0, 0, 1} : Vec3{1, 0, 0};
+        Vec3 e1 = normalized(cross(axis, c));
+        Vec3 e2 = cross(c, e1);
+
+        std::vector<std::pair<double, double>> plane;
+        for (const auto& p : points_) {
+            double w = dot(p, c);
+            plane.emplace_back(dot(p, e1) / w, dot(p, e2) / w);
+        }
+
+        // Counter-clockwise in the projection means edge normals point inward
+        double area = 0;
+        for (size_t i = 0; i < plane.size(); i++) {
+            const auto& a = plane[i];
+            const auto& b = plane[(i + 1) % plane.size()];
+            area += a.first * b.second - b.first * a.second;
+        }
+        if (area < 0) {
+            std::reverse(points_.begin(), points_.end());
+            std::reverse(plane.begin(), plane.end());
+        }
+
+        std::vector<size_t> ring(points_.size());
+        for (size_t i = 0; i < ring.size(); i++) ring[i] = i;
+        dropCollinear(ring, plane);
+        if (ring.size() < 3) throw std::invalid_argument("Polygon has zero area");
+        if (selfIntersects(ring, plane)) throw std::invalid_argument("Polygon edges cross each other");
+
+        bool convex = true;
+        for (size_t i = 0; i < ring.size() && convex; i++) {
+            convex = turn(plane, ring[i], ring[(i + 1) % ring.size()], ring[(i + 2) % ring.size()]) > 0;
+        }
+        if (convex) {
+            addPiece(ring, std::vector<char>(ring.size(), 1));
+        } else {
+            triangulate(ring, plane);
+        }
+    }
+
+    std::vector<int> pixels(const Healpix_Base& base) const override {
+        std::vector<int> result;
+        int fact = base.Scheme() == NEST ? 4 : 1;
+        for (const auto& piece : pieces_) {
+            std::vector<int> part = base.query_polygon_inclusive(piece.vertices, fact).toVector();
+            result.insert(result.end(), part.begin(), part.end());
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    void contains(const double* ra, const double* dec, int n, uint8_t* inside) const override {
+        // Unit vectors once per block, then one dot product per edge;
+        // the inner loops are branch-free so the compiler can vectorize them
+        std::vector<double> x(n), y(n), z(n);
+        std::vector<uint8_t> in_piece(n);
+        for (int i = 0; i < n; i++) {
+            double r = ra[i] * detail::kDeg2Rad, d = dec[i] * detail::kDeg2Rad;
+            double cd = std::cos(d);
+            x[i] = cd * std::cos(r);
+            y[i] = cd * std::sin(r);
+            z[i] = std::sin(d);
+        }
+        std::fill(inside, inside + n, 0);
+        for (const auto& piece : pieces_) {
+            std::fill(in_piece.begin(), in_piece.end(), 1);
+            for (const auto& edge : piece.edges) {
+                const double nx = edge.normal.x, ny = edge.normal.y, nz = edge.normal.z;
+                const double limit = edge.limit;
+                for (int i = 0; i < n; i++) {
+                    in_piece[i] &= static_cast<uint8_t>(nx * x[i] + ny * y[i] + nz * z[i] >= limit);
+                }
+            }
+            for (int i = 0; i < n; i++) inside[i] |= in_piece[i];
+        }
+    }
+
+    std::string describe() const override {
+        return "polygon, " + std::to_string(vertex_count_) + " vertices, " +
+               std::to_string(pieces_.size()) + (pieces_.size() == 1 ? " convex piece" : " convex pieces");
+    }
+
+    size_t piece_count() const { return pieces_.size(); }
+
+private:
+    struct Edge {
+        detail::Vec3 normal;              // unit normal of the edge's great circle, pointing inward
+        double limit;                     // 0 on the boundary, slightly negative on internal diagonals
+    };
+    struct Piece {
+        std::vector<Edge> edges;
+        std::vector<pointing> vertices;
+    };
+
+    using Plane = std::vector<std::pair<double, double>>;
+
+    static double turn(const Plane& p, size_t a, size_t b, size_t c) {
+        return (p[b].first - p[a].first) * (p[c].second - p[a].second) -
+               (p[b].second - p[a].second) * (p[c].first - p[a].first);
+    }
+
+    // Remove vertices lying on the line through their neighbours
+    static void dropCollinear(std::vector<size_t>& ring, const Plane& plane) {
+        bool changed = true;
+        while (changed && ring.size() >= 3) {
+            changed = false;
+            for (size_t i = 0; i < ring.size(); i++) {
+                size_t a = ring[(i + ring.size() - 1) % ring.size()], b = ring[i], c = ring[(i + 1) % ring.size()];
+                double scale = std::hypot(plane[c].first - plane[a].first, plane[c].second - plane[a].second);
+                if (std::fabs(turn(plane, a, b, c)) <= 1e-14 * (1 + scale * scale)) {
+                    ring.erase(ring.begin() + i);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    static bool selfIntersects(const std::vector<size_t>& ring, const Plane& p) {
+        size_t n = ring.size();
+        for (size_t i = 0; i < n; i++) {
+            size_t a = ring[i], b = ring[(i + 1) % n];
+            for (size_t j = i + 2; j < n; j++) {
+                if (i == 0 && j == n - 1) continue;                     // adjacent through the wrap
+                size_t c = ring[j], d = ring[(j + 1) % n];
+                if (turn(p, a, b, c) * turn(p, a, b, d) < 0 && turn(p, c, d, a) * turn(p, c, d, b) < 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // @p boundary[i] marks whether edge ring[i] -> ring[i+1] is a polygon edge
+    void addPiece(const std::vector<size_t>& ring, const std::vector<char>& boundary) {
+        Piece piece;
+        for (size_t i = 0; i < ring.size(); i++) {
+            const detail::Vec3& a = points_[ring[i]];
+            const detail::Vec3& b = points_[ring[(i + 1) % ring.size()]];
+            piece.edges.push_back({detail::normalized(detail::cross(a, b)), boundary[i] ? 0.0 : -1e-12});
+            piece.vertices.emplace_back(vec3(a.x, a.y, a.z));
+        }
+        pieces_.push_back(std::move(piece));
+    }
+
+    static bool insideTriangle(const Plane& p, size_t a, size_t b, size_t c, size_t q) {
+        return turn(p, a, b, q) >= 0 && turn(p, b, c, q) >= 0 && turn(p, c, a, q) >= 0;
+    }
+
+    void triangulate(std::vector<size_t> ring, const Plane& plane) {
+        // Polygon edges keep the exact test; diagonals get a small tolerance
+        std::set<std::pair<size_t, size_t>> boundary;
+        for (size_t i = 0; i < ring.size(); i++) boundary.insert({ring[i], ring[(i + 1) % ring.size()]});
+        auto edge = [&](size_t a, size_t b) { return static_cast<char>(boundary.count({a, b}) > 0); };
+
+        while (ring.size() > 3) {
+            bool clipped = false;
+            for (size_t i = 0; i < ring.size() && !clipped; i++) {
+                size_t a = ring[(i + ring.size() - 1) % ring.size()], b = ring[i], c = ring[(i + 1) % ring.size()];
+                if (turn(plane, a, b, c) <= 0) continue;                  // reflex corner
+                bool empty = true;
+                for (size_t q : ring) {
+                    if (q != a && q != b && q != c && insideTriangle(plane, a, b, c, q)) {
+                        empty = false;
+                        break;
+                    }
+                }
+                if (!empty) continue;
+                addPiece({a, b, c}, {edge(a, b), edge(b, c), edge(c, a)});
+                ring.erase(ring.begin() + i);
+                clipped = true;
+            }
+            if (!clipped) throw std::invalid_argument("Polygon edges cross each other");
+        }
+        addPiece(ring, {edge(ring[0], ring[1]), edge(ring[1], ring[2]), edge(ring[2], ring[0])});
+    }
+
+    std::vector<detail::Vec3> points_;
+    std::vector<Piece> pieces_;
+    size_t vertex_count_ = 0;
+};
+
+/**
+ * RA/Dec box: dec_min <= dec <= dec_max, RA running east from ra_min to
+ * ra_max. ra_min > ra_max wraps through 0/360 (350..10 is 20 degrees
+ * wide); a span of 360 or more covers every RA. Pixels are collected
+ * ring by ring over the dec strip, testing only the pixels of each ring
+ * near the RA range, so pruning costs time in proportion to the area.
+ */
+class SkyBox : public SkyRegion {
+public:
+    SkyBox(double ra_min, double ra_max, double dec_min, double dec_max)
+        : dec_min_(dec_min), dec_max_(dec_max) {
+        if (!(dec_min >= -90.0 && dec_max <= 90.0 && dec_min <= dec_max)) {
+            throw std::invalid_argument("Box needs -90 <= dec_min <= dec_max <= 90");
+        }
+        if (!std::isfinite(ra_min) || !std::isfinite(ra_max)) throw std::invalid_argument("Box RA is not a number");
+        all_ra_ = ra_max - ra_min >= 360.0;
+        ra_min_ = wrap360(ra_min);
+        width_ = all_ra_ ? 360.0 : wrap360(ra_max - ra_min);
+    }
+
+    std::vector<int> pixels(const Healpix_Base& base) const override {
+        using namespace detail;
+        // RING numbering walks iso-latitude rings; results are mapped back to the base's scheme
+        Healpix_Base rings(base.Nside(), RING, SET_NSIDE);
+        const double z_lo = std::sin(dec_min_ * kDeg2Rad), z_hi = std::sin(dec_max_ * kDeg2Rad);
+        const double lo = ra_min_ * kDeg2Rad, width = width_ * kDeg2Rad;
+        const int nrings = 4 * base.Nside() - 1;
+
+        std::vector<int> result;
+        std::vector<vec3> corners;
+        int start, count;
+        double theta, above = 0, below;
+        bool shifted;
+        for (int ring = 1; ring <= nrings; ring++, above = theta) {
+            rings.get_ring_info2(ring, start, count, theta, shifted);
+            // A ring's pixels reach from the ring above to the ring below
+            if (ring < nrings) {
+                int s, c;
+                bool sh;
+                rings.get_ring_info2(ring + 1, s, c, below, sh);
+            } else {
+                below = M_PI;
+            }
+            if (std::cos(above) < z_lo || std::cos(below) > z_hi) continue;
+            const bool inner_ring = std::cos(above) <= z_hi && std::cos(below) >= z_lo;
+
+            // Pixels are at most two center spacings wide (polar caps)
+            const double step = 2 * M_PI / count, offset = shifted ? 0.5 : 0.0;
+            int first = 0, last = count - 1;
+            if (!all_ra_ && width + 4 * step < 2 * M_PI) {
+                first = static_cast<int>(std::floor((lo - 2 * step) / step - offset));
+                last = static_cast<int>(std::ceil((lo + width + 2 * step) / step - offset));
+            }
+            for (int k = first; k <= last; k++) {
+                int pix = start + ((k % count) + count) % count;
+                double center = (pix - start + offset) * step;
+                // Well inside the box: no need to look at the corners
+                bool inner = inner_ring && (all_ra_ || (wrap2pi(center - lo) >= 2 * step &&
+                                                        wrap2pi(center - lo) <= width - 2 * step));
+                if (!inner) rings.boundaries(pix, 1, corners);
+                if (inner || overlaps(corners, center, z_lo, z_hi, lo, width)) {
+                    result.push_back(base.Scheme() == NEST ? rings.ring2nest(pix) : pix);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    void contains(const double* ra, const double* dec, int n, uint8_t* inside) const override {
+        for (int i = 0; i < n; i++) {
+            inside[i] = static_cast<uint8_t>(dec[i] >= dec_min_ && dec[i] <= dec_max_ &&
+                                             (all_ra_ || wrap360(ra[i] - ra_min_) <= width_));
+        }
+    }
+
+    std::string describe() const override {
+        std::ostringstream out;
+        out << "box, RA " << ra_min_ << " +" << width_ << " deg, DEC " << dec_min_ << ".." << dec_max_;
+        return out.str();
+    }
+
+private:
+    static double wrap360(double deg) {
+        double r = std::fmod(deg, 360.0);
+        return r < 0 ? r + 360.0 : r;
+    }
+
+    static double wrap2pi(double rad) {
+        double r = std::fmod(rad, 2 * M_PI);
+        return r < 0 ? r + 2 * M_PI : r;
+    }
+
+    // Does the RA/z bounding box of a pixel (corners, center phi) meet the box?
+    static bool overlaps(const std::vector<vec3>& corners, double center, double z_lo, double z_hi,
+                         double lo, double width) {
+        const double eps = 1e-9;
+        double zmin = 1, zmax = -1, dmin = 0, dmax = 0;
+        for (const vec3& c : corners) {
+            zmin = std::min(zmin, c.z);
+            zmax = std::max(zmax, c.z);
+            if (std::fabs(c.z) > 1 - 1e-12) continue;                   // pole: no RA of its own
+            double d = std::remainder(std::atan2(c.y, c.x) - center, 2 * M_PI);
+            dmin = std::min(dmin, d);
+            dmax = std::max(dmax, d);
+        }
+        if (zmax < z_lo - eps || zmin > z_hi + eps) return false;
+        double first = center + dmin, span = dmax - dmin;
+        return wrap2pi(first - lo) <= width + eps || wrap2pi(lo - first) <= span + eps;
+    }
+
+    double ra_min_ = 0, width_ = 0;
+    double dec_min_, dec_max_;
+    bool all_ra_ = false;
+};
+
+/**
+ * Multi-Order Coverage map read from a FITS file (IVOA MOC, NUNIQ
+ * column). Pixel pruning degrades the MOC to the table's order; the
+ * exact test looks each point up at the MOC's own finest order.
+ */
+class MocRegion : public SkyRegion {
+public:
+    explicit MocRegion(const std::string& filename) : filename_(filename) {
+        Moc<int64> moc;
+        try {
+            moc = read_Moc_from_fits<int64>(filename);
+        } catch (const PlanckError& e) {
+            throw std::runtime_error("Cannot read MOC " + filename + ": " + e.what());
+        }
+        ranges_ = moc.Rs();
+        if (ranges_.nranges() == 0) throw std::runtime_error("MOC " + filename + " is empty");
+        order_ = static_cast<int>(moc.maxOrder());
+        lookup_ = Healpix_Base2(order_, NEST);
+        shift_ = 2 * (Moc<int64>::maxorder - order_);
+    }
+
+    std::vector<int> pixels(const Healpix_Base& base) const override {
+        // Ranges are stored at the maximum order; shift them down to the
+        // table's order, keeping every partially covered pixel
+        int shift = 2 * (Moc<int64>::maxorder - base.Order());
+        std::vector<int> result;
+        for (tsize i = 0; i < ranges_.nranges(); i++) {
+            int first = static_cast<int>(ranges_.ivbegin(i) >> shift);
+            int last = static_cast<int>((ranges_.ivend(i) - 1) >> shift);
+            if (!result.empty() && first <= result.back()) first = result.back() + 1;
+            for (int pix = first; pix <= last; pix++) result.push_back(pix);
+        }
+        return result;
+    }
+
+    void contains(const double* ra, const double* dec, int n, uint8_t* inside) const override {
+        for (int i = 0; i < n; i++) {
+            pointing pt(detail::kDeg2Rad * (90.0 - dec[i]), detail::kDeg2Rad * ra[i]);
+            inside[i] = ranges_.contains(lookup_.ang2pix(pt) << shift_) ? 1 : 0;
+        }
+    }
+
+    std::string describe() const override {
+        return "MOC " + filename_ + ", order " + std::to_string(order_) + ", " +
+               std::to_string(ranges_.nranges()) + " ranges";
+    }
+
+private:
+    std::string filename_;
+    rangeset<int64> ranges_;              // NESTED cells at Moc::maxorder
+    int order_ = 0;                       // finest order present in the MOC
+    int shift_ = 0;
+    Healpix_Base2 lookup_;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_SKY_REGION_H
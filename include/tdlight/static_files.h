@@ -0,0 +1,129 @@
+/**
+ * @file static_files.h
+ * @brief Static web assets served from memory, precompressed, with ETags.
+ *
+ * index.html and app.js used to be read from disk on every request and
+ * sent uncompressed with caching disabled. StaticFileCache keeps each
+ * file in memory together with its gzip encoding (compressed once, at
+ * the best level) and a strong ETag per encoding. A file is reloaded
+ * when its size or mtime changes, so edits during development still
+ * show up at once. static_response() sends the gzip body to clients that
+ * accept it and answers If-None-Match with 304 when the client holds
+ * that representation.
+ */
+
+#ifndef TDLIGHT_STATIC_FILES_H
+#define TDLIGHT_STATIC_FILES_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdint>
+#include <sys/stat.h>
+#include "http_compress.h"
+
+namespace tdlight {
+
+struct StaticFile {
+    std::string content_type;
+    std::string body;
+    std::string gzip;           // empty if compression does not pay off
+    std::string etag;           // quoted, e.g. "\"1f3a...\""
+    std::string gzip_etag;      // etag of the gzip body, e.g. "\"1f3a...-gzip\""
+    time_t mtime = 0;
+    off_t size = 0;
+};
+
+class StaticFileCache {
+public:
+    /** Current contents of @p path, or nullptr if it cannot be read. */
+    std::shared_ptr<const StaticFile> get(const std::string& path, const std::string& content_type) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = files_.find(path);
+            if (it != files_.end() && it->second->mtime == st.st_mtime && it->second->size == st.st_size) {
+                return it->second;
+            }
+        }
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return nullptr;
+        std::ostringstream data;
+        data << in.rdbuf();
+
+        auto file = std::make_shared<StaticFile>();
+        file->content_type = content_type;
+        file->body = data.str();
+        file->mtime = st.st_mtime;
+        file->size = st.st_size;
+        if (http_compressible(content_type) && file->body.size() >= kGzipMinBytes) {
+            file->gzip = gzip_compress(file->body, Z_BEST_COMPRESSION);
+            if (file->gzip.size() >= file->body.size()) file->gzip.clear();
+        }
+
+        // FNV-1a over the contents
+        uint64_t hash = 1469598103934665603ULL;
+        for (unsigned char c : file->body) hash = (hash ^ c) * 1099511628211ULL;
+        char etag[24];
+        std::snprintf(etag, sizeof(etag), "\"%016llx\"", static_cast<unsigned long long>(hash));
+        file->etag = etag;
+        file->gzip_etag = file->etag.substr(0, file->etag.size() - 1) + "-gzip\"";
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_[path] = file;
+        return file;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const StaticFile>> files_;
+};
+
+/** True if the request's If-None-Match lists @p etag (or is "*"). */
+inline bool http_etag_matches(std::string_view request, std::string_view etag) {
+    std::string_view tags = http_header(request, "If-None-Match");
+    while (!tags.empty()) {
+        size_t comma = tags.find(',');
+        std::string_view tag = tags.substr(0, comma);
+        tags = comma == std::string_view::npos ? std::string_view() : tags.substr(comma + 1);
+        while (!tag.empty() && tag.front() == ' ') tag.remove_prefix(1);
+        while (!tag.empty() && tag.back() == ' ') tag.remove_suffix(1);
+        if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+        if (tag == "*" || tag == etag) return true;
+    }
+    return false;
+}
+
+/**
+ * 200 with the gzip body when accepted, or 304 if the client's copy of
+ * that representation is current. The 304 carries the headers of the
+ * 200 it stands for, Content-Length included. "Cache-Control: no-cache"
+ * makes browsers revalidate every time, which costs one small 304.
+ */
+inline std::string static_response(const StaticFile& file, std::string_view request) {
+    bool gzip = !file.gzip.empty() && http_accepts_gzip(request);
+    const std::string& body = gzip ? file.gzip : file.body;
+    const std::string& etag = gzip ? file.gzip_etag : file.etag;
+    std::string head = "Content-Type: " + file.content_type + "\r\n"
+                       "ETag: " + etag + "\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Vary: Accept-Encoding\r\n" +
+                       (gzip ? "Content-Encoding: gzip\r\n" : "") +
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "\r\n";
+    if (http_etag_matches(request, etag)) {
+        return "HTTP/1.1 304 Not Modified\r\n" + head;
+    }
+    return "HTTP/1.1 200 OK\r\n" + head + body;
+}
+
+} // namespace tdlight
+
+#endif // TDLIGHT_STATIC_FILES_H
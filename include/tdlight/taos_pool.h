@@ -0,0 +1,191 @@
+/**
+ * @file taos_pool.h
+ * @brief Bounded TDengine connection pool for TDlight.
+ *
+ * A single TAOS* connection executes one query at a time, so tools
+ * that run independent queries in parallel check connections out of
+ * this pool instead of sharing one handle. Connections are opened
+ * lazily up to the configured size and reused afterwards.
+ * reconfigure() switches host/database for all later checkouts.
+ */
+
+#ifndef TDLIGHT_TAOS_POOL_H
+#define TDLIGHT_TAOS_POOL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <taos.h>
+
+namespace tdlight {
+
+/**
+ * Connection parameters shared by every connection of a pool.
+ */
+struct ConnectionParams {
+    std::string host = "localhost";
+    std::string user = "root";
+    std::string password = "taosdata";
+    std::string database;             // empty = connect without a default DB
+    int port = 6030;
+};
+
+class ConnectionPool {
+public:
+    /**
+     * RAII handle for a checked-out connection.
+     * Returns the connection to the pool when it goes out of scope.
+     */
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(ConnectionPool* pool, TAOS* conn, uint64_t generation)
+            : pool_(pool), conn_(conn), generation_(generation) {}
+        Lease(Lease&& other) noexcept
+            : pool_(other.pool_), conn_(other.conn_), generation_(other.generation_) {
+            other.pool_ = nullptr;
+            other.conn_ = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                reset();
+                pool_ = other.pool_;
+                conn_ = other.conn_;
+                generation_ = other.generation_;
+                other.pool_ = nullptr;
+                other.conn_ = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { reset(); }
+
+        TAOS* get() const { return conn_; }
+        explicit operator bool() const { return conn_ != nullptr; }
+
+        /** Return the connection early. */
+        void reset() {
+            if (pool_ && conn_) pool_->release(conn_, generation_);
+            pool_ = nullptr;
+            conn_ = nullptr;
+        }
+
+    private:
+        ConnectionPool* pool_ = nullptr;
+        TAOS* conn_ = nullptr;
+        uint64_t generation_ = 0;     // pool configuration it was opened with
+    };
+
+    ConnectionPool(const ConnectionParams& params, size_t max_size)
+        : params_(params), max_size_(max_size > 0 ? max_size : 1) {}
+
+    ~ConnectionPool() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (TAOS* c : idle_) taos_close(c);
+        idle_.clear();
+    }
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * Check out a connection, blocking while all of them are in use.
+     * The lease is empty if a new connection could not be opened.
+     */
+    Lease checkout() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !idle_.empty() || open_ < max_size_; });
+
+        if (!idle_.empty()) {
+            TAOS* c = idle_.back();
+            idle_.pop_back();
+            return Lease(this, c, generation_);
+        }
+
+        // Open a new connection outside the lock; the slot is reserved first
+        open_++;
+        ConnectionParams params = params_;
+        uint64_t generation = generation_;
+        lock.unlock();
+
+        TAOS* c = taos_connect(params.host.c_str(), params.user.c_str(),
+                               params.password.c_str(),
+                               params.database.empty() ? nullptr : params.database.c_str(),
+                               params.port);
+        if (c == nullptr) {
+            lock.lock();
+            open_--;
+            cv_.notify_one();
+            return Lease();
+        }
+        return Lease(this, c, generation);
+    }
+
+    /**
+     * Use @p params for every later checkout. Idle connections are closed
+     * now; connections still checked out are closed when returned.
+     */
+    void reconfigure(const ConnectionParams& params) {
+        std::vector<TAOS*> stale;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            params_ = params;
+            generation_++;
+            stale.swap(idle_);
+            open_ -= stale.size();
+        }
+        for (TAOS* c : stale) taos_close(c);
+        cv_.notify_all();
+    }
+
+    /**
+     * Open connections up to @p count ahead of time so the first
+     * queries do not pay for the connection handshake.
+     * Returns the number of connections now open.
+     */
+    size_t warm_up(size_t count) {
+        std::vector<Lease> leases;
+        for (size_t i = 0; i < count && i < max_size_; i++) {
+            Lease l = checkout();
+            if (!l) break;
+            leases.push_back(std::move(l));
+        }
+        return leases.size();
+    }
+
+    size_t max_size() const { return max_size_; }
+
+    ConnectionParams params() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return params_;
+    }
+
+private:
+    void release(TAOS* c, uint64_t generation) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (generation != generation_) {
+            open_--;
+            lock.unlock();
+            taos_close(c);
+            cv_.notify_one();
+            return;
+        }
+        idle_.push_back(c);
+        cv_.notify_one();
+    }
+
+    ConnectionParams params_;
+    size_t max_size_;
+    size_t open_ = 0;                 // idle + checked out
+    uint64_t generation_ = 0;         // bumped by reconfigure()
+    std::vector<TAOS*> idle_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+} // namespace tdlight
+
+#endif // TDLIGHT_TAOS_POOL_H
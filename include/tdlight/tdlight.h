@@ -5,9 +5,24 @@
  * Convenience header that includes all TDlight modules.
  * 
  * Architecture:
- *   config.h     - Configuration management (load/save config.json)
- *   sanitize.h   - Input validation and sanitization (SQL, shell, path)
- *   http_utils.h - HTTP response construction and parsing
+ *   config.h        - Configuration management (load/save config.json)
+ *   sanitize.h      - Input validation and sanitization (SQL, shell, path)
+ *   http_utils.h    - HTTP response construction and parsing
+ *   http_server.h   - epoll HTTP server core with a bounded worker pool
+ *   chunked_response.h - Chunked HTTP responses streamed from a BufferedWriter
+ *   http_compress.h - gzip Content-Encoding (zlib)
+ *   static_files.h  - In-memory precompressed static assets with ETags
+ *   progress_hub.h  - inotify-driven SSE fan-out of job progress files
+ *   taos_pool.h     - Bounded TDengine connection pool
+ *   result_reader.h - Block-wise columnar decoding of query results
+ *   async_query.h   - Non-blocking queries (taos_query_a) with futures
+ *   query_cache.h   - LRU result cache invalidated by import generation
+ *   buffered_writer.h - Buffered text output with std::to_chars formatting
+ *   sky_region.h    - Polygon / box / MOC footprints: HEALPix pixels + exact tests
+ *   knn.h           - k-nearest-neighbour search by expanding HEALPix discs
+ *   object_catalog.h - In-memory per-source tag table sorted by HEALPix pixel
+ *   sky_density.h   - Per-pixel source counts at every HEALPix order, binary
+ *   downsample.h    - LTTB / min-max light-curve reduction for plotting
  * 
  * @see https://github.com/bestdo77/TD-light
  */
@@ -18,5 +33,20 @@
 #include "config.h"
 #include "sanitize.h"
 #include "http_utils.h"
+#include "http_server.h"
+#include "chunked_response.h"
+#include "http_compress.h"
+#include "static_files.h"
+#include "progress_hub.h"
+#include "taos_pool.h"
+#include "result_reader.h"
+#include "async_query.h"
+#include "query_cache.h"
+#include "buffered_writer.h"
+#include "sky_region.h"
+#include "knn.h"
+#include "object_catalog.h"
+#include "sky_density.h"
+#include "downsample.h"
 
 #endif // TDLIGHT_H
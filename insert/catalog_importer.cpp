@@ -27,6 +27,8 @@
 #include <taos.h>
 #include <healpix_cxx/healpix_base.h>
 #include <healpix_cxx/pointing.h>
+#include <tdlight/result_reader.h>
+#include <tdlight/query_cache.h>
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -206,12 +208,11 @@ unordered_map<long long, int64_t> perform_crossmatch(
     
     string sql = "SELECT source_id, ra, dec, healpix_id FROM " + super_table + 
                 " GROUP BY source_id, ra, dec, healpix_id";
-    TAOS_RES* res = taos_query(conn, sql.c_str());
+    tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
     
-    if (taos_errno(res) != 0) {
-        cerr << "  [WARN] Cross-match query failed: " << taos_errstr(res) << endl;
+    if (!reader.ok()) {
+        cerr << "  [WARN] Cross-match query failed: " << reader.error() << endl;
         cerr << "  [WARN] Using original source_id without cross-match" << endl;
-        taos_free_result(res);
         taos_close(conn);
         
         // Fallback: use original IDs
@@ -223,20 +224,27 @@ unordered_map<long long, int64_t> perform_crossmatch(
     
     // Load database objects
     vector<DBObject> db_objects;
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        if (row[0] == nullptr || row[1] == nullptr || row[2] == nullptr || row[3] == nullptr) {
-            continue;  // Skip invalid rows
+    while (int n = reader.next_block()) {
+        auto source_id = reader.column<int64_t>(0);
+        auto ra = reader.column<double>(1);
+        auto dec = reader.column<double>(2);
+        auto healpix_id = reader.column<int64_t>(3);
+        db_objects.reserve(db_objects.size() + n);
+        for (int r = 0; r < n; r++) {
+            if (reader.is_null(0, r) || reader.is_null(1, r) ||
+                reader.is_null(2, r) || reader.is_null(3, r)) {
+                continue;  // Skip invalid rows
+            }
+            
+            DBObject obj;
+            obj.source_id = source_id[r];
+            obj.ra = ra[r];
+            obj.dec = dec[r];
+            obj.healpix_id = healpix_id[r];
+            db_objects.push_back(obj);
         }
-        
-        DBObject obj;
-        obj.source_id = *(int64_t*)row[0];
-        obj.ra = *(double*)row[1];
-        obj.dec = *(double*)row[2];
-        obj.healpix_id = *(int64_t*)row[3];
-        db_objects.push_back(obj);
     }
-    taos_free_result(res);
+    reader.close();
     taos_close(conn);
     
     cout << "  [INFO] Loaded " << db_objects.size() << " objects from database" << endl;
@@ -995,6 +1003,9 @@ int main(int argc, char* argv[]) {
     for (auto& t : workers) t.join();
     monitor.join();
     
+    // Invalidate cached query results for this database
+    tdlight::bump_import_generation(db_name);
+    
     auto insert_end = high_resolution_clock::now();
     double insert_time = duration_cast<milliseconds>(insert_end - insert_start).count() / 1000.0;
     
@@ -23,6 +23,7 @@
 #include <cstring>
 
 #include <taos.h>
+#include <tdlight/result_reader.h>
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -180,10 +181,9 @@ int main(int argc, char* argv[]) {
     string sql = "SELECT source_id, healpix_id, FIRST(ra) as ra, FIRST(dec) as dec, COUNT(*) as cnt "
                  "FROM sensor_data GROUP BY source_id, healpix_id";
     
-    TAOS_RES* res = taos_query(conn, sql.c_str());
-    if (taos_errno(res) != 0) {
-        cerr << "[ERROR] Query failed: " << taos_errstr(res) << endl;
-        taos_free_result(res);
+    tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+    if (!reader.ok()) {
+        cerr << "[ERROR] Query failed: " << reader.error() << endl;
         taos_close(conn);
         write_progress(0, "Query failed", "error");
         return 1;
@@ -197,30 +197,37 @@ int main(int argc, char* argv[]) {
     int64_t read_count = 0;
     auto last_update = chrono::steady_clock::now();
     
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        SourceInfo info;
-        info.source_id = *(int64_t*)row[0];
-        info.healpix_id = *(int64_t*)row[1];
-        info.ra = *(double*)row[2];
-        info.dec = *(double*)row[3];
-        info.data_count = *(int64_t*)row[4];
-        current[info.source_id] = info;
-        read_count++;
+    while (int n = reader.next_block()) {
+        auto source_id = reader.column<int64_t>(0);
+        auto healpix_id = reader.column<int64_t>(1);
+        auto ra = reader.column<double>(2);
+        auto dec = reader.column<double>(3);
+        auto cnt = reader.column<int64_t>(4);
         
-        // Compare while reading
-        auto it = history.find(info.source_id);
-        if (it == history.end()) {
-            candidates.push_back({info, "new"});
-            new_count++;
-        } else {
-            int64_t old_count = it->second.data_count;
-            if (old_count > 0 && info.data_count > old_count) {
-                double growth = (double)(info.data_count - old_count) / old_count;
-                if (growth >= threshold) {
-                    string reason = "growth_" + to_string((int)(growth * 100)) + "%";
-                    candidates.push_back({info, reason});
-                    growth_count++;
+        for (int r = 0; r < n; r++) {
+            SourceInfo info;
+            info.source_id = source_id[r];
+            info.healpix_id = healpix_id[r];
+            info.ra = ra[r];
+            info.dec = dec[r];
+            info.data_count = cnt[r];
+            current[info.source_id] = info;
+            read_count++;
+            
+            // Compare while reading
+            auto it = history.find(info.source_id);
+            if (it == history.end()) {
+                candidates.push_back({info, "new"});
+                new_count++;
+            } else {
+                int64_t old_count = it->second.data_count;
+                if (old_count > 0 && info.data_count > old_count) {
+                    double growth = (double)(info.data_count - old_count) / old_count;
+                    if (growth >= threshold) {
+                        string reason = "growth_" + to_string((int)(growth * 100)) + "%";
+                        candidates.push_back({info, reason});
+                        growth_count++;
+                    }
                 }
             }
         }
@@ -234,7 +241,7 @@ int main(int argc, char* argv[]) {
             last_update = now;
         }
     }
-    taos_free_result(res);
+    reader.close();
     taos_close(conn);
     
     cout << "\r[OK] Read complete: " << current.size() << " objects, " << candidates.size() << " candidates    " << endl;
@@ -35,6 +35,7 @@
 #include <taos.h>
 #include <healpix_cxx/healpix_base.h>
 #include <healpix_cxx/pointing.h>
+#include <tdlight/result_reader.h>
 
 namespace fs = std::filesystem;
 using namespace std;
@@ -163,26 +164,31 @@ vector<DBObject> load_db_objects(const string& db_name, const string& super_tabl
     string sql = "SELECT source_id, ra, dec, healpix_id FROM " + super_table + 
                  " GROUP BY source_id, ra, dec, healpix_id";
     
-    TAOS_RES* res = taos_query(conn, sql.c_str());
-    if (taos_errno(res) != 0) {
-        cerr << "[ERROR] Query failed: " << taos_errstr(res) << endl;
-        taos_free_result(res);
-        taos_close(conn);
-        return {};
-    }
-    
     vector<DBObject> db_objects;
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        DBObject obj;
-        obj.source_id = *(int64_t*)row[0];
-        obj.ra = *(double*)row[1];
-        obj.dec = *(double*)row[2];
-        obj.healpix_id = *(int64_t*)row[3];
-        db_objects.push_back(obj);
+    {
+        tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+        if (!reader.ok()) {
+            cerr << "[ERROR] Query failed: " << reader.error() << endl;
+            taos_close(conn);
+            return {};
+        }
+        
+        while (int n = reader.next_block()) {
+            auto source_id = reader.column<int64_t>(0);
+            auto ra = reader.column<double>(1);
+            auto dec = reader.column<double>(2);
+            auto healpix_id = reader.column<int64_t>(3);
+            db_objects.reserve(db_objects.size() + n);
+            for (int r = 0; r < n; r++) {
+                DBObject obj;
+                obj.source_id = source_id[r];
+                obj.ra = ra[r];
+                obj.dec = dec[r];
+                obj.healpix_id = healpix_id[r];
+                db_objects.push_back(obj);
+            }
+        }
     }
-    
-    taos_free_result(res);
     taos_close(conn);
     
     auto end = high_resolution_clock::now();
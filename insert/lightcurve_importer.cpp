@@ -20,6 +20,7 @@
 #include <mutex>
 #include <atomic>
 #include <map>
+#include <unordered_map>
 #include <chrono>
 #include <cmath>
 #include <cstring>
@@ -29,6 +30,8 @@
 
 #include <taos.h>
 #include <healpix_cxx/healpix_base.h>
+#include <tdlight/result_reader.h>
+#include <tdlight/query_cache.h>
 
 using namespace std;
 using namespace std::chrono;
@@ -223,22 +226,27 @@ unordered_map<int64_t, int64_t> perform_crossmatch(
 
     string sql = "SELECT source_id, ra, dec, healpix_id FROM " + super_table +
                  " GROUP BY source_id, ra, dec, healpix_id";
-    TAOS_RES* res = taos_query(conn, sql.c_str());
+    tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
 
     vector<DBObject> db_objects;
-    if (taos_errno(res) == 0) {
-        TAOS_ROW row;
-        while ((row = taos_fetch_row(res)) != nullptr) {
-            if (!row[0] || !row[1] || !row[2] || !row[3]) continue;
+    while (int n = reader.next_block()) {
+        auto source_id = reader.column<int64_t>(0);
+        auto ra = reader.column<double>(1);
+        auto dec = reader.column<double>(2);
+        auto healpix_id = reader.column<int64_t>(3);
+        db_objects.reserve(db_objects.size() + n);
+        for (int r = 0; r < n; r++) {
+            if (reader.is_null(0, r) || reader.is_null(1, r) ||
+                reader.is_null(2, r) || reader.is_null(3, r)) continue;
             DBObject obj;
-            obj.source_id = *(int64_t*)row[0];
-            obj.ra = *(double*)row[1];
-            obj.dec = *(double*)row[2];
-            obj.healpix_id = *(int64_t*)row[3];
+            obj.source_id = source_id[r];
+            obj.ra = ra[r];
+            obj.dec = dec[r];
+            obj.healpix_id = healpix_id[r];
             db_objects.push_back(obj);
         }
     }
-    taos_free_result(res);
+    reader.close();
     taos_close(conn);
 
     SpatialIndex index(nside);
@@ -872,6 +880,9 @@ int main(int argc, char* argv[]) {
     for (auto& t : workers) t.join();
     monitor.join();
     
+    // Invalidate cached query results for this database
+    tdlight::bump_import_generation(db_name);
+    
     auto phase2_end = high_resolution_clock::now();
     double phase2_time = duration_cast<milliseconds>(phase2_end - phase2_start).count() / 1000.0;
     double total_time = phase1_time + phase2_time;
@@ -3,7 +3,10 @@
  * Supports:
  *   1. Cone Search
  *   2. Time Range Query for Single ID
- *   3. Batch Query Optimization
+ *   3. Batch Query Optimization (parallel over a connection pool)
+ *   4. Polygon / MOC Region Search
+ *   5. k-Nearest-Neighbour Source Search
+ *   6. Synthetic Workload Benchmark (JSON report)
  * 
  * Compile: g++ -std=c++17 -O3 -march=native optimized_query.cpp -o optimized_query -ltaos -lhealpix_cxx -lpthread
  */
@@ -12,16 +15,38 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
 #include <cmath>
 #include <algorithm>
 #include <map>
+#include <unordered_map>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <future>
+#include <random>
+#include <ctime>
 #include <taos.h>
 #include <healpix_cxx/healpix_base.h>
 #include <healpix_cxx/pointing.h>
+#include <fitsio.h>
+#include <tdlight/taos_pool.h>
+#include <tdlight/result_reader.h>
+#include <tdlight/async_query.h>
+#include <tdlight/query_cache.h>
+#include <tdlight/buffered_writer.h>
+#include <tdlight/sky_region.h>
+#include <tdlight/knn.h>
+#include <tdlight/downsample.h>
+#include <tdlight/sanitize.h>
 
 using namespace std;
 using namespace std::chrono;
@@ -31,6 +56,10 @@ const double PI = 3.14159265358979323846;
 const double DEG2RAD = PI / 180.0;
 const double RAD2DEG = 180.0 / PI;
 
+// Column list shared by every observation query (order matches decodeRow)
+const char* const RESULT_COLUMNS =
+    "ts, source_id, ra, dec, band, cls, mag, mag_error, flux, flux_error, jd_tcb";
+
 // Query result structure
 struct QueryResult {
     int64_t ts;
@@ -42,15 +71,424 @@ struct QueryResult {
     double jd_tcb;
 };
 
+// One source (child table) found by a tag-only query
+struct ObjectResult {
+    string table_name;
+    long long source_id;
+    double ra, dec;
+    string cls;
+    long long healpix_id;
+};
+
+// A source found by the k-nearest-neighbour search, closest first
+struct Neighbour {
+    double distance_deg;
+    ObjectResult object;
+};
+
+// Per-source, per-band summary computed by TDengine (--stats)
+struct SourceBandStats {
+    string table_name;
+    long long source_id;
+    double ra, dec;
+    string band;
+    long long count;
+    double mean_mag, stddev_mag, min_mag, max_mag;
+    int64_t first_ts, last_ts;
+};
+
+// Exact spatial cut over a block of ra/dec values (degrees): sets keep[i]
+using RowFilter = function<void(const double* ra, const double* dec, int n, uint8_t* keep)>;
+
+// Decode row r of the current block (selected with RESULT_COLUMNS)
+void decodeRow(tdlight::ResultReader& reader, int r, QueryResult& result) {
+    result.ts = reader.column<int64_t>(0)[r];
+    result.source_id = reader.column<int64_t>(1)[r];
+    result.ra = reader.column<double>(2)[r];
+    result.dec = reader.column<double>(3)[r];
+    string_view band = reader.str(4, r), cls = reader.str(5, r);
+    result.band.assign(band.data(), band.size());
+    result.cls.assign(cls.data(), cls.size());
+    result.mag = reader.column<double>(6)[r];
+    result.mag_error = reader.column<double>(7)[r];
+    result.flux = reader.column<double>(8)[r];
+    result.flux_error = reader.column<double>(9)[r];
+    result.jd_tcb = reader.column<double>(10)[r];
+}
+
 // Statistics
 struct QueryStats {
     int total_results = 0;
     double query_time_ms = 0;
     double fetch_time_ms = 0;
     int healpix_pixels_searched = 0;
+    bool cache_hit = false;
     string query_type;
 };
 
+// Batch run summary (one per concurrency level)
+struct BatchStats {
+    string mode = "pool";             // pool | sync | async
+    int concurrency = 1;              // workers, or queries in flight for async
+    int queries = 0;
+    int failed = 0;
+    long long total_results = 0;
+    double total_time_ms = 0;
+    double qps = 0;
+    double mean_ms = 0;
+    double p50_ms = 0, p95_ms = 0, p99_ms = 0, max_ms = 0;
+};
+
+// Synthetic benchmark workload (--bench)
+struct WorkloadSpec {
+    int queries = 1000;                       // per concurrency level
+    double radius_min = 0.01;                 // cone radii are log-uniform in
+    double radius_max = 0.2;                  //   [radius_min, radius_max] deg
+    double time_share = 0.2;                  // fraction of time-range lookups
+    double time_filter_share = 0.0;           // fraction of cones with a time window
+    double window_days = 30;                  // length of generated time windows
+    bool prepared = false;                    // time-range lookups via taos_stmt
+    unsigned seed = 42;
+    int sample_sources = 100000;              // sources sampled for centres and IDs
+};
+
+struct WorkloadQuery {
+    bool cone = true;                         // cone search, else time-range lookup
+    double ra = 0, dec = 0, radius = 0;
+    long long source_id = 0;
+    string time_filter;
+    int64_t start_ms = 0, end_ms = 0;         // time-range window (bound when prepared)
+};
+
+// One concurrency level of a benchmark run
+struct BenchRun {
+    BatchStats all, cone, time;
+    vector<double> cone_ms, time_ms;          // sorted latencies
+};
+
+// CSV layout shared by the exporters
+const char* const CSV_HEADER = "ts,source_id,ra,dec,band,cls,mag,mag_error,flux,flux_error,jd_tcb\n";
+
+void writeCSVRow(tdlight::BufferedWriter& w, const QueryResult& r) {
+    w.put_int(r.ts).put(',').put_int(r.source_id).put(',')
+     .put_fixed(r.ra, 8).put(',').put_fixed(r.dec, 8).put(',')
+     .put(r.band).put(',').put(r.cls).put(',')
+     .put_fixed(r.mag, 6).put(',').put_fixed(r.mag_error, 6).put(',')
+     .put_fixed(r.flux, 6).put(',').put_fixed(r.flux_error, 6).put(',')
+     .put_fixed(r.jd_tcb, 10).put('\n');
+}
+
+// ==================== Streaming export sinks ====================
+
+// Destination for result rows written as they are fetched
+class ResultSink {
+public:
+    virtual ~ResultSink() = default;
+    virtual void write(const QueryResult& r) = 0;
+    // Flush and close the file; throws on write errors
+    virtual void close() = 0;
+    // File size after close()
+    virtual uint64_t bytes() const = 0;
+};
+
+class CsvSink : public ResultSink {
+public:
+    explicit CsvSink(const string& filename) : filename(filename) {
+        file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            throw runtime_error("Cannot create output file: " + filename);
+        }
+        writer = make_unique<tdlight::BufferedWriter>(file);
+        writer->put(CSV_HEADER);
+    }
+    
+    ~CsvSink() override {
+        writer.reset();
+        if (file) fclose(file);
+    }
+    
+    void write(const QueryResult& r) override { writeCSVRow(*writer, r); }
+    
+    void close() override {
+        bool ok = writer->flush();
+        written = writer->bytes_written();
+        writer.reset();
+        ok = (fclose(file) == 0) && ok;
+        file = nullptr;
+        if (!ok) throw runtime_error("Write failed: " + filename);
+    }
+    
+    uint64_t bytes() const override { return written; }
+    
+private:
+    string filename;
+    FILE* file = nullptr;
+    unique_ptr<tdlight::BufferedWriter> writer;
+    uint64_t written = 0;
+};
+
+// FITS binary table (extension OBSERVATIONS). Rows are buffered column by
+// column and written with one fits_write_col call per column per chunk.
+class FitsSink : public ResultSink {
+public:
+    // NCHAR(16) / NCHAR(32) columns; a character takes up to 4 UTF-8 bytes
+    static const int BAND_WIDTH = 64;
+    static const int CLS_WIDTH = 128;
+    
+    explicit FitsSink(const string& filename) : filename(filename) {
+        int status = 0;
+        // Leading '!' makes cfitsio overwrite an existing file
+        fits_create_file(&fptr, ("!" + filename).c_str(), &status);
+        
+        const char* ttype[] = {"TS", "SOURCE_ID", "RA", "DEC", "BAND", "CLS",
+                               "MAG", "MAG_ERR", "FLUX", "FLUX_ERR", "JD_TCB"};
+        const char* tform[] = {"1K", "1K", "1D", "1D", "64A", "128A",
+                               "1D", "1D", "1D", "1D", "1D"};
+        const char* tunit[] = {"ms", "", "deg", "deg", "", "",
+                               "mag", "mag", "", "", "d"};
+        fits_create_tbl(fptr, BINARY_TBL, 0, 11, const_cast<char**>(ttype),
+                        const_cast<char**>(tform), const_cast<char**>(tunit),
+                        "OBSERVATIONS", &status);
+        fits_write_key(fptr, TSTRING, "ORIGIN", const_cast<char*>("TDlight"), "Written by optimized_query", &status);
+        fits_write_key(fptr, TSTRING, "TSREF", const_cast<char*>("UNIX"), "TS is milliseconds since 1970-01-01 UTC", &status);
+        fits_write_date(fptr, &status);
+        
+        long optimal = 0;
+        fits_get_rowsize(fptr, &optimal, &status);
+        if (status != 0) {
+            // Do not leave a half-written file (or an open handle) behind
+            int ignored = 0;
+            if (fptr) fits_delete_file(fptr, &ignored);
+            fptr = nullptr;
+            check(status, "create");
+        }
+        chunk = max(optimal, 65536L);
+        
+        ts.reserve(chunk);
+        source_id.reserve(chunk);
+        for (auto* col : {&ra, &dec, &mag, &mag_err, &flux, &flux_err, &jd}) col->reserve(chunk);
+        band.reserve(chunk * (BAND_WIDTH + 1));
+        cls.reserve(chunk * (CLS_WIDTH + 1));
+    }
+    
+    ~FitsSink() override {
+        if (fptr) {
+            int status = 0;
+            fits_close_file(fptr, &status);
+        }
+    }
+    
+    void write(const QueryResult& r) override {
+        ts.push_back(r.ts);
+        source_id.push_back(r.source_id);
+        ra.push_back(r.ra);
+        dec.push_back(r.dec);
+        appendFixed(band, r.band, BAND_WIDTH);
+        appendFixed(cls, r.cls, CLS_WIDTH);
+        mag.push_back(r.mag);
+        mag_err.push_back(r.mag_error);
+        flux.push_back(r.flux);
+        flux_err.push_back(r.flux_error);
+        jd.push_back(r.jd_tcb);
+        if ((long)ts.size() >= chunk) flushChunk();
+    }
+    
+    void close() override {
+        flushChunk();
+        int status = 0;
+        fits_close_file(fptr, &status);
+        fptr = nullptr;
+        check(status, "close");
+        written = filesystem::file_size(filename);
+    }
+    
+    uint64_t bytes() const override { return written; }
+    
+private:
+    static void appendFixed(vector<char>& buf, const string& s, int width) {
+        size_t n = min(s.size(), (size_t)width);
+        // Cut before a UTF-8 continuation byte so no character is split
+        while (n > 0 && n < s.size() && (static_cast<unsigned char>(s[n]) & 0xC0) == 0x80) n--;
+        buf.insert(buf.end(), s.data(), s.data() + n);
+        buf.insert(buf.end(), width + 1 - n, '\0');
+    }
+    
+    void check(int status, const char* what) {
+        if (status != 0) {
+            char msg[FLEN_STATUS];
+            fits_get_errstatus(status, msg);
+            throw runtime_error("FITS " + string(what) + " failed for " + filename + ": " + msg);
+        }
+    }
+    
+    void writeStrings(int col, vector<char>& buf, int width, LONGLONG n, int& status) {
+        vector<char*> ptrs(n);
+        for (LONGLONG i = 0; i < n; i++) ptrs[i] = buf.data() + i * (width + 1);
+        fits_write_col(fptr, TSTRING, col, next_row, 1, n, ptrs.data(), &status);
+    }
+    
+    void flushChunk() {
+        LONGLONG n = ts.size();
+        if (n == 0) return;
+        int status = 0;
+        fits_write_col(fptr, TLONGLONG, 1, next_row, 1, n, ts.data(), &status);
+        fits_write_col(fptr, TLONGLONG, 2, next_row, 1, n, source_id.data(), &status);
+        fits_write_col(fptr, TDOUBLE, 3, next_row, 1, n, ra.data(), &status);
+        fits_write_col(fptr, TDOUBLE, 4, next_row, 1, n, dec.data(), &status);
+        writeStrings(5, band, BAND_WIDTH, n, status);
+        writeStrings(6, cls, CLS_WIDTH, n, status);
+        fits_write_col(fptr, TDOUBLE, 7, next_row, 1, n, mag.data(), &status);
+        fits_write_col(fptr, TDOUBLE, 8, next_row, 1, n, mag_err.data(), &status);
+        fits_write_col(fptr, TDOUBLE, 9, next_row, 1, n, flux.data(), &status);
+        fits_write_col(fptr, TDOUBLE, 10, next_row, 1, n, flux_err.data(), &status);
+        fits_write_col(fptr, TDOUBLE, 11, next_row, 1, n, jd.data(), &status);
+        check(status, "write");
+        
+        next_row += n;
+        ts.clear();
+        source_id.clear();
+        for (auto* col : {&ra, &dec, &mag, &mag_err, &flux, &flux_err, &jd}) col->clear();
+        band.clear();
+        cls.clear();
+    }
+    
+    string filename;
+    fitsfile* fptr = nullptr;
+    long chunk = 65536;
+    LONGLONG next_row = 1;
+    vector<LONGLONG> ts, source_id;
+    vector<double> ra, dec, mag, mag_err, flux, flux_err, jd;
+    vector<char> band, cls;                  // fixed-width, NUL-terminated
+    uint64_t written = 0;
+};
+
+bool isFitsPath(const string& filename) {
+    string lower = filename;
+    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    for (const char* ext : {".fits", ".fit", ".fts"}) {
+        size_t n = strlen(ext);
+        if (lower.size() >= n && lower.compare(lower.size() - n, n, ext) == 0) return true;
+    }
+    return false;
+}
+
+// CSV, or FITS when the file name ends in .fits/.fit/.fts
+unique_ptr<ResultSink> makeSink(const string& filename) {
+    if (isFitsPath(filename)) return make_unique<FitsSink>(filename);
+    return make_unique<CsvSink>(filename);
+}
+
+// Approximate memory footprint of a result vector (for the cache budget)
+size_t resultBytes(const vector<QueryResult>& rows) {
+    size_t bytes = sizeof(rows) + rows.capacity() * sizeof(QueryResult);
+    for (const auto& r : rows) {
+        if (r.band.size() > 15) bytes += r.band.capacity() + 1;
+        if (r.cls.size() > 15) bytes += r.cls.capacity() + 1;
+    }
+    return bytes;
+}
+
+// Percentile of an ascending-sorted sample (nearest-rank)
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    if (rank == 0) rank = 1;
+    return sorted[min(rank, sorted.size()) - 1];
+}
+
+// Latency histogram with power-of-two bucket edges (0.25 ms, 0.5 ms, ...):
+// (upper edge in ms, count) for every bucket up to the slowest sample
+vector<pair<double, int>> latencyHistogram(const vector<double>& latencies_ms) {
+    vector<pair<double, int>> buckets;
+    if (latencies_ms.empty()) return buckets;
+    double slowest = *max_element(latencies_ms.begin(), latencies_ms.end());
+    for (double edge = 0.25; ; edge *= 2) {
+        buckets.emplace_back(edge, 0);
+        if (edge >= slowest) break;
+    }
+    for (double v : latencies_ms) {
+        size_t b = 0;
+        while (b + 1 < buckets.size() && v > buckets[b].first) b++;
+        buckets[b].second++;
+    }
+    return buckets;
+}
+
+BatchStats summarizeLatencies(vector<double> latencies_ms, double total_time_ms, int concurrency) {
+    BatchStats b;
+    b.concurrency = concurrency;
+    b.queries = latencies_ms.size();
+    b.total_time_ms = total_time_ms;
+    sort(latencies_ms.begin(), latencies_ms.end());
+    if (!latencies_ms.empty()) {
+        double sum = 0;
+        for (double v : latencies_ms) sum += v;
+        b.mean_ms = sum / latencies_ms.size();
+        b.p50_ms = percentile(latencies_ms, 50);
+        b.p95_ms = percentile(latencies_ms, 95);
+        b.p99_ms = percentile(latencies_ms, 99);
+        b.max_ms = latencies_ms.back();
+    }
+    b.qps = total_time_ms > 0 ? b.queries * 1000.0 / total_time_ms : 0;
+    return b;
+}
+
+// Prepared "one source, time window" lookup. TDengine parses and plans
+// the statement once per connection; each call only binds source_id and
+// the window bounds [start_ms, end_ms).
+class PreparedTimeRange {
+public:
+    PreparedTimeRange(TAOS* db, const string& super_table) {
+        stmt = taos_stmt_init(db);
+        if (!stmt) {
+            throw runtime_error("STMT init failed: " + string(taos_errstr(nullptr)));
+        }
+        string sql = string("SELECT ") + RESULT_COLUMNS + " FROM " + super_table +
+                     " WHERE source_id = ? AND ts >= ? AND ts < ? ORDER BY ts ASC";
+        if (taos_stmt_prepare(stmt, sql.c_str(), sql.size()) != 0) {
+            string error = taos_stmt_errstr(stmt);
+            taos_stmt_close(stmt);
+            throw runtime_error("STMT prepare failed: " + error);
+        }
+        
+        memset(binds, 0, sizeof(binds));
+        int types[3] = {TSDB_DATA_TYPE_BIGINT, TSDB_DATA_TYPE_TIMESTAMP, TSDB_DATA_TYPE_TIMESTAMP};
+        for (int i = 0; i < 3; i++) {
+            binds[i].buffer_type = types[i];
+            binds[i].buffer = &values[i];
+            binds[i].buffer_length = sizeof(int64_t);
+            binds[i].num = 1;
+        }
+    }
+    
+    PreparedTimeRange(const PreparedTimeRange&) = delete;
+    PreparedTimeRange& operator=(const PreparedTimeRange&) = delete;
+    
+    ~PreparedTimeRange() {
+        taos_stmt_close(stmt);
+    }
+    
+    // Bind and execute. The result belongs to the statement and stays
+    // valid until the next run().
+    tdlight::ResultReader run(long long source_id, int64_t start_ms, int64_t end_ms) {
+        values[0] = source_id;
+        values[1] = start_ms;
+        values[2] = end_ms;
+        if (taos_stmt_bind_param(stmt, binds) != 0) {
+            throw runtime_error("STMT bind failed: " + string(taos_stmt_errstr(stmt)));
+        }
+        if (taos_stmt_execute(stmt) != 0) {
+            throw runtime_error("STMT execute failed: " + string(taos_stmt_errstr(stmt)));
+        }
+        return tdlight::ResultReader(taos_stmt_use_result(stmt), false);
+    }
+    
+private:
+    TAOS_STMT* stmt = nullptr;
+    int64_t values[3] = {0, 0, 0};
+    TAOS_MULTI_BIND binds[3];
+};
+
 class OptimizedQueryEngine {
 private:
     TAOS* conn;
@@ -58,6 +496,13 @@ private:
     string super_table;
     int nside;
     unique_ptr<Healpix_Base> healpix_map;
+    tdlight::ConnectionParams conn_params;
+    unique_ptr<tdlight::ConnectionPool> pool;
+    int fixed_pool_size = 0;        // --pool_size; 0 = grow with concurrency
+    // Candidate rows per normalized pixel set + time filter (off by default)
+    unique_ptr<tdlight::QueryCache<vector<QueryResult>>> cache;
+    // Prepared time-range lookup on the main connection (created on first use)
+    unique_ptr<PreparedTimeRange> prepared_time_range;
     
 public:
     OptimizedQueryEngine(const string& host = "localhost",
@@ -69,6 +514,12 @@ public:
                         int port = 6030)
         : db_name(database), super_table(table), nside(nside_param) {
         
+        conn_params.host = host;
+        conn_params.user = user;
+        conn_params.password = password;
+        conn_params.database = database;
+        conn_params.port = port;
+        
         cout << "[INFO] Initializing HEALPix (NSIDE=" << nside << ")..." << endl;
         healpix_map = make_unique<Healpix_Base>(nside, NEST, SET_NSIDE);
         
@@ -85,6 +536,8 @@ public:
     }
     
     ~OptimizedQueryEngine() {
+        pool.reset();
+        prepared_time_range.reset();
         if (conn) {
             taos_close(conn);
         }
@@ -108,10 +561,188 @@ public:
         return acos(cos_dist) * RAD2DEG;
     }
     
+    // HEALPix pixels covering a cone (at least the center pixel)
+    vector<int> conePixels(double center_ra, double center_dec, double radius_deg) const {
+        pointing center_pt(DEG2RAD * (90.0 - center_dec), DEG2RAD * center_ra);
+        double radius_rad = radius_deg * DEG2RAD;
+        
+        vector<int> pixels;
+        healpix_map->query_disc(center_pt, radius_rad, pixels);
+        
+        if (pixels.empty()) {
+            // If no pixels found, use at least the center pixel
+            int center_pix = healpix_map->ang2pix(center_pt);
+            pixels.push_back(center_pix);
+        }
+        return pixels;
+    }
+    
+    // Observation query over a pixel list
+    string coneSQL(const vector<int>& pixels, const string& time_filter = "", int limit = -1) const {
+        ostringstream sql;
+        sql << "SELECT " << RESULT_COLUMNS << " FROM " << super_table 
+            << " WHERE healpix_id IN (";
+        
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            if (i > 0) sql << ",";
+            sql << pixels[i];
+        }
+        sql << ")";
+        
+        // Add time filter condition
+        if (!time_filter.empty()) {
+            sql << " AND " << time_filter;
+        }
+        
+        // Add LIMIT
+        if (limit > 0) {
+            sql << " LIMIT " << limit;
+        }
+        return sql.str();
+    }
+    
+    // Observation query over a region's pixel set
+    string regionSQL(const vector<int>& pixels, const string& time_filter = "", int limit = -1) const {
+        string sql = string("SELECT ") + RESULT_COLUMNS + " FROM " + super_table +
+                     " WHERE " + tdlight::pixel_condition(pixels);
+        if (!time_filter.empty()) sql += " AND " + time_filter;
+        if (limit > 0) sql += " LIMIT " + to_string(limit);
+        return sql;
+    }
+    
+    // Light curve query for one source (optimized with TAGS filtering)
+    string timeRangeSQL(long long source_id, const string& time_condition, int limit = -1) const {
+        ostringstream sql;
+        sql << "SELECT " << RESULT_COLUMNS << " FROM " << super_table 
+            << " WHERE source_id = " << source_id;
+        
+        // Add time condition
+        if (!time_condition.empty()) {
+            sql << " AND " << time_condition;
+        }
+        
+        // Order by time
+        sql << " ORDER BY ts ASC";
+        
+        // Add LIMIT
+        if (limit > 0) {
+            sql << " LIMIT " << limit;
+        }
+        return sql.str();
+    }
+    
+    // Exact region membership (polygon edge tests / MOC lookup)
+    static RowFilter regionFilter(const tdlight::SkyRegion& region) {
+        return [&region](const double* ra, const double* dec, int n, uint8_t* keep) {
+            region.contains(ra, dec, n, keep);
+        };
+    }
+    
+    // Exact cone membership for a block of ra/dec values
+    RowFilter coneFilter(double center_ra, double center_dec, double radius_deg) {
+        return [this, center_ra, center_dec, radius_deg](const double* ra, const double* dec,
+                                                         int n, uint8_t* keep) {
+            for (int i = 0; i < n; i++) {
+                keep[i] = calculateAngularDistance(center_ra, center_dec, ra[i], dec[i]) <= radius_deg;
+            }
+        };
+    }
+    
+    // Run `sql` (rows of `pixels`) and keep the rows accepted by `filter`.
+    // The candidate rows are cached by pixel set + `filter_key` when the
+    // cache is on, so cones and regions over the same pixels share entries.
+    // Returns the number of rows kept; `total_fetched` counts candidates.
+    int fetchFiltered(TAOS* db, const vector<int>& pixels, const string& sql, const string& filter_key,
+                      const RowFilter& filter, vector<QueryResult>& results, QueryStats& stats,
+                      int& total_fetched) {
+        auto query_start = high_resolution_clock::now();
+        int filtered_count = 0;
+        vector<uint8_t> keep;
+        
+        // Serve the pixel set from the result cache when possible
+        string cache_key;
+        uint64_t generation = 0;
+        if (cache) {
+            cache_key = tdlight::pixel_set_key(pixels, filter_key);
+            generation = tdlight::import_generation(db_name);
+            if (auto rows = cache->get(cache_key, generation)) {
+                stats.cache_hit = true;
+                total_fetched = rows->size();
+                vector<double> ra, dec;
+                ra.reserve(rows->size());
+                dec.reserve(rows->size());
+                for (const auto& row : *rows) {
+                    ra.push_back(row.ra);
+                    dec.push_back(row.dec);
+                }
+                keep.resize(rows->size());
+                filter(ra.data(), dec.data(), (int)rows->size(), keep.data());
+                for (size_t i = 0; i < rows->size(); i++) {
+                    if (keep[i]) {
+                        results.push_back((*rows)[i]);
+                        filtered_count++;
+                    }
+                }
+                stats.fetch_time_ms = duration<double, milli>(high_resolution_clock::now() - query_start).count();
+                return filtered_count;
+            }
+        }
+        
+        tdlight::ResultReader reader(taos_query(db, sql.c_str()));
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
+        }
+        
+        auto fetch_start = high_resolution_clock::now();
+        stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
+        
+        // Fetch results block by block; the exact filter runs on the ra/dec
+        // columns so rejected rows never build strings (unless every
+        // candidate is kept for the cache)
+        auto candidates = cache ? make_shared<vector<QueryResult>>() : nullptr;
+        
+        while (int n = reader.next_block()) {
+            total_fetched += n;
+            keep.resize(n);
+            filter(reader.column<double>(2).data(), reader.column<double>(3).data(), n, keep.data());
+            
+            for (int r = 0; r < n; r++) {
+                if (!keep[r] && !candidates) continue;
+                
+                QueryResult result;
+                decodeRow(reader, r, result);
+                if (keep[r]) {
+                    results.push_back(result);
+                    filtered_count++;
+                }
+                if (candidates) candidates->push_back(move(result));
+            }
+        }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        
+        if (candidates) {
+            size_t bytes = resultBytes(*candidates);
+            cache->put(cache_key, move(candidates), bytes, generation);
+        }
+        
+        stats.fetch_time_ms = duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        return filtered_count;
+    }
+    
     // Cone search - HEALPix accelerated
     QueryStats coneSearch(double center_ra, double center_dec, double radius_deg,
                          vector<QueryResult>& results, bool verbose = true,
                          const string& time_filter = "", int limit = -1) {
+        return coneSearchOn(conn, center_ra, center_dec, radius_deg, results,
+                            verbose, time_filter, limit);
+    }
+    
+    // Cone search on a given connection (used by the parallel batch workers)
+    QueryStats coneSearchOn(TAOS* db, double center_ra, double center_dec, double radius_deg,
+                           vector<QueryResult>& results, bool verbose = true,
+                           const string& time_filter = "", int limit = -1) {
         
         QueryStats stats;
         stats.query_type = "cone_search";
@@ -132,17 +763,7 @@ public:
         }
         
         // 1. Use HEALPix to find all pixels in the cone region
-        pointing center_pt(DEG2RAD * (90.0 - center_dec), DEG2RAD * center_ra);
-        double radius_rad = radius_deg * DEG2RAD;
-        
-        vector<int> pixels;
-        healpix_map->query_disc(center_pt, radius_rad, pixels);
-        
-        if (pixels.empty()) {
-            // If no pixels found, use at least the center pixel
-            int center_pix = healpix_map->ang2pix(center_pt);
-            pixels.push_back(center_pix);
-        }
+        vector<int> pixels = conePixels(center_ra, center_dec, radius_deg);
         
         stats.healpix_pixels_searched = pixels.size();
         
@@ -151,264 +772,1638 @@ public:
         }
         
         // 2. Build optimized SQL query
-        ostringstream sql;
-        sql << "SELECT ts, source_id, ra, dec, band, cls, mag, mag_error, "
-            << "flux, flux_error, jd_tcb FROM " << super_table 
-            << " WHERE healpix_id IN (";
+        string sql = coneSQL(pixels, time_filter, limit);
         
-        for (size_t i = 0; i < pixels.size(); ++i) {
-            if (i > 0) sql << ",";
-            sql << pixels[i];
+        if (verbose) {
+            cout << "  SQL query length: " << sql.length() << " chars" << endl;
         }
-        sql << ")";
         
-        // Add time filter condition
-        if (!time_filter.empty()) {
-            sql << " AND " << time_filter;
-        }
+        // 3. Fetch (or serve from the cache) and apply the exact distance cut
+        int total_fetched = 0;
+        int filtered_count = fetchFiltered(db, pixels, sql, time_filter + "|" + to_string(limit),
+                                           coneFilter(center_ra, center_dec, radius_deg),
+                                           results, stats, total_fetched);
         
-        // Add LIMIT
-        if (limit > 0) {
-            sql << " LIMIT " << limit;
-        }
+        stats.total_results = filtered_count;
+        
+        auto end_time = high_resolution_clock::now();
+        double total_time = duration<double, milli>(end_time - start_time).count();
         
         if (verbose) {
-            cout << "  SQL query length: " << sql.str().length() << " chars" << endl;
+            cout << "\n[STATS] Query Statistics" << endl;
+            if (cache) cout << "  Cache: " << (stats.cache_hit ? "hit" : "miss") << endl;
+            cout << "  HEALPix filtered: " << total_fetched << " records" << endl;
+            cout << "  Angular distance filtered: " << filtered_count << " records (exact match)" << endl;
+            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "  Total time: " << total_time << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
         }
         
-        auto query_start = high_resolution_clock::now();
+        return stats;
+    }
+    
+    // Region search: polygon or MOC footprint -> HEALPix pixels (with
+    // inclusive coverage), then the exact region test on every candidate
+    QueryStats regionSearch(const tdlight::SkyRegion& region, vector<QueryResult>& results,
+                            bool verbose = true, const string& time_filter = "", int limit = -1) {
+        QueryStats stats;
+        stats.query_type = "region_search";
+        
+        auto start_time = high_resolution_clock::now();
         
-        // 3. Execute query
-        TAOS_RES* res = taos_query(conn, sql.str().c_str());
-        if (taos_errno(res) != 0) {
-            string error = "Query failed: " + string(taos_errstr(res));
-            taos_free_result(res);
-            throw runtime_error(error);
+        if (verbose) {
+            cout << "\n=== Region Search ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Region: " << region.describe() << endl;
         }
         
-        auto fetch_start = high_resolution_clock::now();
-        stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
+        vector<int> pixels = region.pixels(*healpix_map);
+        stats.healpix_pixels_searched = pixels.size();
+        
+        if (verbose) {
+            cout << "  HEALPix pixels: " << pixels.size() << endl;
+        }
         
-        // 4. Fetch results and perform precise angular distance filtering
-        TAOS_ROW row;
         int total_fetched = 0;
         int filtered_count = 0;
+        if (!pixels.empty()) {
+            string sql = regionSQL(pixels, time_filter, limit);
+            if (verbose) {
+                cout << "  SQL query length: " << sql.length() << " chars" << endl;
+            }
+            filtered_count = fetchFiltered(conn, pixels, sql, time_filter + "|" + to_string(limit),
+                                           regionFilter(region), results, stats, total_fetched);
+        }
+        stats.total_results = filtered_count;
         
-        while ((row = taos_fetch_row(res))) {
-            total_fetched++;
-            
-            // Parse results
-            QueryResult result;
-            result.ts = *(int64_t*)row[0];
-            result.source_id = *(long long*)row[1];
-            result.ra = *(double*)row[2];
-            result.dec = *(double*)row[3];
-            result.band = row[4] ? string((char*)row[4]) : "";
-            result.cls = row[5] ? string((char*)row[5]) : "";
-            result.mag = *(double*)row[6];
-            result.mag_error = *(double*)row[7];
-            result.flux = *(double*)row[8];
-            result.flux_error = *(double*)row[9];
-            result.jd_tcb = *(double*)row[10];
-            
-            // Precise angular distance calculation
-            double dist = calculateAngularDistance(center_ra, center_dec, 
-                                                   result.ra, result.dec);
-            
-            if (dist <= radius_deg) {
-                results.push_back(result);
-                filtered_count++;
+        double total_time = duration<double, milli>(high_resolution_clock::now() - start_time).count();
+        
+        if (verbose) {
+            cout << "\n[STATS] Query Statistics" << endl;
+            if (cache) cout << "  Cache: " << (stats.cache_hit ? "hit" : "miss") << endl;
+            cout << "  HEALPix filtered: " << total_fetched << " records" << endl;
+            cout << "  Region filtered: " << filtered_count << " records (exact match)" << endl;
+            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "  Total time: " << total_time << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        
+        return stats;
+    }
+    
+    // Time range query for single source_id
+    QueryStats timeRangeQuery(long long source_id, const string& time_condition,
+                             vector<QueryResult>& results, bool verbose = true,
+                             int limit = -1) {
+        
+        QueryStats stats;
+        stats.query_type = "time_range";
+        
+        auto start_time = high_resolution_clock::now();
+        
+        if (verbose) {
+            cout << "\n=== Time Range Query ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Source ID: " << source_id << endl;
+            cout << "  Time condition: " << time_condition << endl;
+        }
+        
+        // Build SQL query (optimized with TAGS filtering)
+        string sql = timeRangeSQL(source_id, time_condition, limit);
+        
+        if (verbose) {
+            cout << "  SQL: " << sql << endl;
+        }
+        
+        auto query_start = high_resolution_clock::now();
+        
+        // Execute query
+        tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
+        }
+        
+        auto fetch_start = high_resolution_clock::now();
+        stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
+        
+        // Fetch results block by block
+        while (int n = reader.next_block()) {
+            results.reserve(results.size() + n);
+            for (int r = 0; r < n; r++) {
+                QueryResult result;
+                decodeRow(reader, r, result);
+                results.push_back(result);
+            }
+        }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        
+        auto fetch_end = high_resolution_clock::now();
+        stats.fetch_time_ms = duration<double, milli>(fetch_end - fetch_start).count();
+        
+        stats.total_results = results.size();
+        
+        auto end_time = high_resolution_clock::now();
+        double total_time = duration<double, milli>(end_time - start_time).count();
+        
+        if (verbose) {
+            cout << "\n[STATS] Query Statistics" << endl;
+            cout << "  Result count: " << stats.total_results << " records" << endl;
+            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "  Total time: " << total_time << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        
+        return stats;
+    }
+    
+    // Time range query through the prepared statement: same rows as
+    // timeRangeQuery() with "ts >= start_ms AND ts < end_ms", but no SQL
+    // is built or parsed per call
+    QueryStats timeRangeQueryPrepared(long long source_id, int64_t start_ms, int64_t end_ms,
+                                      vector<QueryResult>& results, bool verbose = true,
+                                      int limit = -1) {
+        QueryStats stats;
+        stats.query_type = "time_range_prepared";
+        
+        auto query_start = high_resolution_clock::now();
+        if (!prepared_time_range) {
+            prepared_time_range = make_unique<PreparedTimeRange>(conn, super_table);
+        }
+        tdlight::ResultReader reader = prepared_time_range->run(source_id, start_ms, end_ms);
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
+        }
+        
+        auto fetch_start = high_resolution_clock::now();
+        stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
+        
+        // Stop fetching at the limit, so the transfer matches the LIMIT of
+        // the ad-hoc path
+        auto below_limit = [&] { return limit <= 0 || (int)results.size() < limit; };
+        while (below_limit()) {
+            int n = reader.next_block();
+            if (n == 0) break;
+            results.reserve(results.size() + n);
+            for (int r = 0; r < n && below_limit(); r++) {
+                QueryResult result;
+                decodeRow(reader, r, result);
+                results.push_back(result);
+            }
+        }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        
+        stats.fetch_time_ms = duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        stats.total_results = results.size();
+        
+        if (verbose) {
+            cout << "\n=== Time Range Query (prepared) ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Source ID: " << source_id << endl;
+            cout << "  Window: [" << start_ms << ", " << end_ms << ") ms" << endl;
+            cout << "\n[STATS] Query Statistics" << endl;
+            cout << "  Result count: " << stats.total_results << " records" << endl;
+            cout << "  Bind+execute time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        return stats;
+    }
+    
+    // Reduce a time-ordered light curve to at most max_points epochs per
+    // band (for plotting); returns the number of epochs before reduction
+    size_t downsampleResults(vector<QueryResult>& results, size_t max_points,
+                             tdlight::DownsampleMethod method, bool verbose = true) {
+        size_t total = results.size();
+        if (max_points == 0 || total <= max_points) return total;
+        
+        vector<double> x(total), y(total);
+        vector<string> bands(total);
+        for (size_t i = 0; i < total; i++) {
+            x[i] = static_cast<double>(results[i].ts);
+            y[i] = results[i].mag;
+            bands[i] = results[i].band;
+        }
+        vector<QueryResult> reduced;
+        for (size_t i : tdlight::downsample_groups(x, y, bands, max_points, method)) {
+            reduced.push_back(std::move(results[i]));
+        }
+        results.swap(reduced);
+        
+        if (verbose) {
+            cout << "[INFO] Downsampled " << total << " -> " << results.size() << " epochs ("
+                 << (method == tdlight::DownsampleMethod::MinMax ? "min/max" : "LTTB")
+                 << ", at most " << max_points << " per band)" << endl;
+        }
+        return total;
+    }
+    
+    // Run the same lookup `repeat` times as ad-hoc SQL and through the
+    // prepared statement (interleaved, so both see the same cache state)
+    // and report the latency of each path
+    vector<BatchStats> compareTimeRangePaths(long long source_id, int64_t start_ms, int64_t end_ms,
+                                             int repeat, vector<QueryResult>& results) {
+        cout << "\n=== Time Range: ad-hoc SQL vs. prepared statement ===" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        cout << "  Source ID: " << source_id << endl;
+        cout << "  Window: [" << start_ms << ", " << end_ms << ") ms" << endl;
+        cout << "  Repeats: " << repeat << endl;
+        
+        string condition = "ts >= " + to_string(start_ms) + " AND ts < " + to_string(end_ms);
+        vector<double> sql_ms, stmt_ms;
+        long long sql_rows = 0, stmt_rows = 0;
+        
+        // One untimed call each to open the statement and warm the caches
+        timeRangeQuery(source_id, condition, results, false);
+        results.clear();
+        timeRangeQueryPrepared(source_id, start_ms, end_ms, results, false);
+        
+        for (int i = 0; i < repeat; i++) {
+            vector<QueryResult> rows;
+            auto t0 = high_resolution_clock::now();
+            timeRangeQuery(source_id, condition, rows, false);
+            sql_ms.push_back(duration<double, milli>(high_resolution_clock::now() - t0).count());
+            sql_rows += rows.size();
+            
+            rows.clear();
+            t0 = high_resolution_clock::now();
+            timeRangeQueryPrepared(source_id, start_ms, end_ms, rows, false);
+            stmt_ms.push_back(duration<double, milli>(high_resolution_clock::now() - t0).count());
+            stmt_rows += rows.size();
+        }
+        
+        double sql_total = 0, stmt_total = 0;
+        for (double v : sql_ms) sql_total += v;
+        for (double v : stmt_ms) stmt_total += v;
+        
+        BatchStats sql_stats = summarizeLatencies(sql_ms, sql_total, 1);
+        BatchStats stmt_stats = summarizeLatencies(stmt_ms, stmt_total, 1);
+        sql_stats.mode = "sql";
+        stmt_stats.mode = "stmt";
+        sql_stats.total_results = sql_rows;
+        stmt_stats.total_results = stmt_rows;
+        vector<BatchStats> table{sql_stats, stmt_stats};
+        printBatchTable(table);
+        
+        if (sql_rows != stmt_rows) {
+            cerr << "[WARN] Row counts differ: sql=" << sql_rows << " stmt=" << stmt_rows << endl;
+        }
+        double saved = sql_stats.p50_ms - stmt_stats.p50_ms;
+        cout << "[STATS] Prepared statement saves " << fixed << setprecision(3) << saved
+             << " ms per lookup at p50 (" << setprecision(1)
+             << (sql_stats.p50_ms > 0 ? 100.0 * saved / sql_stats.p50_ms : 0.0) << "%), "
+             << setprecision(3) << (sql_stats.mean_ms - stmt_stats.mean_ms) << " ms on average" << endl;
+        return table;
+    }
+    
+    // Object-level cone search: reads only the child-table tags, one row per
+    // source, so no observation rows are transferred. Observations of a hit
+    // can be fetched afterwards with timeRangeQuery(source_id, ...).
+    QueryStats objectConeSearch(double center_ra, double center_dec, double radius_deg,
+                                vector<ObjectResult>& objects, bool verbose = true) {
+        QueryStats stats;
+        stats.query_type = "object_cone_search";
+        
+        auto start_time = high_resolution_clock::now();
+        
+        center_ra = fmod(center_ra, 360.0);
+        if (center_ra < 0) center_ra += 360.0;
+        center_dec = max(-90.0, min(90.0, center_dec));
+        
+        if (verbose) {
+            cout << "\n=== Object Cone Search (tags only) ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Center: RA=" << fixed << setprecision(6) << center_ra 
+                 << " deg, DEC=" << center_dec << " deg" << endl;
+            cout << "  Radius: " << radius_deg << " deg" << endl;
+        }
+        
+        vector<int> pixels = conePixels(center_ra, center_dec, radius_deg);
+        stats.healpix_pixels_searched = pixels.size();
+        
+        // SELECT TAGS scans the tag index only and returns one row per child table
+        ostringstream sql;
+        sql << "SELECT TAGS tbname, source_id, ra, dec, cls, healpix_id FROM " << super_table
+            << " WHERE healpix_id IN (";
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            if (i > 0) sql << ",";
+            sql << pixels[i];
+        }
+        sql << ")";
+        
+        if (verbose) {
+            cout << "  HEALPix pixels: " << pixels.size() << endl;
+        }
+        
+        auto query_start = high_resolution_clock::now();
+        tdlight::ResultReader reader(taos_query(conn, sql.str().c_str()));
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
+        }
+        auto fetch_start = high_resolution_clock::now();
+        stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
+        
+        int total_fetched = 0;
+        while (int n = reader.next_block()) {
+            total_fetched += n;
+            auto source_id = reader.column<int64_t>(1);
+            auto ra = reader.column<double>(2);
+            auto dec = reader.column<double>(3);
+            auto healpix_id = reader.column<int64_t>(5);
+            
+            for (int r = 0; r < n; r++) {
+                if (calculateAngularDistance(center_ra, center_dec, ra[r], dec[r]) > radius_deg) continue;
+                ObjectResult obj;
+                obj.table_name = string(reader.str(0, r));
+                obj.source_id = source_id[r];
+                obj.ra = ra[r];
+                obj.dec = dec[r];
+                obj.cls = string(reader.str(4, r));
+                obj.healpix_id = healpix_id[r];
+                objects.push_back(move(obj));
+            }
+        }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        
+        stats.fetch_time_ms = duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        stats.total_results = objects.size();
+        double total_time = duration<double, milli>(high_resolution_clock::now() - start_time).count();
+        
+        if (verbose) {
+            cout << "\n[STATS] Query Statistics" << endl;
+            cout << "  Sources in pixels: " << total_fetched << endl;
+            cout << "  Sources in cone: " << objects.size() << " (exact match)" << endl;
+            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "  Total time: " << total_time << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        
+        return stats;
+    }
+    
+    // k nearest sources to a position, read from the child-table tags.
+    // HEALPix discs around the target grow until the K-th distance is
+    // within the radius already read, so no search radius has to be guessed.
+    QueryStats knnSearch(double center_ra, double center_dec, int k, vector<Neighbour>& neighbours,
+                         bool verbose = true, double max_radius_deg = 180.0) {
+        QueryStats stats;
+        stats.query_type = "knn";
+        
+        auto start_time = high_resolution_clock::now();
+        
+        center_ra = fmod(center_ra, 360.0);
+        if (center_ra < 0) center_ra += 360.0;
+        center_dec = max(-90.0, min(90.0, center_dec));
+        
+        if (verbose) {
+            cout << "\n=== Nearest Neighbour Search (tags only) ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Target: RA=" << fixed << setprecision(6) << center_ra 
+                 << " deg, DEC=" << center_dec << " deg" << endl;
+            cout << "  K: " << k << endl;
+        }
+        
+        tdlight::KnnHeap<ObjectResult> heap(max(0, k));
+        int total_fetched = 0;
+        
+        auto visit = [&](const vector<int>& pixels) {
+            string sql = "SELECT TAGS tbname, source_id, ra, dec, cls, healpix_id FROM " + super_table +
+                         " WHERE " + tdlight::pixel_condition(pixels);
+            
+            auto query_start = high_resolution_clock::now();
+            tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+            if (!reader.ok()) {
+                throw runtime_error("Query failed: " + reader.error());
+            }
+            auto fetch_start = high_resolution_clock::now();
+            stats.query_time_ms += duration<double, milli>(fetch_start - query_start).count();
+            
+            while (int n = reader.next_block()) {
+                total_fetched += n;
+                auto ra = reader.column<double>(2);
+                auto dec = reader.column<double>(3);
+                for (int r = 0; r < n; r++) {
+                    double distance = calculateAngularDistance(center_ra, center_dec, ra[r], dec[r]);
+                    if (distance > max_radius_deg || !heap.accepts(distance)) continue;
+                    ObjectResult obj;
+                    obj.table_name = string(reader.str(0, r));
+                    obj.source_id = reader.get_int64(1, r);
+                    obj.ra = ra[r];
+                    obj.dec = dec[r];
+                    obj.cls = string(reader.str(4, r));
+                    obj.healpix_id = reader.get_int64(5, r);
+                    heap.offer(distance, move(obj));
+                }
+            }
+            if (!reader.ok()) {
+                throw runtime_error("Fetch failed: " + reader.error());
+            }
+            stats.fetch_time_ms += duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        };
+        
+        tdlight::KnnProgress progress =
+            tdlight::expand_rings(*healpix_map, center_ra, center_dec, heap, visit, max_radius_deg);
+        
+        for (auto& [distance, obj] : heap.take_sorted()) {
+            neighbours.push_back(Neighbour{distance, move(obj)});
+        }
+        stats.healpix_pixels_searched = progress.pixels;
+        stats.total_results = neighbours.size();
+        double total_time = duration<double, milli>(high_resolution_clock::now() - start_time).count();
+        
+        if (verbose) {
+            cout << "\n[STATS] Query Statistics" << endl;
+            cout << "  Rings read: " << progress.rings << " (" << progress.pixels << " pixels, radius "
+                 << fixed << setprecision(4) << progress.radius_deg << " deg)" << endl;
+            cout << "  Sources read: " << total_fetched << endl;
+            cout << "  Neighbours: " << neighbours.size() << endl;
+            cout << "  Query time: " << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "  Total time: " << total_time << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        return stats;
+    }
+    
+    // Aggregate push-down: TDengine computes per-source, per-band magnitude
+    // statistics and the time span, and only the summaries are transferred.
+    // `where` selects the rows; `filter` optionally applies the exact
+    // spatial cut to the ra/dec tags of each partition.
+    QueryStats aggregateStats(const string& where, vector<SourceBandStats>& out, bool verbose,
+                              const RowFilter& filter = nullptr) {
+        QueryStats stats;
+        stats.query_type = "aggregate_stats";
+        
+        string sql = "SELECT tbname, source_id, ra, dec, band, COUNT(*), AVG(mag), STDDEV(mag), "
+                     "MIN(mag), MAX(mag), FIRST(ts), LAST(ts) FROM " + super_table +
+                     " WHERE " + where + " PARTITION BY tbname, band";
+        
+        if (verbose) {
+            cout << "  SQL query length: " << sql.length() << " chars" << endl;
+        }
+        
+        auto query_start = high_resolution_clock::now();
+        tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
+        }
+        auto fetch_start = high_resolution_clock::now();
+        stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
+        
+        vector<uint8_t> inside;
+        while (int n = reader.next_block()) {
+            auto ra = reader.column<double>(2);
+            auto dec = reader.column<double>(3);
+            if (filter) {
+                inside.resize(n);
+                filter(ra.data(), dec.data(), n, inside.data());
+            }
+            for (int r = 0; r < n; r++) {
+                if (filter && !inside[r]) continue;
+                SourceBandStats b;
+                b.table_name = string(reader.str(0, r));
+                b.source_id = reader.get_int64(1, r);
+                b.ra = ra[r];
+                b.dec = dec[r];
+                b.band = string(reader.str(4, r));
+                b.count = reader.get_int64(5, r);
+                // All-NULL mags leave AVG/MIN/MAX NULL: NaN, not a plausible 0 mag
+                b.mean_mag = reader.is_null(6, r) ? NAN : reader.get_double(6, r);
+                b.stddev_mag = reader.is_null(7, r) ? 0.0 : reader.get_double(7, r);
+                b.min_mag = reader.is_null(8, r) ? NAN : reader.get_double(8, r);
+                b.max_mag = reader.is_null(9, r) ? NAN : reader.get_double(9, r);
+                b.first_ts = reader.get_int64(10, r);
+                b.last_ts = reader.get_int64(11, r);
+                out.push_back(move(b));
+            }
+        }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        
+        stats.fetch_time_ms = duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        stats.total_results = out.size();
+        
+        if (verbose) {
+            cout << "\n[STATS] Query Statistics" << endl;
+            cout << "  Source/band summaries: " << out.size() << endl;
+            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        return stats;
+    }
+    
+    // Per-source, per-band statistics of every source inside a cone
+    QueryStats coneStats(double center_ra, double center_dec, double radius_deg,
+                         vector<SourceBandStats>& out, bool verbose = true,
+                         const string& time_filter = "") {
+        center_ra = fmod(center_ra, 360.0);
+        if (center_ra < 0) center_ra += 360.0;
+        center_dec = max(-90.0, min(90.0, center_dec));
+        
+        vector<int> pixels = conePixels(center_ra, center_dec, radius_deg);
+        if (verbose) {
+            cout << "\n=== Cone Statistics (PARTITION BY tbname, band) ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Center: RA=" << fixed << setprecision(6) << center_ra 
+                 << " deg, DEC=" << center_dec << " deg" << endl;
+            cout << "  Radius: " << radius_deg << " deg" << endl;
+            cout << "  HEALPix pixels: " << pixels.size() << endl;
+        }
+        
+        ostringstream where;
+        where << "healpix_id IN (";
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            if (i > 0) where << ",";
+            where << pixels[i];
+        }
+        where << ")";
+        if (!time_filter.empty()) where << " AND " << time_filter;
+        
+        QueryStats stats = aggregateStats(where.str(), out, verbose,
+                                          coneFilter(center_ra, center_dec, radius_deg));
+        stats.healpix_pixels_searched = pixels.size();
+        return stats;
+    }
+    
+    // Per-source, per-band statistics of every source inside a region
+    QueryStats regionStats(const tdlight::SkyRegion& region, vector<SourceBandStats>& out,
+                           bool verbose = true, const string& time_filter = "") {
+        vector<int> pixels = region.pixels(*healpix_map);
+        if (verbose) {
+            cout << "\n=== Region Statistics (PARTITION BY tbname, band) ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Region: " << region.describe() << endl;
+            cout << "  HEALPix pixels: " << pixels.size() << endl;
+        }
+        
+        QueryStats stats;
+        if (!pixels.empty()) {
+            string where = tdlight::pixel_condition(pixels);
+            if (!time_filter.empty()) where += " AND " + time_filter;
+            stats = aggregateStats(where, out, verbose, regionFilter(region));
+        }
+        stats.healpix_pixels_searched = pixels.size();
+        return stats;
+    }
+    
+    // Per-band statistics of one source
+    QueryStats sourceStats(long long source_id, const string& time_condition,
+                           vector<SourceBandStats>& out, bool verbose = true) {
+        if (verbose) {
+            cout << "\n=== Source Statistics (PARTITION BY tbname, band) ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Source ID: " << source_id << endl;
+            cout << "  Time condition: " << time_condition << endl;
+        }
+        string where = "source_id = " + to_string(source_id);
+        if (!time_condition.empty()) where += " AND " + time_condition;
+        return aggregateStats(where, out, verbose);
+    }
+    
+    // Asynchronous cone search on the main connection. Returns as soon as
+    // the query is submitted; the distance filter runs in the block handler
+    // on a TDengine client thread. `results` must outlive the future.
+    future<tdlight::AsyncResult> coneSearchAsync(double center_ra, double center_dec, double radius_deg,
+                                                 vector<QueryResult>& results,
+                                                 const string& time_filter = "", int limit = -1) {
+        center_ra = fmod(center_ra, 360.0);
+        if (center_ra < 0) center_ra += 360.0;
+        center_dec = max(-90.0, min(90.0, center_dec));
+        
+        string sql = coneSQL(conePixels(center_ra, center_dec, radius_deg), time_filter, limit);
+        return tdlight::query_async(conn, sql,
+            [this, &results, center_ra, center_dec, radius_deg](tdlight::ResultReader& reader, int n) {
+                auto ra = reader.column<double>(2);
+                auto dec = reader.column<double>(3);
+                for (int r = 0; r < n; r++) {
+                    if (calculateAngularDistance(center_ra, center_dec, ra[r], dec[r]) <= radius_deg) {
+                        QueryResult result;
+                        decodeRow(reader, r, result);
+                        results.push_back(result);
+                    }
+                }
+            });
+    }
+    
+    // Asynchronous time range query (same contract as coneSearchAsync)
+    future<tdlight::AsyncResult> timeRangeQueryAsync(long long source_id, const string& time_condition,
+                                                     vector<QueryResult>& results, int limit = -1) {
+        return tdlight::query_async(conn, timeRangeSQL(source_id, time_condition, limit),
+            [&results](tdlight::ResultReader& reader, int n) {
+                results.reserve(results.size() + n);
+                for (int r = 0; r < n; r++) {
+                    QueryResult result;
+                    decodeRow(reader, r, result);
+                    results.push_back(result);
+                }
+            });
+    }
+    
+    // Pipelined batch cone search: keeps up to `in_flight` queries submitted
+    // on the single main connection and collects them in submission order.
+    BatchStats asyncBatchConeSearch(const vector<tuple<double, double, double>>& queries,
+                                    map<int, vector<QueryResult>>& all_results,
+                                    int in_flight) {
+        in_flight = max(1, in_flight);
+        vector<vector<QueryResult>> results(queries.size());
+        deque<pair<size_t, future<tdlight::AsyncResult>>> pending;
+        vector<double> latencies;
+        latencies.reserve(queries.size());
+        long long total_results = 0;
+        int failed = 0;
+        string first_error;
+        
+        auto total_start = high_resolution_clock::now();
+        
+        auto collect = [&]() {
+            size_t idx = pending.front().first;
+            tdlight::AsyncResult r = pending.front().second.get();
+            pending.pop_front();
+            if (r.code != 0) {
+                failed++;
+                if (first_error.empty()) first_error = r.error;
+                return;
+            }
+            latencies.push_back(r.total_ms);
+            total_results += results[idx].size();
+            all_results[idx] = move(results[idx]);
+        };
+        
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if ((int)pending.size() >= in_flight) collect();
+            pending.emplace_back(i, coneSearchAsync(get<0>(queries[i]), get<1>(queries[i]),
+                                                    get<2>(queries[i]), results[i]));
+        }
+        while (!pending.empty()) collect();
+        
+        double total_time = duration<double, milli>(high_resolution_clock::now() - total_start).count();
+        
+        BatchStats b = summarizeLatencies(move(latencies), total_time, in_flight);
+        b.mode = "async";
+        b.failed = failed;
+        b.total_results = total_results;
+        
+        if (!first_error.empty()) {
+            cerr << "[WARN] " << failed << " queries failed (first error: " << first_error << ")" << endl;
+        }
+        return b;
+    }
+    
+    // Benchmark the synchronous path (one blocking query at a time) against
+    // async pipelining at each in-flight depth, all on the same connection.
+    // all_results holds the output of the last depth.
+    vector<BatchStats> asyncBenchmark(const vector<tuple<double, double, double>>& queries,
+                                      map<int, vector<QueryResult>>& all_results,
+                                      const vector<int>& depths) {
+        vector<BatchStats> rows;
+        
+        cout << "\n=== Async Pipelining Benchmark ===" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        cout << "  Query count: " << queries.size() << endl;
+        
+        // Synchronous baseline
+        vector<double> latencies;
+        long long total_results = 0;
+        int failed = 0;
+        auto sync_start = high_resolution_clock::now();
+        for (const auto& q : queries) {
+            auto q_start = high_resolution_clock::now();
+            try {
+                vector<QueryResult> results;
+                coneSearch(get<0>(q), get<1>(q), get<2>(q), results, false);
+                total_results += results.size();
+                latencies.push_back(duration<double, milli>(high_resolution_clock::now() - q_start).count());
+            } catch (const exception&) {
+                failed++;
+            }
+        }
+        double sync_time = duration<double, milli>(high_resolution_clock::now() - sync_start).count();
+        BatchStats sync_stats = summarizeLatencies(move(latencies), sync_time, 1);
+        sync_stats.mode = "sync";
+        sync_stats.failed = failed;
+        sync_stats.total_results = total_results;
+        rows.push_back(sync_stats);
+        cout << "  [RUN] sync done in " << fixed << setprecision(2) << sync_time << " ms" << endl;
+        
+        for (int depth : depths) {
+            all_results.clear();
+            BatchStats b = asyncBatchConeSearch(queries, all_results, depth);
+            rows.push_back(b);
+            cout << "  [RUN] async in_flight=" << b.concurrency << " done in "
+                 << fixed << setprecision(2) << b.total_time_ms << " ms" << endl;
+        }
+        
+        printBatchTable(rows);
+        
+        double best_qps = 0;
+        for (size_t i = 1; i < rows.size(); ++i) best_qps = max(best_qps, rows[i].qps);
+        if (sync_stats.qps > 0 && best_qps > 0) {
+            cout << "  Best async speedup over sync: " << fixed << setprecision(2)
+                 << (best_qps / sync_stats.qps) << "x" << endl;
+        }
+        return rows;
+    }
+    
+    // Batch cone search (multi-center optimization)
+    map<int, QueryStats> batchConeSearch(const vector<tuple<double, double, double>>& queries,
+                                        map<int, vector<QueryResult>>& all_results,
+                                        bool verbose = true) {
+        map<int, QueryStats> stats_map;
+        vector<double> latencies;
+        latencies.reserve(queries.size());
+        
+        cout << "\n=== Batch Cone Search ===" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        cout << "  Query count: " << queries.size() << endl;
+        
+        auto total_start = high_resolution_clock::now();
+        
+        for (size_t i = 0; i < queries.size(); ++i) {
+            double ra = get<0>(queries[i]);
+            double dec = get<1>(queries[i]);
+            double radius = get<2>(queries[i]);
+            
+            auto q_start = high_resolution_clock::now();
+            vector<QueryResult> results;
+            QueryStats stats = coneSearch(ra, dec, radius, results, false);
+            latencies.push_back(duration<double, milli>(high_resolution_clock::now() - q_start).count());
+            
+            all_results[i] = move(results);
+            stats_map[i] = stats;
+            
+            if (verbose && (i + 1) % 10 == 0) {
+                cout << "  Progress: " << (i + 1) << "/" << queries.size() << endl;
+            }
+        }
+        
+        auto total_end = high_resolution_clock::now();
+        double total_time = duration<double, milli>(total_end - total_start).count();
+        
+        // Statistics
+        int total_results = 0;
+        for (const auto& [idx, stats] : stats_map) {
+            total_results += stats.total_results;
+        }
+        BatchStats b = summarizeLatencies(move(latencies), total_time, 1);
+        
+        cout << "\n[STATS] Batch Query Complete" << endl;
+        cout << "  Total queries: " << queries.size() << endl;
+        cout << "  Total results: " << total_results << endl;
+        cout << "  Total time: " << fixed << setprecision(2) << total_time << " ms" << endl;
+        cout << "  Avg time: " << (total_time / queries.size()) << " ms/query" << endl;
+        cout << "  Latency p50/p95/p99: " << b.p50_ms << " / " << b.p95_ms << " / " << b.p99_ms << " ms" << endl;
+        cout << "  Throughput: " << fixed << setprecision(1) 
+             << (queries.size() * 1000.0 / total_time) << " queries/s" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        
+        return stats_map;
+    }
+    
+    // Pixel-coalesced batch cone search.
+    // The pixel sets of all cones are merged into one rangeset, which is
+    // fetched with a few range queries (healpix_id BETWEEN a AND b) so that
+    // every row is read from TDengine once even when cones overlap. Each
+    // fetched row is then assigned on the client to every cone whose pixel
+    // set contains its healpix_id and whose exact radius contains it.
+    QueryStats coalescedBatchConeSearch(const vector<tuple<double, double, double>>& queries,
+                                       map<int, vector<QueryResult>>& all_results,
+                                       bool verbose = true, int workers = 1,
+                                       size_t ranges_per_query = 256) {
+        QueryStats stats;
+        stats.query_type = "coalesced_batch";
+        
+        auto total_start = high_resolution_clock::now();
+        
+        // 1. Plan: union of pixel ranges and pixel -> cones index
+        struct Cone { double ra, dec, radius; };
+        vector<Cone> cones;
+        cones.reserve(queries.size());
+        rangeset<int> pixel_union;
+        unordered_map<int, vector<int>> pixel_cones;
+        size_t pixels_per_cone_total = 0;
+        
+        for (size_t i = 0; i < queries.size(); ++i) {
+            Cone c{fmod(get<0>(queries[i]), 360.0), get<1>(queries[i]), get<2>(queries[i])};
+            if (c.ra < 0) c.ra += 360.0;
+            c.dec = max(-90.0, min(90.0, c.dec));
+            cones.push_back(c);
+            
+            vector<int> pixels = conePixels(c.ra, c.dec, c.radius);
+            pixels_per_cone_total += pixels.size();
+            for (int pix : pixels) {
+                pixel_union.add(pix);
+                pixel_cones[pix].push_back(i);
+            }
+        }
+        
+        // 2. Split the merged ranges into a few SQL statements
+        vector<string> statements;
+        for (size_t r = 0; r < pixel_union.nranges(); r += ranges_per_query) {
+            ostringstream sql;
+            sql << "SELECT " << RESULT_COLUMNS << ", healpix_id FROM " << super_table << " WHERE ";
+            size_t end = min(r + ranges_per_query, (size_t)pixel_union.nranges());
+            for (size_t k = r; k < end; ++k) {
+                if (k > r) sql << " OR ";
+                int a = pixel_union.ivbegin(k), b = pixel_union.ivend(k) - 1;
+                if (a == b) sql << "healpix_id = " << a;
+                else sql << "healpix_id BETWEEN " << a << " AND " << b;
+            }
+            statements.push_back(sql.str());
+        }
+        
+        stats.healpix_pixels_searched = pixel_union.nval();
+        
+        if (verbose) {
+            cout << "\n=== Coalesced Batch Cone Search ===" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+            cout << "  Query count: " << queries.size() << endl;
+            cout << "  Pixels (sum over cones): " << pixels_per_cone_total << endl;
+            cout << "  Pixels (unique): " << pixel_union.nval()
+                 << " in " << pixel_union.nranges() << " ranges" << endl;
+            cout << "  SQL statements: " << statements.size() << endl;
+        }
+        
+        // 3. Execute statements; each worker assigns rows into its own buffers
+        vector<vector<vector<QueryResult>>> partial(statements.size());
+        vector<long long> fetched(statements.size(), 0);
+        vector<double> query_ms(statements.size(), 0), fetch_ms(statements.size(), 0);
+        atomic<size_t> next{0};
+        mutex err_mutex;
+        string first_error;
+        
+        auto run_statement = [&](TAOS* db, size_t s_idx) {
+            auto query_start = high_resolution_clock::now();
+            tdlight::ResultReader reader(taos_query(db, statements[s_idx].c_str()));
+            if (!reader.ok()) {
+                throw runtime_error("Query failed: " + reader.error());
+            }
+            auto fetch_start = high_resolution_clock::now();
+            query_ms[s_idx] = duration<double, milli>(fetch_start - query_start).count();
+            
+            vector<vector<QueryResult>>& out = partial[s_idx];
+            out.resize(cones.size());
+            while (int n = reader.next_block()) {
+                fetched[s_idx] += n;
+                auto ra = reader.column<double>(2);
+                auto dec = reader.column<double>(3);
+                auto pix = reader.column<int64_t>(11);
+                
+                for (int r = 0; r < n; r++) {
+                    auto it = pixel_cones.find((int)pix[r]);
+                    if (it == pixel_cones.end()) continue;
+                    bool decoded = false;
+                    QueryResult result;
+                    for (int cone_idx : it->second) {
+                        const Cone& c = cones[cone_idx];
+                        if (calculateAngularDistance(c.ra, c.dec, ra[r], dec[r]) <= c.radius) {
+                            if (!decoded) {
+                                decodeRow(reader, r, result);
+                                decoded = true;
+                            }
+                            out[cone_idx].push_back(result);
+                        }
+                    }
+                }
+            }
+            if (!reader.ok()) {
+                throw runtime_error("Fetch failed: " + reader.error());
+            }
+            fetch_ms[s_idx] = duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        };
+        
+        workers = max(1, min(workers, (int)statements.size()));
+        if (workers == 1) {
+            for (size_t i = 0; i < statements.size(); ++i) run_statement(conn, i);
+        } else {
+            workers = reservePool(workers);
+            vector<thread> threads;
+            for (int t = 0; t < workers; ++t) {
+                threads.emplace_back([&]() {
+                    tdlight::ConnectionPool::Lease lease = pool->checkout();
+                    if (!lease) {
+                        lock_guard<mutex> lock(err_mutex);
+                        if (first_error.empty()) first_error = "Connection failed";
+                        return;
+                    }
+                    size_t i;
+                    while ((i = next.fetch_add(1)) < statements.size()) {
+                        try {
+                            run_statement(lease.get(), i);
+                        } catch (const exception& e) {
+                            lock_guard<mutex> lock(err_mutex);
+                            if (first_error.empty()) first_error = e.what();
+                        }
+                    }
+                });
+            }
+            for (auto& t : threads) t.join();
+            if (!first_error.empty()) throw runtime_error(first_error);
+        }
+        
+        // 4. Merge per-statement buffers in statement order
+        long long total_fetched = 0, total_assigned = 0;
+        for (size_t i = 0; i < cones.size(); ++i) all_results[i].clear();
+        for (size_t s_idx = 0; s_idx < statements.size(); ++s_idx) {
+            total_fetched += fetched[s_idx];
+            stats.query_time_ms += query_ms[s_idx];
+            stats.fetch_time_ms += fetch_ms[s_idx];
+            for (size_t i = 0; i < partial[s_idx].size(); ++i) {
+                auto& dst = all_results[i];
+                auto& src = partial[s_idx][i];
+                total_assigned += src.size();
+                dst.insert(dst.end(), make_move_iterator(src.begin()), make_move_iterator(src.end()));
+            }
+        }
+        stats.total_results = total_assigned;
+        
+        double total_time = duration<double, milli>(high_resolution_clock::now() - total_start).count();
+        
+        if (verbose) {
+            cout << "\n[STATS] Coalesced Batch Complete" << endl;
+            cout << "  Rows fetched: " << total_fetched << " (each read once)" << endl;
+            cout << "  Rows assigned to cones: " << total_assigned << endl;
+            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
+            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
+            cout << "  Total time: " << total_time << " ms" << endl;
+            cout << "  Throughput: " << fixed << setprecision(1)
+                 << (queries.size() * 1000.0 / total_time) << " queries/s" << endl;
+            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        }
+        
+        return stats;
+    }
+    
+    // Enable the result cache with the given budget (0 disables it)
+    void setCacheBudget(size_t megabytes) {
+        if (megabytes == 0) cache.reset();
+        else cache = make_unique<tdlight::QueryCache<vector<QueryResult>>>(megabytes << 20);
+    }
+    
+    void printCacheStats() const {
+        if (!cache) return;
+        tdlight::CacheStats cs = cache->stats();
+        uint64_t lookups = cs.hits + cs.misses;
+        cout << "[STATS] Result cache: " << cs.hits << " hits / " << cs.misses << " misses ("
+             << fixed << setprecision(1) << (lookups ? 100.0 * cs.hits / lookups : 0.0) << "% hit rate), "
+             << cs.entries << " entries, " << setprecision(1) << (cs.bytes / 1048576.0) << " / "
+             << (cs.budget / 1048576.0) << " MB, " << cs.evictions << " evictions" << endl;
+    }
+    
+    // Size the connection pool (connections are opened lazily)
+    void setPoolSize(int size) {
+        if (!pool || (int)pool->max_size() != size) {
+            pool = make_unique<tdlight::ConnectionPool>(conn_params, max(1, size));
+        }
+    }
+    
+    // Pool size given with --pool_size: it is never grown, concurrency is capped instead
+    void fixPoolSize(int size) {
+        fixed_pool_size = max(1, size);
+        setPoolSize(fixed_pool_size);
+    }
+    
+    // Make room for `workers` pooled connections; returns the number of
+    // workers that can actually run
+    int reservePool(int workers) {
+        if (fixed_pool_size > 0) {
+            if (workers > fixed_pool_size) {
+                cerr << "[WARN] Concurrency " << workers << " capped at --pool_size " << fixed_pool_size << endl;
+                workers = fixed_pool_size;
+            }
+            setPoolSize(fixed_pool_size);
+        } else if (!pool || (int)pool->max_size() < workers) {
+            setPoolSize(workers);
+        }
+        return workers;
+    }
+    
+    // Parallel batch cone search: `concurrency` workers, each holding one
+    // pooled connection, pull queries from a shared counter. Results are
+    // stored by query index, so all_results keeps the input order.
+    BatchStats parallelBatchConeSearch(const vector<tuple<double, double, double>>& queries,
+                                       map<int, vector<QueryResult>>& all_results,
+                                       int concurrency) {
+        concurrency = reservePool(max(1, min(concurrency, (int)queries.size())));
+        pool->warm_up(concurrency);
+        
+        vector<vector<QueryResult>> results(queries.size());
+        vector<double> latencies(queries.size(), 0.0);
+        vector<char> ok(queries.size(), 0);
+        atomic<size_t> next{0};
+        mutex err_mutex;
+        string first_error;
+        
+        auto total_start = high_resolution_clock::now();
+        
+        auto worker = [&]() {
+            tdlight::ConnectionPool::Lease lease = pool->checkout();
+            if (!lease) {
+                lock_guard<mutex> lock(err_mutex);
+                if (first_error.empty()) first_error = "Connection failed: " + string(taos_errstr(nullptr));
+                return;
+            }
+            size_t i;
+            while ((i = next.fetch_add(1)) < queries.size()) {
+                auto q_start = high_resolution_clock::now();
+                try {
+                    coneSearchOn(lease.get(), get<0>(queries[i]), get<1>(queries[i]),
+                                 get<2>(queries[i]), results[i], false);
+                    ok[i] = 1;
+                } catch (const exception& e) {
+                    lock_guard<mutex> lock(err_mutex);
+                    if (first_error.empty()) first_error = e.what();
+                }
+                latencies[i] = duration<double, milli>(high_resolution_clock::now() - q_start).count();
+            }
+        };
+        
+        vector<thread> workers;
+        for (int t = 0; t < concurrency; ++t) workers.emplace_back(worker);
+        for (auto& t : workers) t.join();
+        
+        double total_time = duration<double, milli>(high_resolution_clock::now() - total_start).count();
+        
+        vector<double> done_latencies;
+        long long total_results = 0;
+        int failed = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (!ok[i]) { failed++; continue; }
+            done_latencies.push_back(latencies[i]);
+            total_results += results[i].size();
+            all_results[i] = move(results[i]);
+        }
+        BatchStats b = summarizeLatencies(move(done_latencies), total_time, concurrency);
+        b.failed = failed;
+        b.total_results = total_results;
+        
+        if (!first_error.empty()) {
+            cerr << "[WARN] " << failed << " queries failed (first error: " << first_error << ")" << endl;
+        }
+        return b;
+    }
+    
+    // Run the batch once per concurrency level and print a comparison table.
+    // all_results holds the output of the last level.
+    vector<BatchStats> concurrencySweep(const vector<tuple<double, double, double>>& queries,
+                                        map<int, vector<QueryResult>>& all_results,
+                                        const vector<int>& levels) {
+        vector<BatchStats> sweep;
+        
+        cout << "\n=== Parallel Batch Cone Search ===" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        cout << "  Query count: " << queries.size() << endl;
+        cout << "  Pool size: " << (pool ? pool->max_size() : 0) << endl;
+        
+        for (int level : levels) {
+            all_results.clear();
+            BatchStats b = parallelBatchConeSearch(queries, all_results, level);
+            sweep.push_back(b);
+            cout << "  [RUN] concurrency=" << b.concurrency << " done in "
+                 << fixed << setprecision(2) << b.total_time_ms << " ms" << endl;
+        }
+        
+        printBatchTable(sweep);
+        return sweep;
+    }
+    
+    // Synthetic workload: cone centres are drawn from sampled source
+    // positions (so they follow the source density) and jittered within
+    // the radius; time-range lookups use sampled source IDs. Time windows
+    // fall inside the stored time span.
+    vector<WorkloadQuery> generateWorkload(const WorkloadSpec& spec) {
+        struct Sample { long long source_id; double ra, dec; };
+        vector<Sample> sample;
+        mt19937_64 rng(spec.seed);
+        
+        // Reservoir sample of the child-table tags (one row per source)
+        string sql = "SELECT TAGS source_id, ra, dec FROM " + super_table;
+        tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
+        }
+        long long seen = 0;
+        size_t reservoir = max(1, spec.sample_sources);
+        while (int n = reader.next_block()) {
+            auto source_id = reader.column<int64_t>(0);
+            auto ra = reader.column<double>(1);
+            auto dec = reader.column<double>(2);
+            for (int r = 0; r < n; r++, seen++) {
+                Sample smp{source_id[r], ra[r], dec[r]};
+                if (sample.size() < reservoir) {
+                    sample.push_back(smp);
+                } else {
+                    uniform_int_distribution<long long> pick(0, seen);
+                    long long j = pick(rng);
+                    if (j < (long long)reservoir) sample[j] = smp;
+                }
+            }
+        }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        if (sample.empty()) {
+            throw runtime_error("No sources in " + db_name + "." + super_table + " to build a workload from");
+        }
+        
+        int64_t first_ts = 0, last_ts = 0;
+        bool need_span = spec.time_share > 0 || spec.time_filter_share > 0;
+        if (need_span) {
+            tdlight::ResultReader span(taos_query(conn, ("SELECT FIRST(ts), LAST(ts) FROM " + super_table).c_str()));
+            if (span.ok() && span.next_block() > 0 && !span.is_null(0, 0)) {
+                first_ts = span.get_int64(0, 0);
+                last_ts = span.get_int64(1, 0);
+            }
+        }
+        int64_t window_ms = (int64_t)(spec.window_days * 86400000.0);
+        auto time_window = [&](WorkloadQuery& q) {
+            int64_t latest_start = max<int64_t>(first_ts, last_ts - window_ms);
+            uniform_int_distribution<int64_t> start(first_ts, latest_start);
+            q.start_ms = start(rng);
+            q.end_ms = q.start_ms + window_ms;
+            q.time_filter = "ts >= " + to_string(q.start_ms) + " AND ts < " + to_string(q.end_ms);
+        };
+        
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        uniform_int_distribution<size_t> pick_source(0, sample.size() - 1);
+        double log_min = log(max(1e-6, spec.radius_min));
+        double log_max = log(max(spec.radius_min, spec.radius_max));
+        
+        vector<WorkloadQuery> queries(max(0, spec.queries));
+        for (auto& q : queries) {
+            const Sample& src = sample[pick_source(rng)];
+            q.cone = unit(rng) >= spec.time_share;
+            if (q.cone) {
+                q.radius = exp(log_min + (log_max - log_min) * unit(rng));
+                // Offset the centre by up to one radius in a random direction
+                double offset = q.radius * sqrt(unit(rng));
+                double angle = 2 * PI * unit(rng);
+                q.dec = max(-90.0, min(90.0, src.dec + offset * sin(angle)));
+                double cos_dec = max(1e-3, cos(q.dec * DEG2RAD));
+                q.ra = fmod(src.ra + offset * cos(angle) / cos_dec + 360.0, 360.0);
+                if (last_ts > first_ts && unit(rng) < spec.time_filter_share) time_window(q);
+            } else {
+                q.source_id = src.source_id;
+                q.start_ms = first_ts;
+                q.end_ms = last_ts + 1;
+                if (last_ts > first_ts) time_window(q);
             }
         }
         
-        auto fetch_end = high_resolution_clock::now();
-        stats.fetch_time_ms = duration<double, milli>(fetch_end - fetch_start).count();
+        cout << "[INFO] Workload: " << queries.size() << " queries from " << sample.size()
+             << " sampled sources (of " << seen << ")" << endl;
+        return queries;
+    }
+    
+    // Run a workload with `concurrency` pooled workers
+    BenchRun runWorkload(const vector<WorkloadQuery>& queries, int concurrency, bool prepared = false) {
+        concurrency = reservePool(max(1, min(concurrency, (int)queries.size())));
+        pool->warm_up(concurrency);
+        
+        vector<double> latencies(queries.size(), 0.0);
+        vector<long long> result_counts(queries.size(), 0);
+        vector<char> ok(queries.size(), 0);
+        atomic<size_t> next{0};
+        mutex err_mutex;
+        string first_error;
         
-        taos_free_result(res);
+        auto total_start = high_resolution_clock::now();
         
-        stats.total_results = filtered_count;
+        auto worker = [&]() {
+            tdlight::ConnectionPool::Lease lease = pool->checkout();
+            if (!lease) {
+                lock_guard<mutex> lock(err_mutex);
+                if (first_error.empty()) first_error = "Connection failed: " + string(taos_errstr(nullptr));
+                return;
+            }
+            unique_ptr<PreparedTimeRange> stmt;
+            vector<QueryResult> results;
+            size_t i;
+            while ((i = next.fetch_add(1)) < queries.size()) {
+                const WorkloadQuery& q = queries[i];
+                results.clear();
+                auto q_start = high_resolution_clock::now();
+                try {
+                    if (q.cone) {
+                        coneSearchOn(lease.get(), q.ra, q.dec, q.radius, results, false, q.time_filter);
+                    } else {
+                        if (prepared && !stmt) stmt = make_unique<PreparedTimeRange>(lease.get(), super_table);
+                        tdlight::ResultReader reader = stmt
+                            ? stmt->run(q.source_id, q.start_ms, q.end_ms)
+                            : tdlight::ResultReader(taos_query(lease.get(),
+                                  timeRangeSQL(q.source_id, q.time_filter).c_str()));
+                        if (!reader.ok()) throw runtime_error("Query failed: " + reader.error());
+                        QueryResult row;
+                        while (int n = reader.next_block()) {
+                            for (int r = 0; r < n; r++) {
+                                decodeRow(reader, r, row);
+                                results.push_back(row);
+                            }
+                        }
+                        if (!reader.ok()) throw runtime_error("Fetch failed: " + reader.error());
+                    }
+                    ok[i] = 1;
+                    result_counts[i] = results.size();
+                } catch (const exception& e) {
+                    lock_guard<mutex> lock(err_mutex);
+                    if (first_error.empty()) first_error = e.what();
+                }
+                latencies[i] = duration<double, milli>(high_resolution_clock::now() - q_start).count();
+            }
+        };
         
-        auto end_time = high_resolution_clock::now();
-        double total_time = duration<double, milli>(end_time - start_time).count();
+        vector<thread> workers;
+        for (int t = 0; t < concurrency; ++t) workers.emplace_back(worker);
+        for (auto& t : workers) t.join();
         
-        if (verbose) {
-            cout << "\n[STATS] Query Statistics" << endl;
-            cout << "  HEALPix filtered: " << total_fetched << " records" << endl;
-            cout << "  Angular distance filtered: " << filtered_count << " records (exact match)" << endl;
-            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
-            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
-            cout << "  Total time: " << total_time << " ms" << endl;
-            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        double total_time = duration<double, milli>(high_resolution_clock::now() - total_start).count();
+        
+        BenchRun run;
+        vector<double> all_ms;
+        long long cone_results = 0, time_results = 0;
+        int cone_failed = 0, time_failed = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            bool cone = queries[i].cone;
+            if (!ok[i]) { (cone ? cone_failed : time_failed)++; continue; }
+            all_ms.push_back(latencies[i]);
+            (cone ? run.cone_ms : run.time_ms).push_back(latencies[i]);
+            (cone ? cone_results : time_results) += result_counts[i];
         }
         
-        return stats;
+        run.all = summarizeLatencies(all_ms, total_time, concurrency);
+        run.cone = summarizeLatencies(run.cone_ms, total_time, concurrency);
+        run.time = summarizeLatencies(run.time_ms, total_time, concurrency);
+        run.all.mode = "all";
+        run.cone.mode = "cone";
+        run.time.mode = "time";
+        run.cone.failed = cone_failed;
+        run.time.failed = time_failed;
+        run.all.failed = cone_failed + time_failed;
+        run.cone.total_results = cone_results;
+        run.time.total_results = time_results;
+        run.all.total_results = cone_results + time_results;
+        sort(run.cone_ms.begin(), run.cone_ms.end());
+        sort(run.time_ms.begin(), run.time_ms.end());
+        
+        if (!first_error.empty()) {
+            cerr << "[WARN] " << run.all.failed << " queries failed (first error: " << first_error << ")" << endl;
+        }
+        return run;
     }
     
-    // Time range query for single source_id
-    QueryStats timeRangeQuery(long long source_id, const string& time_condition,
-                             vector<QueryResult>& results, bool verbose = true,
-                             int limit = -1) {
-        
-        QueryStats stats;
-        stats.query_type = "time_range";
-        
-        auto start_time = high_resolution_clock::now();
-        
-        if (verbose) {
-            cout << "\n=== Time Range Query ===" << endl;
-            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
-            cout << "  Source ID: " << source_id << endl;
-            cout << "  Time condition: " << time_condition << endl;
+    // Generate a workload, run it at each concurrency level, print the
+    // table and (if json_file is set) write a JSON report for tracking
+    // regressions across TDengine / TDlight versions.
+    vector<BenchRun> workloadBenchmark(const WorkloadSpec& spec, const vector<int>& levels,
+                                       const string& json_file) {
+        cout << "\n=== Workload Benchmark ===" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        cout << "  Queries per level: " << spec.queries << endl;
+        cout << "  Cone radius: " << spec.radius_min << " - " << spec.radius_max << " deg (log-uniform)" << endl;
+        cout << "  Time-range share: " << spec.time_share
+             << (spec.prepared ? " (prepared)" : "")
+             << ", cones with time window: " << spec.time_filter_share << endl;
+        
+        vector<WorkloadQuery> queries = generateWorkload(spec);
+        vector<BenchRun> runs;
+        vector<BatchStats> table;
+        for (int level : levels) {
+            runs.push_back(runWorkload(queries, level, spec.prepared));
+            const BenchRun& run = runs.back();
+            cout << "  [RUN] concurrency=" << run.all.concurrency << " done in "
+                 << fixed << setprecision(2) << run.all.total_time_ms << " ms" << endl;
+            table.push_back(run.all);
+            if (run.cone.queries) table.push_back(run.cone);
+            if (run.time.queries) table.push_back(run.time);
         }
+        printBatchTable(table);
         
-        // Build SQL query (optimized with TAGS filtering)
-        ostringstream sql;
-        sql << "SELECT ts, source_id, ra, dec, band, cls, mag, mag_error, "
-            << "flux, flux_error, jd_tcb FROM " << super_table 
-            << " WHERE source_id = " << source_id;
-        
-        // Add time condition
-        if (!time_condition.empty()) {
-            sql << " AND " << time_condition;
+        if (!json_file.empty()) {
+            writeBenchJSON(spec, runs, json_file);
+        }
+        return runs;
+    }
+    
+    void writeBenchJSON(const WorkloadSpec& spec, const vector<BenchRun>& runs, const string& filename) {
+        ofstream file(filename);
+        if (!file.is_open()) {
+            throw runtime_error("Cannot create output file: " + filename);
         }
         
-        // Order by time
-        sql << " ORDER BY ts ASC";
-        
-        // Add LIMIT
-        if (limit > 0) {
-            sql << " LIMIT " << limit;
+        auto stats_json = [&](const BatchStats& b, const vector<double>* latencies_ms) {
+            ostringstream o;
+            o << fixed << setprecision(3)
+              << "{\"queries\":" << b.queries << ",\"failed\":" << b.failed
+              << ",\"results\":" << b.total_results << ",\"qps\":" << b.qps
+              << ",\"mean_ms\":" << b.mean_ms << ",\"p50_ms\":" << b.p50_ms
+              << ",\"p95_ms\":" << b.p95_ms << ",\"p99_ms\":" << b.p99_ms
+              << ",\"max_ms\":" << b.max_ms;
+            if (latencies_ms) {
+                o << ",\"histogram\":[";
+                auto buckets = latencyHistogram(*latencies_ms);
+                for (size_t i = 0; i < buckets.size(); i++) {
+                    o << (i ? "," : "") << "{\"le_ms\":" << buckets[i].first
+                      << ",\"count\":" << buckets[i].second << "}";
+                }
+                o << "]";
+            }
+            o << "}";
+            return o.str();
+        };
+        
+        const char* server = taos_get_server_info(conn);
+        time_t now = time(nullptr);
+        struct tm utc;
+        gmtime_r(&now, &utc);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        
+        file << "{\n";
+        file << "  \"timestamp\": \"" << stamp << "\",\n";
+        file << "  \"tdengine_client\": \"" << tdlight::json_escape(taos_get_client_info()) << "\",\n";
+        file << "  \"tdengine_server\": \"" << tdlight::json_escape(server ? server : "") << "\",\n";
+        file << "  \"database\": \"" << tdlight::json_escape(db_name) << "\",\n";
+        file << "  \"table\": \"" << tdlight::json_escape(super_table) << "\",\n";
+        file << "  \"nside\": " << nside << ",\n";
+        file << "  \"cache_mb\": " << (cache ? cache->stats().budget / 1048576 : 0) << ",\n";
+        file << "  \"workload\": {\"queries\": " << spec.queries
+             << ", \"radius_min\": " << spec.radius_min << ", \"radius_max\": " << spec.radius_max
+             << ", \"time_share\": " << spec.time_share << ", \"time_filter_share\": " << spec.time_filter_share
+             << ", \"window_days\": " << spec.window_days << ", \"prepared\": " << (spec.prepared ? "true" : "false")
+             << ", \"seed\": " << spec.seed << "},\n";
+        file << "  \"levels\": [\n";
+        for (size_t i = 0; i < runs.size(); i++) {
+            const BenchRun& run = runs[i];
+            vector<double> all_ms = run.cone_ms;
+            all_ms.insert(all_ms.end(), run.time_ms.begin(), run.time_ms.end());
+            file << "    {\"concurrency\": " << run.all.concurrency
+                 << ", \"total_time_ms\": " << fixed << setprecision(3) << run.all.total_time_ms << ",\n"
+                 << "     \"all\": " << stats_json(run.all, &all_ms) << ",\n"
+                 << "     \"cone\": " << stats_json(run.cone, &run.cone_ms) << ",\n"
+                 << "     \"time\": " << stats_json(run.time, &run.time_ms) << "}"
+                 << (i + 1 < runs.size() ? "," : "") << "\n";
         }
+        file << "  ]\n}\n";
         
-        if (verbose) {
-            cout << "  SQL: " << sql.str() << endl;
+        file.close();
+        cout << "[OK] Benchmark report written to: " << filename << endl;
+    }
+    
+    void printBatchTable(const vector<BatchStats>& sweep) {
+        cout << "\n[STATS] Throughput and latency by concurrency" << endl;
+        cout << "  " << setw(6) << "mode" << setw(6) << "conc" << setw(10) << "queries" << setw(8) << "failed"
+             << setw(12) << "results" << setw(12) << "QPS" << setw(10) << "mean"
+             << setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99"
+             << setw(10) << "max" << "  (ms)" << endl;
+        for (const auto& b : sweep) {
+            cout << "  " << setw(6) << b.mode << setw(6) << b.concurrency << setw(10) << b.queries << setw(8) << b.failed
+                 << setw(12) << b.total_results
+                 << fixed << setprecision(1) << setw(12) << b.qps
+                 << setprecision(2) << setw(10) << b.mean_ms
+                 << setw(10) << b.p50_ms << setw(10) << b.p95_ms << setw(10) << b.p99_ms
+                 << setw(10) << b.max_ms << endl;
         }
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+    }
+    
+    // Export results to file (CSV, or FITS for .fits names)
+    void exportResults(const vector<QueryResult>& results, const string& filename) {
+        unique_ptr<ResultSink> sink = makeSink(filename);
+        for (const auto& r : results) sink->write(r);
+        sink->close();
+        cout << "[OK] Results exported to: " << filename << " (" << results.size() << " records)" << endl;
+    }
+    
+    // Run `sql` and write every row to the output file as blocks arrive, so
+    // memory stays constant however many rows match. `filter` applies the
+    // exact spatial cut; the first `keep` written rows are copied to `head`
+    // for display.
+    QueryStats streamToFile(const string& sql, const string& filename,
+                            vector<QueryResult>& head, size_t keep,
+                            const RowFilter& filter = nullptr) {
+        QueryStats stats;
+        stats.query_type = "export";
         
-        auto query_start = high_resolution_clock::now();
+        unique_ptr<ResultSink> sink = makeSink(filename);
         
-        // Execute query
-        TAOS_RES* res = taos_query(conn, sql.str().c_str());
-        if (taos_errno(res) != 0) {
-            string error = "Query failed: " + string(taos_errstr(res));
-            taos_free_result(res);
-            throw runtime_error(error);
+        auto query_start = high_resolution_clock::now();
+        tdlight::ResultReader reader(taos_query(conn, sql.c_str()));
+        if (!reader.ok()) {
+            throw runtime_error("Query failed: " + reader.error());
         }
-        
         auto fetch_start = high_resolution_clock::now();
         stats.query_time_ms = duration<double, milli>(fetch_start - query_start).count();
         
-        // Fetch results
-        TAOS_ROW row;
-        while ((row = taos_fetch_row(res))) {
-            QueryResult result;
-            result.ts = *(int64_t*)row[0];
-            result.source_id = *(long long*)row[1];
-            result.ra = *(double*)row[2];
-            result.dec = *(double*)row[3];
-            result.band = row[4] ? string((char*)row[4]) : "";
-            result.cls = row[5] ? string((char*)row[5]) : "";
-            result.mag = *(double*)row[6];
-            result.mag_error = *(double*)row[7];
-            result.flux = *(double*)row[8];
-            result.flux_error = *(double*)row[9];
-            result.jd_tcb = *(double*)row[10];
-            
-            results.push_back(result);
+        long long written = 0;
+        QueryResult row;
+        vector<uint8_t> inside;
+        while (int n = reader.next_block()) {
+            if (filter) {
+                inside.resize(n);
+                filter(reader.column<double>(2).data(), reader.column<double>(3).data(), n, inside.data());
+            }
+            for (int r = 0; r < n; r++) {
+                if (filter && !inside[r]) continue;
+                decodeRow(reader, r, row);
+                sink->write(row);
+                if (head.size() < keep) head.push_back(row);
+                written++;
+            }
         }
+        if (!reader.ok()) {
+            throw runtime_error("Fetch failed: " + reader.error());
+        }
+        sink->close();
         
-        auto fetch_end = high_resolution_clock::now();
-        stats.fetch_time_ms = duration<double, milli>(fetch_end - fetch_start).count();
-        
-        taos_free_result(res);
-        
-        stats.total_results = results.size();
+        stats.fetch_time_ms = duration<double, milli>(high_resolution_clock::now() - fetch_start).count();
+        stats.total_results = written;
         
-        auto end_time = high_resolution_clock::now();
-        double total_time = duration<double, milli>(end_time - start_time).count();
+        double secs = stats.fetch_time_ms / 1000.0;
+        cout << "[OK] Results exported to: " << filename << " (" << written << " records, "
+             << fixed << setprecision(1) << (sink->bytes() / 1048576.0) << " MB)" << endl;
+        cout << "[STATS] Export: query " << setprecision(2) << stats.query_time_ms << " ms, fetch+write "
+             << stats.fetch_time_ms << " ms, " << setprecision(0)
+             << (secs > 0 ? written / secs : 0.0) << " rows/s" << endl;
+        return stats;
+    }
+    
+    // Streaming export of a cone search
+    QueryStats streamConeToFile(double center_ra, double center_dec, double radius_deg,
+                               const string& filename, vector<QueryResult>& head, size_t keep,
+                               const string& time_filter = "", int limit = -1) {
+        center_ra = fmod(center_ra, 360.0);
+        if (center_ra < 0) center_ra += 360.0;
+        center_dec = max(-90.0, min(90.0, center_dec));
         
-        if (verbose) {
-            cout << "\n[STATS] Query Statistics" << endl;
-            cout << "  Result count: " << stats.total_results << " records" << endl;
-            cout << "  Query time: " << fixed << setprecision(2) << stats.query_time_ms << " ms" << endl;
-            cout << "  Fetch time: " << stats.fetch_time_ms << " ms" << endl;
-            cout << "  Total time: " << total_time << " ms" << endl;
-            cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        vector<int> pixels = conePixels(center_ra, center_dec, radius_deg);
+        QueryStats stats = streamToFile(coneSQL(pixels, time_filter, limit), filename, head, keep,
+                                        coneFilter(center_ra, center_dec, radius_deg));
+        stats.healpix_pixels_searched = pixels.size();
+        return stats;
+    }
+    
+    // Streaming export of a polygon / MOC region
+    QueryStats streamRegionToFile(const tdlight::SkyRegion& region, const string& filename,
+                                  vector<QueryResult>& head, size_t keep,
+                                  const string& time_filter = "", int limit = -1) {
+        vector<int> pixels = region.pixels(*healpix_map);
+        QueryStats stats;
+        if (!pixels.empty()) {
+            stats = streamToFile(regionSQL(pixels, time_filter, limit), filename, head, keep,
+                                 regionFilter(region));
         }
-        
+        stats.healpix_pixels_searched = pixels.size();
         return stats;
     }
     
-    // Batch cone search (multi-center optimization)
-    map<int, QueryStats> batchConeSearch(const vector<tuple<double, double, double>>& queries,
-                                        map<int, vector<QueryResult>>& all_results,
-                                        bool verbose = true) {
-        map<int, QueryStats> stats_map;
-        
-        cout << "\n=== Batch Cone Search ===" << endl;
-        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
-        cout << "  Query count: " << queries.size() << endl;
+    // Streaming export of a time range query
+    QueryStats streamTimeRangeToFile(long long source_id, const string& time_condition,
+                                    const string& filename, vector<QueryResult>& head, size_t keep,
+                                    int limit = -1) {
+        return streamToFile(timeRangeSQL(source_id, time_condition, limit), filename, head, keep);
+    }
+    
+    void exportStatsToCSV(const vector<SourceBandStats>& rows, const string& filename) {
+        ofstream file(filename);
+        if (!file.is_open()) {
+            throw runtime_error("Cannot create output file: " + filename);
+        }
         
-        auto total_start = high_resolution_clock::now();
+        file << "table_name,source_id,ra,dec,band,count,mean_mag,stddev_mag,min_mag,max_mag,first_ts,last_ts,span_days\n";
+        for (const auto& b : rows) {
+            file << b.table_name << "," << b.source_id << ","
+                 << fixed << setprecision(8) << b.ra << "," << b.dec << ","
+                 << b.band << "," << b.count << ","
+                 << setprecision(6) << b.mean_mag << "," << b.stddev_mag << ","
+                 << b.min_mag << "," << b.max_mag << ","
+                 << b.first_ts << "," << b.last_ts << ","
+                 << setprecision(5) << (b.last_ts - b.first_ts) / 86400000.0 << "\n";
+        }
         
-        for (size_t i = 0; i < queries.size(); ++i) {
-            double ra = get<0>(queries[i]);
-            double dec = get<1>(queries[i]);
-            double radius = get<2>(queries[i]);
-            
-            vector<QueryResult> results;
-            QueryStats stats = coneSearch(ra, dec, radius, results, false);
-            
-            all_results[i] = move(results);
-            stats_map[i] = stats;
-            
-            if (verbose && (i + 1) % 10 == 0) {
-                cout << "  Progress: " << (i + 1) << "/" << queries.size() << endl;
-            }
+        file.close();
+        cout << "[OK] Statistics exported to: " << filename << " (" << rows.size() << " rows)" << endl;
+    }
+    
+    void displayStats(const vector<SourceBandStats>& rows, int max_display = 10) {
+        if (rows.empty()) {
+            cout << "  No results" << endl;
+            return;
         }
         
-        auto total_end = high_resolution_clock::now();
-        double total_time = duration<double, milli>(total_end - total_start).count();
+        int display_count = min(max_display, (int)rows.size());
         
-        // Statistics
-        int total_results = 0;
-        for (const auto& [idx, stats] : stats_map) {
-            total_results += stats.total_results;
+        cout << "\n[RESULTS] Per-source statistics (showing " << display_count << " of " 
+             << rows.size() << " source/band rows)" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        for (int i = 0; i < display_count; ++i) {
+            const auto& b = rows[i];
+            cout << "[" << (i + 1) << "] Source " << b.source_id
+                 << " | Band=" << b.band
+                 << " | N=" << b.count
+                 << " | Mag=" << fixed << setprecision(3) << b.mean_mag
+                 << " ± " << b.stddev_mag
+                 << " [" << b.min_mag << ", " << b.max_mag << "]"
+                 << " | Span=" << setprecision(1) << (b.last_ts - b.first_ts) / 86400000.0 << " d" << endl;
+        }
+        if ((int)rows.size() > display_count) {
+            cout << "  ... " << (rows.size() - display_count) << " more rows not shown" << endl;
+        }
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+    }
+    
+    void exportObjectsToCSV(const vector<ObjectResult>& objects, const string& filename) {
+        ofstream file(filename);
+        if (!file.is_open()) {
+            throw runtime_error("Cannot create output file: " + filename);
         }
         
-        cout << "\n[STATS] Batch Query Complete" << endl;
-        cout << "  Total queries: " << queries.size() << endl;
-        cout << "  Total results: " << total_results << endl;
-        cout << "  Total time: " << fixed << setprecision(2) << total_time << " ms" << endl;
-        cout << "  Avg time: " << (total_time / queries.size()) << " ms/query" << endl;
-        cout << "  Throughput: " << fixed << setprecision(1) 
-             << (queries.size() * 1000.0 / total_time) << " queries/s" << endl;
-        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+        file << "table_name,source_id,ra,dec,cls,healpix_id\n";
+        for (const auto& o : objects) {
+            file << o.table_name << "," << o.source_id << ","
+                 << fixed << setprecision(8) << o.ra << "," << o.dec << ","
+                 << o.cls << "," << o.healpix_id << "\n";
+        }
         
-        return stats_map;
+        file.close();
+        cout << "[OK] Objects exported to: " << filename << " (" << objects.size() << " sources)" << endl;
     }
     
-    // Export results to file (CSV format)
-    void exportToCSV(const vector<QueryResult>& results, const string& filename) {
+    void exportNeighboursToCSV(const vector<Neighbour>& neighbours, const string& filename) {
         ofstream file(filename);
         if (!file.is_open()) {
             throw runtime_error("Cannot create output file: " + filename);
         }
         
-        // Write header
-        file << "ts,source_id,ra,dec,band,cls,mag,mag_error,flux,flux_error,jd_tcb\n";
-        
-        // Write data
-        for (const auto& r : results) {
-            file << r.ts << "," << r.source_id << ","
-                 << fixed << setprecision(8) << r.ra << ","
-                 << r.dec << "," << r.band << "," << r.cls << ","
-                 << setprecision(6) << r.mag << "," << r.mag_error << ","
-                 << r.flux << "," << r.flux_error << ","
-                 << setprecision(10) << r.jd_tcb << "\n";
+        file << "rank,distance_arcsec,table_name,source_id,ra,dec,cls,healpix_id\n";
+        for (size_t i = 0; i < neighbours.size(); i++) {
+            const auto& o = neighbours[i].object;
+            file << (i + 1) << "," << fixed << setprecision(4) << neighbours[i].distance_deg * 3600.0 << ","
+                 << o.table_name << "," << o.source_id << ","
+                 << setprecision(8) << o.ra << "," << o.dec << ","
+                 << o.cls << "," << o.healpix_id << "\n";
         }
         
         file.close();
-        cout << "[OK] Results exported to: " << filename << " (" << results.size() << " records)" << endl;
+        cout << "[OK] Neighbours exported to: " << filename << " (" << neighbours.size() << " sources)" << endl;
+    }
+    
+    void displayNeighbours(const vector<Neighbour>& neighbours, int max_display = 10) {
+        if (neighbours.empty()) {
+            cout << "  No sources found" << endl;
+            return;
+        }
+        
+        int display_count = min(max_display, (int)neighbours.size());
+        
+        cout << "\n[RESULTS] Nearest sources (showing " << display_count << " of "
+             << neighbours.size() << ")" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        for (int i = 0; i < display_count; ++i) {
+            const auto& o = neighbours[i].object;
+            cout << "[" << (i + 1) << "] " << fixed << setprecision(3)
+                 << neighbours[i].distance_deg * 3600.0 << "\" | Source " << o.source_id
+                 << " | RA=" << setprecision(6) << o.ra
+                 << "° DEC=" << o.dec
+                 << "° | Class=" << (o.cls.empty() ? "UNKNOWN" : o.cls) << endl;
+        }
+        cout << "  Fetch observations with: --time --source_id <ID>" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
+    }
+    
+    void displayObjects(const vector<ObjectResult>& objects, int max_display = 10) {
+        if (objects.empty()) {
+            cout << "  No objects" << endl;
+            return;
+        }
+        
+        int display_count = min(max_display, (int)objects.size());
+        
+        cout << "\n[RESULTS] Objects in cone (showing " << display_count << " of " 
+             << objects.size() << " sources)" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
+        for (int i = 0; i < display_count; ++i) {
+            const auto& o = objects[i];
+            cout << "[" << (i + 1) << "] Source " << o.source_id
+                 << " | RA=" << fixed << setprecision(6) << o.ra
+                 << "° DEC=" << o.dec
+                 << "° | Class=" << (o.cls.empty() ? "UNKNOWN" : o.cls)
+                 << " | HEALPix=" << o.healpix_id << endl;
+        }
+        if ((int)objects.size() > display_count) {
+            cout << "  ... " << (objects.size() - display_count) << " more sources not shown" << endl;
+        }
+        cout << "  Fetch observations with: --time --source_id <ID>" << endl;
+        cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━\n" << endl;
     }
     
     // Display first N results
@@ -447,12 +2442,44 @@ void printUsage(const char* program) {
     cout << "Cone Search:" << endl;
     cout << "  " << program << " --cone --ra <deg> --dec <deg> --radius <deg> [options]" << endl;
     cout << endl;
+    cout << "Object Cone Search (tags only, one row per source):" << endl;
+    cout << "  " << program << " --objects --ra <deg> --dec <deg> --radius <deg> [options]" << endl;
+    cout << endl;
+    cout << "Nearest Sources (tags only, no radius needed):" << endl;
+    cout << "  " << program << " --knn <K> --ra <deg> --dec <deg> [--radius <max deg>] [options]" << endl;
+    cout << endl;
+    cout << "Region Search (polygon or MOC footprint):" << endl;
+    cout << "  " << program << " --polygon \"ra1,dec1,ra2,dec2,ra3,dec3,...\" [options]" << endl;
+    cout << "  " << program << " --moc <MOC_FITS_file> [options]" << endl;
+    cout << endl;
     cout << "Time Range Query:" << endl;
     cout << "  " << program << " --time --source_id <ID> --time_cond \"<condition>\" [options]" << endl;
+    cout << "  --prepared           Use a prepared statement; window from --ts_range <start_ms>,<end_ms>" << endl;
+    cout << "  --repeat <n>         With --prepared: time n lookups as ad-hoc SQL and as prepared" << endl;
+    cout << "  --max_points <n>     Downsample to at most n epochs per band for plotting" << endl;
+    cout << "  --downsample <m>     Downsampling method: lttb (default) or minmax" << endl;
+    cout << endl;
+    cout << "Per-source statistics (computed by TDengine, add to --cone, --polygon, --moc or --time):" << endl;
+    cout << "  --stats              Count, mean/stddev/min/max mag and time span per source and band" << endl;
     cout << endl;
     cout << "Batch Cone Search:" << endl;
     cout << "  " << program << " --batch --input <CSV_file> [options]" << endl;
     cout << "     CSV format: ra,dec,radius (one query per line)" << endl;
+    cout << "  --concurrency <list> Run the batch in parallel at each level, e.g. 1,4,16" << endl;
+    cout << "  --pool_size <n>      TDengine connection pool size (default: max concurrency;" << endl;
+    cout << "                       a smaller size caps the concurrency)" << endl;
+    cout << "  --coalesce           Merge the pixel ranges of all cones and read each row once" << endl;
+    cout << "  --async <list>       Benchmark sync vs. async pipelining at each in-flight depth, e.g. 1,8,32" << endl;
+    cout << endl;
+    cout << "Workload Benchmark (synthetic cones + time-range lookups, JSON report):" << endl;
+    cout << "  " << program << " --bench [--concurrency 1,4,16] [--output report.json] [options]" << endl;
+    cout << "  --queries <n>        Queries per concurrency level (default: 1000)" << endl;
+    cout << "  --radius_range <a,b> Cone radius range in deg, log-uniform (default: 0.01,0.2)" << endl;
+    cout << "  --time_share <f>     Fraction of time-range lookups (default: 0.2)" << endl;
+    cout << "  --time_filter_share <f> Fraction of cones with a time window (default: 0)" << endl;
+    cout << "  --window_days <d>    Length of generated time windows (default: 30)" << endl;
+    cout << "  --seed <n>           Random seed (default: 42)" << endl;
+    cout << "  --prepared           Run the time-range lookups through prepared statements" << endl;
     cout << endl;
     cout << "Common Options:" << endl;
     cout << "  --db <name>          Database name (default: test_db)" << endl;
@@ -462,21 +2489,35 @@ void printUsage(const char* program) {
     cout << "  --password <pass>    Password (default: taosdata)" << endl;
     cout << "  --table <name>       Super table name (default: sensor_data)" << endl;
     cout << "  --nside <value>      HEALPix NSIDE (default: 64)" << endl;
-    cout << "  --output <file>      Output CSV file" << endl;
+    cout << "  --output <file>      Output file: CSV, or FITS binary table if it ends in .fits" << endl;
+    cout << "                       (--batch: directory of CSV files, or name.fits -> name_N.fits)" << endl;
     cout << "  --limit <count>      Limit result count" << endl;
     cout << "  --display <count>    Display result count (default: 10)" << endl;
     cout << "  --quiet              Quiet mode (no verbose output)" << endl;
+    cout << "  --cache_mb <n>       Cache candidate rows per pixel set, n MB budget (default: 0 = off)" << endl;
     cout << endl;
     cout << "Examples:" << endl;
     cout << "  # Cone search: center(180 deg, 30 deg), radius 0.1 deg" << endl;
     cout << "  " << program << " --cone --ra 180 --dec 30 --radius 0.1 --output results.csv" << endl;
     cout << endl;
+    cout << "  # Polygon search (non-convex polygons are split into triangles)" << endl;
+    cout << "  " << program << " --polygon \"10,10,14,10,14,11,11,11,11,14,10,14\" --output region.fits" << endl;
+    cout << endl;
     cout << "  # Time query: source_id=12345, last 30 days" << endl;
     cout << "  " << program << " --time --source_id 12345 --time_cond \"ts >= NOW() - INTERVAL(30, DAY)\"" << endl;
     cout << endl;
     cout << "  # Batch query" << endl;
     cout << "  " << program << " --batch --input queries.csv --output batch_results/" << endl;
     cout << endl;
+    cout << "  # Parallel batch query, compare 1, 4 and 16 workers" << endl;
+    cout << "  " << program << " --batch --input queries.csv --concurrency 1,4,16" << endl;
+    cout << endl;
+    cout << "  # Synthetic workload at 1, 4 and 16 workers, JSON report" << endl;
+    cout << "  " << program << " --bench --queries 2000 --concurrency 1,4,16 --output bench.json" << endl;
+    cout << endl;
+    cout << "  # Async pipelining on one connection vs. the blocking path" << endl;
+    cout << "  " << program << " --batch --input queries.csv --async 1,8,32" << endl;
+    cout << endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -494,18 +2535,36 @@ int main(int argc, char* argv[]) {
         // Cone search parameters
         double ra = -999, dec = -999, radius = -1;
         
+        // Nearest-neighbour parameters
+        int knn_k = 0;
+        
+        // Region search parameters
+        string polygon_spec, moc_file;
+        
         // Time query parameters
         long long source_id = -1;
         string time_cond;
+        bool prepared = false;
+        int repeat = 1;
+        int64_t ts_start = 0, ts_end = INT64_MAX;
+        size_t max_points = 0;
+        tdlight::DownsampleMethod downsample = tdlight::DownsampleMethod::LTTB;
         
         // Batch query parameters
         string input_file;
+        vector<int> concurrency_levels;
+        int pool_size = 0;
+        bool coalesce = false;
+        vector<int> async_depths;
+        bool stats_only = false;
+        WorkloadSpec workload;
         
         // Output parameters
         string output_file;
         int limit = -1;
         int display = 10;
         bool verbose = true;
+        size_t cache_mb = 0;
         
         // Parse arguments
         if (argc < 2) {
@@ -521,14 +2580,62 @@ int main(int argc, char* argv[]) {
                 return 0;
             }
             else if (arg == "--cone") mode = "cone";
+            else if (arg == "--objects") mode = "objects";
+            else if (arg == "--knn" && i + 1 < argc) { mode = "knn"; knn_k = stoi(argv[++i]); }
+            else if (arg == "--stats") stats_only = true;
+            else if (arg == "--polygon" && i + 1 < argc) { mode = "region"; polygon_spec = argv[++i]; }
+            else if (arg == "--moc" && i + 1 < argc) { mode = "region"; moc_file = argv[++i]; }
             else if (arg == "--time") mode = "time";
             else if (arg == "--batch") mode = "batch";
+            else if (arg == "--bench") mode = "bench";
+            else if (arg == "--queries" && i + 1 < argc) workload.queries = stoi(argv[++i]);
+            else if (arg == "--radius_range" && i + 1 < argc) {
+                string range = argv[++i];
+                size_t comma = range.find(',');
+                workload.radius_min = stod(range.substr(0, comma));
+                workload.radius_max = comma == string::npos ? workload.radius_min : stod(range.substr(comma + 1));
+            }
+            else if (arg == "--time_share" && i + 1 < argc) workload.time_share = stod(argv[++i]);
+            else if (arg == "--time_filter_share" && i + 1 < argc) workload.time_filter_share = stod(argv[++i]);
+            else if (arg == "--window_days" && i + 1 < argc) workload.window_days = stod(argv[++i]);
+            else if (arg == "--seed" && i + 1 < argc) workload.seed = stoul(argv[++i]);
             else if (arg == "--ra" && i + 1 < argc) ra = stod(argv[++i]);
             else if (arg == "--dec" && i + 1 < argc) dec = stod(argv[++i]);
             else if (arg == "--radius" && i + 1 < argc) radius = stod(argv[++i]);
             else if (arg == "--source_id" && i + 1 < argc) source_id = stoll(argv[++i]);
             else if (arg == "--time_cond" && i + 1 < argc) time_cond = argv[++i];
+            else if (arg == "--prepared") { prepared = true; workload.prepared = true; }
+            else if (arg == "--repeat" && i + 1 < argc) repeat = max(1, stoi(argv[++i]));
+            else if (arg == "--ts_range" && i + 1 < argc) {
+                string range = argv[++i];
+                size_t comma = range.find(',');
+                if (comma == string::npos) throw invalid_argument("--ts_range expects <start_ms>,<end_ms>");
+                if (comma > 0) ts_start = stoll(range.substr(0, comma));
+                if (comma + 1 < range.size()) ts_end = stoll(range.substr(comma + 1));
+            }
+            else if (arg == "--max_points" && i + 1 < argc) max_points = max(4, stoi(argv[++i]));
+            else if (arg == "--downsample" && i + 1 < argc) {
+                if (!tdlight::parse_downsample_method(argv[++i], downsample)) {
+                    throw invalid_argument("--downsample expects lttb or minmax");
+                }
+            }
             else if (arg == "--input" && i + 1 < argc) input_file = argv[++i];
+            else if (arg == "--concurrency" && i + 1 < argc) {
+                istringstream levels(argv[++i]);
+                string level;
+                while (getline(levels, level, ',')) {
+                    if (!level.empty()) concurrency_levels.push_back(max(1, stoi(level)));
+                }
+            }
+            else if (arg == "--pool_size" && i + 1 < argc) pool_size = stoi(argv[++i]);
+            else if (arg == "--coalesce") coalesce = true;
+            else if (arg == "--async" && i + 1 < argc) {
+                istringstream depths(argv[++i]);
+                string depth;
+                while (getline(depths, depth, ',')) {
+                    if (!depth.empty()) async_depths.push_back(max(1, stoi(depth)));
+                }
+            }
             else if (arg == "--db" && i + 1 < argc) db_name = argv[++i];
             else if (arg == "--host" && i + 1 < argc) host = argv[++i];
             else if (arg == "--port" && i + 1 < argc) port = stoi(argv[++i]);
@@ -540,6 +2647,21 @@ int main(int argc, char* argv[]) {
             else if (arg == "--limit" && i + 1 < argc) limit = stoi(argv[++i]);
             else if (arg == "--display" && i + 1 < argc) display = stoi(argv[++i]);
             else if (arg == "--quiet") verbose = false;
+            else if (arg == "--cache_mb" && i + 1 < argc) cache_mb = stoul(argv[++i]);
+        }
+        
+        // Only observation rows have a FITS layout
+        if (isFitsPath(output_file) && (stats_only || mode == "objects" || mode == "knn")) {
+            cerr << "[ERROR] FITS output is only available for observation rows; "
+                    "use a .csv name with --stats, --objects or --knn" << endl;
+            return 1;
+        }
+        
+        // Async queries never go through the cache, so a cached sync
+        // baseline would not be comparable
+        if (!async_depths.empty() && cache_mb > 0) {
+            cerr << "[ERROR] --async cannot be combined with --cache_mb; the async path does not use the cache" << endl;
+            return 1;
         }
         
         // Create query engine
@@ -547,6 +2669,8 @@ int main(int argc, char* argv[]) {
         cout << "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << endl;
         
         OptimizedQueryEngine engine(host, user, password, db_name, table, nside, port);
+        engine.setCacheBudget(cache_mb);
+        if (pool_size > 0) engine.fixPoolSize(pool_size);
         
         // Execute query
         if (mode == "cone") {
@@ -556,15 +2680,81 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
             
-            vector<QueryResult> results;
-            engine.coneSearch(ra, dec, radius, results, verbose);
+            if (stats_only) {
+                // Per-source statistics computed by TDengine
+                vector<SourceBandStats> rows;
+                engine.coneStats(ra, dec, radius, rows, verbose, time_cond);
+                engine.displayStats(rows, display);
+                if (!output_file.empty()) {
+                    engine.exportStatsToCSV(rows, output_file);
+                }
+            } else if (!output_file.empty()) {
+                // Stream rows to the file as they are fetched
+                vector<QueryResult> head;
+                engine.streamConeToFile(ra, dec, radius, output_file, head, display, time_cond, limit);
+                engine.displayResults(head, display);
+            } else {
+                vector<QueryResult> results;
+                engine.coneSearch(ra, dec, radius, results, verbose, time_cond, limit);
+                
+                // Display results
+                engine.displayResults(results, display);
+            }
+        }
+        else if (mode == "knn") {
+            // k nearest sources
+            if (ra == -999 || dec == -999 || knn_k <= 0) {
+                cerr << "[ERROR] Nearest neighbour search requires --knn <K> (K > 0), --ra, --dec" << endl;
+                return 1;
+            }
             
-            // Display results
-            engine.displayResults(results, display);
+            vector<Neighbour> neighbours;
+            engine.knnSearch(ra, dec, knn_k, neighbours, verbose, radius > 0 ? radius : 180.0);
+            engine.displayNeighbours(neighbours, display);
+            
+            if (!output_file.empty()) {
+                engine.exportNeighboursToCSV(neighbours, output_file);
+            }
+        }
+        else if (mode == "region") {
+            // Polygon / MOC region search
+            unique_ptr<tdlight::SkyRegion> region;
+            if (!moc_file.empty()) {
+                region = make_unique<tdlight::MocRegion>(moc_file);
+            } else {
+                region = make_unique<tdlight::SkyPolygon>(tdlight::parse_vertex_list(polygon_spec));
+            }
+            
+            if (stats_only) {
+                vector<SourceBandStats> rows;
+                engine.regionStats(*region, rows, verbose, time_cond);
+                engine.displayStats(rows, display);
+                if (!output_file.empty()) {
+                    engine.exportStatsToCSV(rows, output_file);
+                }
+            } else if (!output_file.empty()) {
+                vector<QueryResult> head;
+                engine.streamRegionToFile(*region, output_file, head, display, time_cond, limit);
+                engine.displayResults(head, display);
+            } else {
+                vector<QueryResult> results;
+                engine.regionSearch(*region, results, verbose, time_cond, limit);
+                engine.displayResults(results, display);
+            }
+        }
+        else if (mode == "objects") {
+            // Object-level cone search
+            if (ra == -999 || dec == -999 || radius == -1) {
+                cerr << "[ERROR] Object search requires --ra, --dec, --radius parameters" << endl;
+                return 1;
+            }
+            
+            vector<ObjectResult> objects;
+            engine.objectConeSearch(ra, dec, radius, objects, verbose);
+            engine.displayObjects(objects, display);
             
-            // Export results
             if (!output_file.empty()) {
-                engine.exportToCSV(results, output_file);
+                engine.exportObjectsToCSV(objects, output_file);
             }
         }
         else if (mode == "time") {
@@ -574,17 +2764,58 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
             
-            vector<QueryResult> results;
-            engine.timeRangeQuery(source_id, time_cond, results, verbose, limit);
-            
-            // Display results
-            engine.displayResults(results, display);
-            
-            // Export results
-            if (!output_file.empty()) {
-                engine.exportToCSV(results, output_file);
+            if (prepared && stats_only) {
+                cerr << "[ERROR] --stats cannot be combined with --prepared; use --time_cond for the window" << endl;
+                return 1;
+            }
+            if (prepared) {
+                // Prepared statement: bind source_id and the window per call
+                if (!time_cond.empty()) {
+                    cerr << "[WARN] --time_cond is ignored with --prepared; use --ts_range" << endl;
+                }
+                vector<QueryResult> results;
+                if (repeat > 1) {
+                    engine.compareTimeRangePaths(source_id, ts_start, ts_end, repeat, results);
+                } else {
+                    engine.timeRangeQueryPrepared(source_id, ts_start, ts_end, results, verbose, limit);
+                }
+                engine.downsampleResults(results, max_points, downsample, verbose);
+                engine.displayResults(results, display);
+                if (!output_file.empty()) {
+                    engine.exportResults(results, output_file);
+                }
+            } else if (stats_only) {
+                // Per-band statistics computed by TDengine
+                vector<SourceBandStats> rows;
+                engine.sourceStats(source_id, time_cond, rows, verbose);
+                engine.displayStats(rows, display);
+                if (!output_file.empty()) {
+                    engine.exportStatsToCSV(rows, output_file);
+                }
+            } else if (!output_file.empty() && max_points == 0) {
+                // Stream rows to the file as they are fetched
+                vector<QueryResult> head;
+                engine.streamTimeRangeToFile(source_id, time_cond, output_file, head, display, limit);
+                engine.displayResults(head, display);
+            } else {
+                vector<QueryResult> results;
+                engine.timeRangeQuery(source_id, time_cond, results, verbose, limit);
+                engine.downsampleResults(results, max_points, downsample, verbose);
+                
+                // Display results
+                engine.displayResults(results, display);
+                if (!output_file.empty()) {
+                    engine.exportResults(results, output_file);
+                }
             }
         }
+        else if (mode == "bench") {
+            // Synthetic workload benchmark
+            vector<int> levels = concurrency_levels.empty() ? vector<int>{1} : concurrency_levels;
+            int max_level = *max_element(levels.begin(), levels.end());
+            if (pool_size <= 0) engine.setPoolSize(max_level);
+            engine.workloadBenchmark(workload, levels, output_file);
+        }
         else if (mode == "batch") {
             // Batch cone search
             if (input_file.empty()) {
@@ -624,22 +2855,40 @@ int main(int argc, char* argv[]) {
             
             // Execute batch query
             map<int, vector<QueryResult>> all_results;
-            engine.batchConeSearch(queries, all_results, verbose);
+            if (coalesce) {
+                int workers = concurrency_levels.empty() ? 1 :
+                    *max_element(concurrency_levels.begin(), concurrency_levels.end());
+                engine.coalescedBatchConeSearch(queries, all_results, verbose, workers);
+            } else if (!async_depths.empty()) {
+                engine.asyncBenchmark(queries, all_results, async_depths);
+            } else if (concurrency_levels.empty()) {
+                engine.batchConeSearch(queries, all_results, verbose);
+            } else {
+                int max_level = *max_element(concurrency_levels.begin(), concurrency_levels.end());
+                if (pool_size <= 0) engine.setPoolSize(max_level);
+                engine.concurrencySweep(queries, all_results, concurrency_levels);
+            }
             
             // Export results
+            // A FITS name gives one table per query (cones.fits -> cones_0.fits, ...),
+            // anything else is a directory of CSV files
             if (!output_file.empty()) {
+                bool fits = isFitsPath(output_file);
+                size_t dot = output_file.rfind('.');
                 for (const auto& [idx, results] : all_results) {
-                    string out = output_file + "/query_" + to_string(idx) + ".csv";
-                    engine.exportToCSV(results, out);
+                    string out = fits ? output_file.substr(0, dot) + "_" + to_string(idx) + output_file.substr(dot)
+                                      : output_file + "/query_" + to_string(idx) + ".csv";
+                    engine.exportResults(results, out);
                 }
             }
         }
         else {
-            cerr << "[ERROR] Query mode required: --cone, --time, or --batch" << endl;
+            cerr << "[ERROR] Query mode required: --cone, --objects, --knn, --polygon, --moc, --time, --batch, or --bench" << endl;
             printUsage(argv[0]);
             return 1;
         }
         
+        engine.printCacheStats();
         cout << "[OK] Query complete" << endl;
         
         return 0;
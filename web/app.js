@@ -6,6 +6,9 @@ let currentObjects = [];
 let selectedObjects = []; 
 let isClassificationRunning = false;
 let currentLightcurveData = null;
+let currentLightcurveTable = null;
+// Plots get at most this many epochs per band; the server reduces longer curves
+const LC_PLOT_POINTS = 2000;
 
 window.switchTab = function(tabName) {
     document.querySelectorAll('.nav-tab').forEach(el => el.classList.remove('active'));
@@ -416,12 +419,12 @@ window.viewObject = async function(sourceId) {
             console.warn('Refresh metadata failed', e);
         }
 
-        const response = await fetch(`/api/lightcurve/${obj.table_name}`);
-        const data = await response.json();
-        if (data.data && data.data.length > 0) {
-            currentLightcurveData = data.data; 
-            plotLightcurve(data);
-            updateMetadata(obj, data.data.length);
+        const lc = await fetchLightcurveColumns(obj.table_name);
+        if (lc && lc.length > 0) {
+            currentLightcurveData = lc; 
+            currentLightcurveTable = obj.table_name;
+            plotLightcurve(lc);
+            updateMetadata(obj, lc.total);
             document.getElementById('chartPlaceholder').style.display = 'none';
             document.getElementById('lightcurveChart').style.display = 'block';
             document.getElementById('objectInfo').textContent = 'Source ID: ' + sourceId;
@@ -677,6 +680,88 @@ function plotSkyMap(objects, coneRegion = null, regions = null) {
     }
 }
 
+// Source density behind the 3D sky map (/api/density, layout in sky_density.h)
+const SKY_DENSITY_ORDER = 5;
+let skyDensity = null;
+
+function decodeSkyDensity(buffer) {
+    const view = new DataView(buffer);
+    if (buffer.byteLength < 24 || view.getUint32(0, true) !== 0x44484454 || view.getUint16(4, true) !== 1) {
+        return null;  // not "TDHD" v1
+    }
+    const order = view.getUint16(6, true);
+    const npix = view.getUint32(8, true);
+    return { order, max: view.getUint32(12, true), counts: new Uint32Array(buffer, 24, npix) };
+}
+
+async function fetchSkyDensity() {
+    // Refetched at most once a minute so imports show up
+    if (skyDensity && Date.now() - skyDensity.fetchedAt < 60000) return skyDensity;
+    let response = await fetch(`/api/density?order=${SKY_DENSITY_ORDER}`);
+    // Tables coarser than SKY_DENSITY_ORDER: take the server's default order
+    if (response.status === 400) response = await fetch('/api/density');
+    if (!response.ok) return null;
+    const density = decodeSkyDensity(await response.arrayBuffer());
+    if (density) skyDensity = Object.assign(density, { fetchedAt: Date.now() });
+    return density;
+}
+
+// Center of a NESTED HEALPix pixel as { z: cos(colatitude), phi: RA in radians }
+function healpixNestCenter(order, pix) {
+    const nside = 1 << order, npface = nside * nside;
+    const face = Math.floor(pix / npface);
+    const ipf = pix % npface;
+    let ix = 0, iy = 0;
+    for (let b = 0; b < order; b++) {
+        ix |= ((ipf >> (2 * b)) & 1) << b;
+        iy |= ((ipf >> (2 * b + 1)) & 1) << b;
+    }
+    const jrll = [2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4];
+    const jpll = [1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7];
+    const jr = jrll[face] * nside - ix - iy - 1;
+    let nr, z;
+    if (jr < nside) {
+        nr = jr;
+        z = 1 - nr * nr / (3 * npface);
+    } else if (jr > 3 * nside) {
+        nr = 4 * nside - jr;
+        z = nr * nr / (3 * npface) - 1;
+    } else {
+        nr = nside;
+        z = (2 * nside - jr) * 2 / (3 * nside);
+    }
+    let tmp = jpll[face] * nr + ix - iy;
+    if (tmp < 0) tmp += 8 * nr;
+    return { z, phi: Math.PI / 4 * tmp / nr };
+}
+
+// Heat layer: one point per occupied pixel, darker where sources are denser
+async function addDensityLayer(scene) {
+    let density;
+    try {
+        density = await fetchSkyDensity();
+    } catch (error) {
+        console.error('Failed to load sky density:', error);
+    }
+    if (!density || density.max === 0) return;
+    
+    const positions = [], colors = [];
+    const low = new THREE.Color(0xdbeafe), high = new THREE.Color(0x1e3a8a), color = new THREE.Color();
+    const logMax = Math.log1p(density.max);
+    density.counts.forEach((count, pix) => {
+        if (count === 0) return;
+        const { z, phi } = healpixNestCenter(density.order, pix);
+        const s = Math.sqrt(Math.max(0, 1 - z * z));
+        positions.push(50.5 * s * Math.cos(phi), 50.5 * z, 50.5 * s * Math.sin(phi));
+        color.copy(low).lerp(high, Math.log1p(count) / logMax);
+        colors.push(color.r, color.g, color.b);
+    });
+    const geometry = new THREE.BufferGeometry();
+    geometry.setAttribute('position', new THREE.Float32BufferAttribute(positions, 3));
+    geometry.setAttribute('color', new THREE.Float32BufferAttribute(colors, 3));
+    scene.add(new THREE.Points(geometry, new THREE.PointsMaterial({ size: 1.2, vertexColors: true })));
+}
+
 function plotSkyMap3D(objects, coneRegion) {
     const container = document.getElementById('skyMapContainer');
     if (!container) return;
@@ -722,6 +807,7 @@ function plotSkyMap3D(objects, coneRegion) {
     const sphereGeom = new THREE.SphereGeometry(50, 32, 32);
     const sphereMat = new THREE.MeshBasicMaterial({ color: 0xd1d5db, wireframe: true });
     scene.add(new THREE.Mesh(sphereGeom, sphereMat));
+    addDensityLayer(scene);
     
     const equatorPoints = [];
     for (let i = 0; i <= 64; i++) {
@@ -972,10 +1058,9 @@ async function loadLightcurveForObject(tableName) {
         return;
     }
     try {
-        const response = await fetch(`/api/lightcurve/${tableName}`);
-        const data = await response.json();
-        if (data.data && data.data.length > 0) {
-            plotLightcurve(data);
+        const lc = await fetchLightcurveColumns(tableName);
+        if (lc && lc.length > 0) {
+            plotLightcurve(lc);
             document.getElementById('chartPlaceholder').style.display = 'none';
             document.getElementById('lightcurveChart').style.display = 'block';
         } else {
@@ -986,7 +1071,48 @@ async function loadLightcurveForObject(tableName) {
     }
 }
 
-function plotLightcurve(data) {
+// Decode an /api/lightcurve_bin response (layout in web_api.cpp, lightcurve_to_binary)
+function decodeLightcurveColumns(buffer) {
+    const view = new DataView(buffer);
+    if (buffer.byteLength < 20 || view.getUint32(0, true) !== 0x434C4454 || view.getUint16(4, true) !== 1) {
+        return null;  // not "TDLC" v1
+    }
+    const flags = view.getUint16(6, true);
+    const n = view.getUint32(8, true);
+    const total = view.getUint32(12, true);
+    const bandCount = view.getUint16(16, true);
+    let offset = view.getUint16(18, true);
+    
+    const bytes = new Uint8Array(buffer);
+    const decoder = new TextDecoder();
+    const bands = [];
+    let pos = 20;
+    for (let b = 0; b < bandCount; b++) {
+        const len = bytes[pos];
+        bands.push(decoder.decode(bytes.subarray(pos + 1, pos + 1 + len)));
+        pos += 1 + len;
+    }
+    
+    const ts = new Float64Array(buffer, offset, n);
+    offset += 8 * n;
+    const f32 = () => {
+        const column = new Float32Array(buffer, offset, n);
+        offset += 4 * n;
+        return column;
+    };
+    const mag = f32(), mag_err = f32(), flux = f32(), flux_err = f32();
+    const band = new Uint8Array(buffer, offset, n);
+    return { length: n, total, downsampled: (flags & 1) !== 0, bands, ts, mag, mag_err, flux, flux_err, band };
+}
+
+// Plot-resolution light curve as typed arrays, or null
+async function fetchLightcurveColumns(tableName) {
+    const response = await fetch(`/api/lightcurve_bin/${tableName}?max_points=${LC_PLOT_POINTS}`);
+    if (!response.ok) return null;
+    return decodeLightcurveColumns(await response.arrayBuffer());
+}
+
+function plotLightcurve(lc) {
     const placeholder = document.getElementById('chartPlaceholder');
     if (placeholder) placeholder.style.display = 'none';
     
@@ -1011,19 +1137,19 @@ function plotLightcurve(data) {
     
     // 按波段分组数据
     const bandGroups = {};
-    data.data.forEach(d => {
-        const band = d.band || 'Unknown';
+    for (let i = 0; i < lc.length; i++) {
+        const band = lc.bands[lc.band[i]] || 'Unknown';
         if (!bandGroups[band]) {
             bandGroups[band] = [];
         }
         bandGroups[band].push({
-            x: new Date(d.ts).getTime(),
-            y: d.mag,
-            mag_err: d.mag_err,
-            flux: d.flux,
-            flux_err: d.flux_err
+            x: lc.ts[i],
+            y: lc.mag[i],
+            mag_err: lc.mag_err[i],
+            flux: lc.flux[i],
+            flux_err: lc.flux_err[i]
         });
-    });
+    }
     
     // 为每个波段创建 dataset
     const datasets = Object.keys(bandGroups).map(band => {
@@ -1110,24 +1236,39 @@ window.downloadObjectList = function() {
     document.body.removeChild(link);
 };
 
-window.downloadLightcurve = function() {
+window.downloadLightcurve = async function() {
     if (!currentLightcurveData || currentLightcurveData.length === 0) {
         showToast(tMsg('msg_no_lc_data_download'), 'error');
         return;
     }
     
+    // The plot holds at most LC_PLOT_POINTS float32 epochs per band; export
+    // every epoch at full precision
+    let rows = null;
+    if (currentLightcurveTable) {
+        try {
+            const response = await fetch(`/api/lightcurve/${currentLightcurveTable}`);
+            const data = await response.json();
+            if (data.data && data.data.length > 0) {
+                rows = data.data.map(p => [p.ts, p.mag, p.mag_err, p.flux, p.flux_err]);
+            }
+        } catch (e) {
+            console.warn('Full lightcurve fetch failed, exporting plotted points', e);
+        }
+    }
+    if (!rows) {
+        const lc = currentLightcurveData;
+        rows = [];
+        for (let i = 0; i < lc.length; i++) {
+            rows.push([new Date(lc.ts[i]).toISOString().slice(0, 19), lc.mag[i], lc.mag_err[i], lc.flux[i], lc.flux_err[i]]);
+        }
+    }
+    
     let csvContent = "data:text/csv;charset=utf-8,";
     csvContent += "timestamp,mag,mag_err,flux,flux_err\n";
     
-    currentLightcurveData.forEach(point => {
-        const row = [
-            point.ts,
-            point.mag,
-            point.mag_err,
-            point.flux,
-            point.flux_err
-        ].join(",");
-        csvContent += row + "\n";
+    rows.forEach(row => {
+        csvContent += row.join(",") + "\n";
     });
     
     const encodedUri = encodeURI(csvContent);
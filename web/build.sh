@@ -57,7 +57,7 @@ echo "Compiling web_api..."
 g++ -o web_api web_api.cpp \
     -I"$INCLUDE_PATH" \
     -L"$LIB_PATH" \
-    -ltaos -lhealpix_cxx -lsharp -lcfitsio -lpthread -std=c++11 \
+    -ltaos -lhealpix_cxx -lsharp -lcfitsio -lpthread -lz -std=c++17 \
     -Wl,-rpath,'$ORIGIN/../libs'
 
 echo "Build successful: web_api"
@@ -21,6 +21,8 @@
 #include <arpa/inet.h>
 #include <fstream>
 #include <mutex>
+#include <shared_mutex>
+#include <memory>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <fcntl.h>
@@ -28,6 +30,20 @@
 // TDlight modular headers (shared utilities)
 #include <tdlight/sanitize.h>
 #include <tdlight/http_utils.h>
+#include <tdlight/taos_pool.h>
+#include <tdlight/result_reader.h>
+#include <tdlight/query_cache.h>
+#include <tdlight/knn.h>
+#include <tdlight/downsample.h>
+#include <tdlight/http_server.h>
+#include <tdlight/buffered_writer.h>
+#include <tdlight/chunked_response.h>
+#include <tdlight/http_compress.h>
+#include <tdlight/static_files.h>
+#include <tdlight/progress_hub.h>
+#include <tdlight/object_catalog.h>
+#include <tdlight/sky_region.h>
+#include <tdlight/sky_density.h>
 
 using namespace std;
 using namespace tdlight;  // Import sanitize/http helpers
@@ -43,6 +59,11 @@ struct Config {
     
     int web_port = 5001;
     string web_host = "0.0.0.0";
+    int web_workers = 0;              // 0 = hardware threads
+    int web_max_connections = 1024;
+    int web_max_inflight = 256;
+    int db_connections = 0;           // 0 = one per worker
+    int lightcurve_cache_mb = 256;
     
     string model_dir = "../models/hierarchical_unlimited";
     double confidence_threshold = 0.95;
@@ -138,6 +159,12 @@ bool load_config() {
     config.db_name = json_get_string(json, "name");
     if (config.db_name.empty()) config.db_name = "gaiadr2_lc";
     
+    config.web_workers = json_get_int(json, "workers", 0);
+    config.web_max_connections = json_get_int(json, "max_connections", 1024);
+    config.web_max_inflight = json_get_int(json, "max_inflight", 256);
+    config.db_connections = json_get_int(json, "db_connections", 0);
+    config.lightcurve_cache_mb = json_get_int(json, "lightcurve_cache_mb", 256);
+    
     string md = json_get_string(json, "model_dir");
     if (!md.empty()) config.model_dir = md;
     config.confidence_threshold = json_get_double(json, "confidence_threshold", 0.95);
@@ -186,7 +213,12 @@ bool save_config() {
     file << "    },\n";
     file << "    \"web\": {\n";
     file << "        \"port\": " << config.web_port << ",\n";
-    file << "        \"host\": \"" << config.web_host << "\"\n";
+    file << "        \"host\": \"" << config.web_host << "\",\n";
+    file << "        \"workers\": " << config.web_workers << ",\n";
+    file << "        \"max_connections\": " << config.web_max_connections << ",\n";
+    file << "        \"max_inflight\": " << config.web_max_inflight << ",\n";
+    file << "        \"db_connections\": " << config.db_connections << ",\n";
+    file << "        \"lightcurve_cache_mb\": " << config.lightcurve_cache_mb << "\n";
     file << "    },\n";
     file << "    \"classification\": {\n";
     file << "        \"model_dir\": \"" << config.model_dir << "\",\n";
@@ -285,8 +317,11 @@ struct ObjectInfo {
     string band;
 };
 
+// Receives search results one at a time, in output order
+using ObjectVisitor = function<void(const ObjectInfo&)>;
+
 struct LightcurvePoint {
-    string timestamp;
+    int64_t ts_ms = 0;
     double mag;
     double mag_error;
     double flux;
@@ -294,8 +329,38 @@ struct LightcurvePoint {
     string band;
 };
 
-TAOS* conn = nullptr;
-std::mutex db_mutex;
+// TDengine connections for request handlers. Each request leases one
+// pooled connection on its first db() call and returns it when
+// handle_request finishes.
+unique_ptr<ConnectionPool> db_pool;
+size_t db_pool_size = 4;
+thread_local ConnectionPool::Lease request_lease;
+thread_local bool request_lease_failed = false;
+
+// Connection of the request running on this thread. Requests that never
+// call it (static files, config, CORS) work without the database; nullptr
+// if the pool cannot connect, so the query reports the error.
+TAOS* db() {
+    if (!request_lease && !request_lease_failed) {
+        request_lease = db_pool->checkout();
+        if (!request_lease) {
+            request_lease_failed = true;
+            cerr << "[ERROR] No database connection available" << endl;
+        }
+    }
+    return request_lease.get();
+}
+
+// Held shared by every request; exclusively by requests that change the
+// database settings, so they never race a request that is using them
+std::shared_mutex config_mutex;
+
+// Cone search candidates per database + normalized pixel set
+QueryCache<vector<ObjectInfo>> cone_cache(64 << 20);
+
+// Serialized /api/lightcurve responses per database, table, band, time
+// window and downsampling; sized from config in main()
+unique_ptr<ShardedQueryCache<string>> lightcurve_cache;
 int server_socket = -1;
 
 vector<string> split(const string& s, char delimiter) {
@@ -379,34 +444,39 @@ string csv_to_json(const string& filename) {
     return json.str();
 }
 
+// (Re)point the connection pool at the configured database, falling back
+// to a connection without a default database if that one is unavailable
 bool connect_to_database() {
-    if (conn != nullptr) {
-        taos_close(conn);
-        conn = nullptr;
-    }
+    ConnectionParams params;
+    params.host = config.db_host;
+    params.user = config.db_user;
+    params.password = config.db_password;
+    params.database = config.db_name;
+    params.port = config.db_port;
     
-    // Try connecting to configured database
-    if (!config.db_name.empty()) {
-        conn = taos_connect(config.db_host.c_str(), config.db_user.c_str(), 
-                            config.db_password.c_str(), config.db_name.c_str(), config.db_port);
-    }
+    if (!db_pool) db_pool = make_unique<ConnectionPool>(params, db_pool_size);
+    else db_pool->reconfigure(params);
+    
+    // Open one connection now so a bad host or database is reported here
+    ConnectionPool::Lease probe = db_pool->checkout();
     
-    if (conn == nullptr) {
+    if (!probe) {
         if (!config.db_name.empty()) {
-            cerr << "[WARN] Failed to connect to database '" << config.db_name << "': " << taos_errstr(conn) << endl;
+            cerr << "[WARN] Failed to connect to database '" << config.db_name << "': " << taos_errstr(nullptr) << endl;
         }
         
         // Try connecting without specifying database
-        conn = taos_connect(config.db_host.c_str(), config.db_user.c_str(), 
-                            config.db_password.c_str(), NULL, config.db_port);
+        params.database.clear();
+        db_pool->reconfigure(params);
+        probe = db_pool->checkout();
         
-        if (conn == nullptr) {
-            cerr << "[ERROR] TDengine connect failed: " << taos_errstr(conn) << endl;
+        if (!probe) {
+            cerr << "[ERROR] TDengine connect failed: " << taos_errstr(nullptr) << endl;
             return false;
         }
         cout << "[INFO] Connected to TDengine (system/no specific database)" << endl;
     } else {
-        cout << "[INFO] Connected to TDengine (" << config.db_name << ")" << endl;
+        cout << "[INFO] Connected to TDengine (" << config.db_name << ", pool of " << db_pool_size << ")" << endl;
     }
     return true;
 }
@@ -421,25 +491,22 @@ vector<string> get_databases() {
     }
     
     const char* query = "SHOW DATABASES";
-    TAOS_RES* res = taos_query(temp_conn, query);
-    if (res == nullptr) {
-        cerr << "[ERROR] Failed to query databases" << endl;
-        taos_close(temp_conn);
-        return databases;
-    }
-    
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        if (row[0] != nullptr) {
-            int* lengths = taos_fetch_lengths(res);
-            if (lengths != nullptr && lengths[0] > 0) {
-                string db_name(static_cast<char*>(row[0]), lengths[0]);
-                databases.push_back(db_name);
+    {
+        ResultReader reader(taos_query(temp_conn, query));
+        if (!reader.ok()) {
+            cerr << "[ERROR] Failed to query databases: " << reader.error() << endl;
+            taos_close(temp_conn);
+            return databases;
+        }
+        
+        while (int n = reader.next_block()) {
+            for (int r = 0; r < n; r++) {
+                string_view db_name = reader.str(0, r);
+                if (!db_name.empty()) databases.emplace_back(db_name);
             }
         }
     }
     
-    taos_free_result(res);
     taos_close(temp_conn);
     return databases;
 }
@@ -491,75 +558,300 @@ string toLower(const string& str) {
     return result;
 }
 
-vector<ObjectInfo> get_objects(int limit = 200) {
-    vector<ObjectInfo> objects;
+// Decode one "healpix_id, source_id, ra, dec, data_count, cls, band" row
+// of the current block (the GROUP BY healpix_id, source_id object queries)
+ObjectInfo read_object_row(ResultReader& reader, int r,
+                           const char* default_cls, const char* default_band) {
+    ObjectInfo obj;
+    obj.healpix_id = reader.is_null(0, r) ? 0 : reader.get_int64(0, r);
+    obj.source_id = reader.is_null(1, r) ? 0 : reader.get_int64(1, r);
+    obj.ra = reader.is_null(2, r) ? 0.0 : reader.get_double(2, r);
+    obj.dec = reader.is_null(3, r) ? 0.0 : reader.get_double(3, r);
+    obj.data_count = reader.is_null(4, r) ? 0 : (int)reader.get_int64(4, r);
+    
+    string_view cls = reader.str(5, r);
+    obj.object_class = cls.empty() ? string(default_cls) : string(cls);
+    string_view band = reader.str(6, r);
+    obj.band = band.empty() ? string(default_band) : string(band);
+    
+    obj.table_name = "sensor_data_" + to_string(obj.healpix_id) + "_" + to_string(obj.source_id);
+    return obj;
+}
+
+// ==================== In-memory object catalog ====================
+// Per-source tags and counts of the current database. A new catalog is
+// loaded in the background whenever the import generation changes
+// (imports, classifications, drops) and swapped in; until then requests
+// are answered from the previous one, or by SQL if there is none yet.
+
+std::mutex catalog_mutex;
+shared_ptr<const ObjectCatalog> catalog_snapshot;
+shared_ptr<const SkyDensity> density_snapshot;      // source counts of catalog_snapshot
+shared_ptr<const SkyDensity> tag_density;           // counted from tags while there is no catalog
+string tag_density_key;               // "db|generation|order" of tag_density
+bool catalog_loading = false;
+string catalog_failed_key;            // "db|generation" of the last failed load
+time_t catalog_failed_at = 0;
+
+shared_ptr<const ObjectCatalog> load_catalog(TAOS* db, const string& database, uint64_t generation) {
+    auto start = chrono::steady_clock::now();
+    string table = is_valid_sql_identifier(database) ? database + ".sensor_data" : "sensor_data";
+    string query = "SELECT healpix_id, source_id, FIRST(ra) as ra, FIRST(dec) as dec, COUNT(*) as data_count, "
+                   "FIRST(cls) as cls, FIRST(band) as band FROM " + table + " GROUP BY healpix_id, source_id";
+    
+    ResultReader reader(taos_query(db, query.c_str()));
+    if (!reader.ok()) {
+        cerr << "[WARN] Object catalog load failed: " << reader.error() << endl;
+        return nullptr;
+    }
+    
+    auto catalog = make_shared<ObjectCatalog>(database, generation);
+    while (int n = reader.next_block()) {
+        for (int r = 0; r < n; r++) {
+            catalog->add(reader.is_null(0, r) ? 0 : reader.get_int64(0, r),
+                         reader.is_null(1, r) ? 0 : reader.get_int64(1, r),
+                         reader.is_null(2, r) ? 0.0 : reader.get_double(2, r),
+                         reader.is_null(3, r) ? 0.0 : reader.get_double(3, r),
+                         reader.is_null(4, r) ? 0 : reader.get_int64(4, r),
+                         reader.str(5, r), reader.str(6, r));
+        }
+    }
+    if (!reader.ok()) {
+        cerr << "[WARN] Object catalog fetch failed: " << reader.error() << endl;
+        return nullptr;
+    }
+    catalog->finish();
+    
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "[INFO] Object catalog: " << catalog->size() << " sources of " << database
+         << " (" << catalog->memory_bytes() / 1024 << " KB) loaded in " << (long)ms << " ms" << endl;
+    return catalog;
+}
+
+// HEALPix order of the tables' pixels (config "nside", 64 = order 6)
+int table_order() {
+    int order = 0;
+    while (order < 29 && (1 << (order + 1)) <= config.healpix_nside) order++;
+    return order;
+}
+
+// Density maps stop at order 8 (786,432 pixels, 3 MB per map); finer
+// table pixels are counted in their order-8 parent
+const int kMaxDensityOrder = 8;
+
+// Finest density map for tables of @p order
+int density_order(int order) { return min(order, kMaxDensityOrder); }
+
+// Add a source at NESTED @p pixel of the tables' @p order to counts at
+// density_order(order)
+void count_source(vector<uint32_t>& counts, int order, int64_t pixel) {
+    int coarse = density_order(order);
+    SkyDensity::count(counts, coarse, pixel < 0 ? pixel : pixel >> (2 * (order - coarse)));
+}
+
+// Sources per pixel at every order up to the table's @p order
+shared_ptr<const SkyDensity> catalog_density(const ObjectCatalog& catalog, int order) {
+    vector<uint32_t> counts;
+    for (const CatalogObject& o : catalog.objects()) count_source(counts, order, o.healpix_id);
+    return make_shared<const SkyDensity>(move(counts), density_order(order));
+}
+
+void refresh_catalog_async(const string& database, uint64_t generation) {
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        string key = database + "|" + to_string(generation);
+        if (catalog_loading || (key == catalog_failed_key && time(nullptr) - catalog_failed_at < 30)) return;
+        catalog_loading = true;
+    }
+    int order = table_order();
+    thread([database, generation, order] {
+        shared_ptr<const ObjectCatalog> fresh;
+        {
+            ConnectionPool::Lease lease = db_pool->checkout();
+            if (lease) fresh = load_catalog(lease.get(), database, generation);
+        }
+        shared_ptr<const SkyDensity> density;
+        if (fresh) density = catalog_density(*fresh, order);
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        if (fresh) {
+            catalog_snapshot = fresh;
+            density_snapshot = density;
+        } else {
+            catalog_failed_key = database + "|" + to_string(generation);
+            catalog_failed_at = time(nullptr);
+        }
+        catalog_loading = false;
+    }).detach();
+}
+
+// Catalog of the current database, possibly one import behind while a newer
+// one loads; nullptr means the caller has to query TDengine
+shared_ptr<const ObjectCatalog> current_catalog() {
+    const string& database = config.db_name;
+    uint64_t generation = import_generation(database);
+    shared_ptr<const ObjectCatalog> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        snapshot = catalog_snapshot;
+    }
+    if (!snapshot || snapshot->database() != database || snapshot->generation() != generation) {
+        refresh_catalog_async(database, generation);
+    }
+    return snapshot && snapshot->database() == database ? snapshot : nullptr;
+}
+
+// Density map of the current catalog; without one, counted from the
+// healpix_id tags of the child tables (one row per source) and kept until
+// the next import
+shared_ptr<const SkyDensity> current_density() {
+    if (current_catalog()) {
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        return density_snapshot;
+    }
+    
+    int order = table_order();
+    string key = config.db_name + "|" + to_string(import_generation(config.db_name)) + "|" + to_string(order);
+    {
+        std::lock_guard<std::mutex> lock(catalog_mutex);
+        if (tag_density && tag_density_key == key) return tag_density;
+    }
+    ResultReader reader(taos_query(db(), "SELECT TAGS healpix_id FROM sensor_data"));
+    if (!reader.ok()) {
+        cerr << "[ERROR] Density query failed: " << reader.error() << endl;
+        return nullptr;
+    }
+    vector<uint32_t> counts;
+    while (int n = reader.next_block()) {
+        for (int r = 0; r < n; r++) {
+            if (!reader.is_null(0, r)) count_source(counts, order, reader.get_int64(0, r));
+        }
+    }
+    if (!reader.ok()) return nullptr;
+    auto density = make_shared<const SkyDensity>(move(counts), density_order(order));
+    std::lock_guard<std::mutex> lock(catalog_mutex);
+    tag_density = density;
+    tag_density_key = key;
+    return density;
+}
+
+ObjectInfo catalog_object_info(const ObjectCatalog& catalog, const CatalogObject& o,
+                               const char* default_cls = "UNKNOWN", const char* default_band = "Unknown") {
+    ObjectInfo obj;
+    obj.healpix_id = o.healpix_id;
+    obj.source_id = o.source_id;
+    obj.ra = o.ra;
+    obj.dec = o.dec;
+    obj.data_count = (int)o.count;
+    obj.object_class = o.cls ? catalog.label(o.cls) : string(default_cls);
+    obj.band = o.band ? catalog.label(o.band) : string(default_band);
+    obj.table_name = "sensor_data_" + to_string(obj.healpix_id) + "_" + to_string(obj.source_id);
+    return obj;
+}
+
+// Searches return false if TDengine failed, possibly after some rows
+bool get_objects(int limit, const ObjectVisitor& visit) {
+    // Evenly strided over the pixel order, so the sample covers the whole sky
+    if (auto catalog = current_catalog()) {
+        size_t total = catalog->size();
+        size_t count = min(total, (size_t)max(0, limit));
+        for (size_t i = 0; i < count; i++) {
+            ObjectInfo obj = catalog_object_info(*catalog, catalog->objects()[i * total / count], "unknown", "g");
+            obj.band = toLower(obj.band);
+            visit(obj);
+        }
+        return true;
+    }
     
     string query = "SELECT healpix_id, source_id, FIRST(ra) as ra, FIRST(dec) as dec, COUNT(*) as data_count, "
                    "FIRST(cls) as cls, FIRST(band) as band FROM sensor_data "
                    "GROUP BY healpix_id, source_id LIMIT " + to_string(limit);
     
     cerr << "[DEBUG] Executing: " << query << endl;
-    TAOS_RES* res = taos_query(conn, query.c_str());
-    if (res == nullptr) {
-        cerr << "[ERROR] Query failed: " << taos_errstr(NULL) << endl;
-        return objects;
+    ResultReader reader(taos_query(db(), query.c_str()));
+    if (!reader.ok()) {
+        cerr << "[ERROR] Query error: " << reader.error() << endl;
+        return false;
     }
     
-    int error_code = taos_errno(res);
-    if (error_code != 0) {
-        cerr << "[ERROR] Query error: " << taos_errstr(res) << endl;
-        taos_free_result(res);
-        return objects;
+    while (int n = reader.next_block()) {
+        for (int r = 0; r < n; r++) {
+            ObjectInfo obj = read_object_row(reader, r, "unknown", "g");
+            obj.band = toLower(obj.band);
+            visit(obj);
+        }
     }
-    
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        ObjectInfo obj;
-        
-        if (row[0]) obj.healpix_id = *(long long*)row[0];
-        else obj.healpix_id = 0;
-        
-        if (row[1]) obj.source_id = *(long long*)row[1];
-        else obj.source_id = 0;
-        
-        if (row[2]) obj.ra = *(double*)row[2];
-        else obj.ra = 0.0;
-        
-        if (row[3]) obj.dec = *(double*)row[3];
-        else obj.dec = 0.0;
-        
-        if (row[4]) obj.data_count = *(int*)row[4];
-        else obj.data_count = 0;
-        
-        int* lengths = taos_fetch_lengths(res);
-        if (lengths != nullptr) {
-            if (row[5] != nullptr && lengths[5] > 0) {
-                obj.object_class = string((char*)row[5], lengths[5]);
-            } else {
-                obj.object_class = "unknown";
-            }
+    if (!reader.ok()) {
+        cerr << "[ERROR] Object fetch failed: " << reader.error() << endl;
+        return false;
+    }
+    return true;
+}
+
+// Rows of "SELECT ts, mag, mag_error, flux, flux_error, band ..." (extra columns ignored)
+void read_lightcurve_rows(ResultReader& reader, vector<LightcurvePoint>& points) {
+    bool has_ts = reader.num_fields() > 0 && reader.field_type(0) == TSDB_DATA_TYPE_TIMESTAMP;
+    while (int n = reader.next_block()) {
+        auto mag = reader.column<double>(1);
+        auto mag_error = reader.column<double>(2);
+        auto flux = reader.column<double>(3);
+        auto flux_error = reader.column<double>(4);
+        points.reserve(points.size() + n);
+        
+        for (int r = 0; r < n; r++) {
+            LightcurvePoint point;
             
-            if (row[6] != nullptr && lengths[6] > 0) {
-                obj.band = toLower(string((char*)row[6], lengths[6]));
-            } else {
-                obj.band = "g";
-            }
+            if (has_ts) point.ts_ms = reader.column<int64_t>(0)[r];
+            
+            point.mag = mag[r];
+            point.mag_error = mag_error[r];
+            point.flux = flux[r];
+            point.flux_error = flux_error[r];
+            
+            // 获取 band 字段
+            string_view band = reader.str(5, r);
+            point.band = band.empty() ? "G" : string(band);  // 默认波段
+            
+            points.push_back(std::move(point));
         }
-        
-        obj.table_name = "sensor_data_" + to_string(obj.healpix_id) + "_" + to_string(obj.source_id);
-        objects.push_back(obj);
     }
-    
-    taos_free_result(res);
-    return objects;
 }
 
-vector<LightcurvePoint> get_lightcurve(const string& table_name, const string& time_start = "", const string& time_end = "") {
-    vector<LightcurvePoint> points;
-    
-    string query = "SELECT ts, mag, mag_error, flux, flux_error, band FROM " + table_name;
+// Brightest/faintest epoch per band and time bucket, computed by TDengine
+// (INTERVAL windows, one selector per query) so only ~max_points rows are
+// transferred. Returns false if the server rejects the query.
+bool get_lightcurve_minmax(const string& table_name, const string& where, int64_t span_ms,
+                           size_t max_points, vector<LightcurvePoint>& points) {
+    int64_t buckets = max<int64_t>(1, (int64_t)(max_points - 2) / 2);
+    int64_t width_ms = max<int64_t>(1, span_ms / buckets + 1);
+    
+    vector<LightcurvePoint> picked;
+    for (const char* selector : {"MIN", "MAX"}) {
+        string query = "SELECT ts, mag, mag_error, flux, flux_error, band, " + string(selector) + "(mag) FROM " +
+                       table_name + where + " PARTITION BY band INTERVAL(" + to_string(width_ms) + "a)";
+        ResultReader reader(taos_query(db(), query.c_str()));
+        if (!reader.ok()) {
+            cerr << "[WARN] INTERVAL downsampling failed, reducing client-side: " << reader.error() << endl;
+            return false;
+        }
+        read_lightcurve_rows(reader, picked);
+    }
     
+    sort(picked.begin(), picked.end(), [](const LightcurvePoint& a, const LightcurvePoint& b) {
+        return a.ts_ms != b.ts_ms ? a.ts_ms < b.ts_ms : a.band < b.band;
+    });
+    for (auto& point : picked) {
+        if (!points.empty() && points.back().ts_ms == point.ts_ms && points.back().band == point.band) continue;
+        points.push_back(std::move(point));
+    }
+    return true;
+}
+
+// " WHERE ..." selecting one band and/or time window ("" for all rows)
+string lightcurve_where(const string& band, const string& time_start, const string& time_end) {
     vector<string> conditions;
+    if (!band.empty()) {
+        conditions.push_back("band = '" + band + "'");
+    }
     if (!time_start.empty()) {
         conditions.push_back("ts >= '" + time_start + "'");
     }
@@ -567,66 +859,133 @@ vector<LightcurvePoint> get_lightcurve(const string& table_name, const string& t
         conditions.push_back("ts <= '" + time_end + "'");
     }
     
+    string where;
     if (!conditions.empty()) {
-        query += " WHERE " + conditions[0];
+        where = " WHERE " + conditions[0];
         for (size_t i = 1; i < conditions.size(); i++) {
-            query += " AND " + conditions[i];
+            where += " AND " + conditions[i];
+        }
+    }
+    return where;
+}
+
+// max_points > 0 reduces each band to at most max_points epochs;
+// total_points receives the number of epochs before reduction.
+vector<LightcurvePoint> get_lightcurve(const string& table_name, const string& time_start = "", const string& time_end = "",
+                                       const string& band = "",
+                                       size_t max_points = 0, DownsampleMethod method = DownsampleMethod::LTTB,
+                                       size_t* total_points = nullptr) {
+    vector<LightcurvePoint> points;
+    
+    string query = "SELECT ts, mag, mag_error, flux, flux_error, band FROM " + table_name;
+    string where = lightcurve_where(band, time_start, time_end);
+    query += where;
+    
+    // Min/max reduction of the bands over the limit is pushed down to
+    // TDengine; the other bands are read as they are
+    if (max_points > 0 && method == DownsampleMethod::MinMax) {
+        struct BandCount {
+            string band;
+            size_t count;
+            int64_t span_ms;
+        };
+        vector<BandCount> counts;
+        string count_query = "SELECT band, COUNT(*), FIRST(ts), LAST(ts) FROM " + table_name + where + " PARTITION BY band";
+        ResultReader counter(taos_query(db(), count_query.c_str()));
+        bool plain_bands = counter.ok();      // every band name can be quoted in SQL as it is
+        while (int n = counter.ok() ? counter.next_block() : 0) {
+            for (int r = 0; r < n; r++) {
+                string name(counter.str(0, r));
+                plain_bands = plain_bands && !counter.is_null(0, r) && !name.empty() &&
+                              name.find_first_of("'\\") == string::npos;
+                counts.push_back({name, (size_t)counter.get_int64(1, r), counter.get_int64(3, r) - counter.get_int64(2, r)});
+            }
+        }
+        if (counter.ok() && plain_bands) {
+            size_t total = 0;
+            bool any_long = false;
+            string short_bands;
+            for (const auto& c : counts) {
+                total += c.count;
+                if (c.count > max_points) {
+                    any_long = true;
+                } else {
+                    short_bands += string(short_bands.empty() ? "" : ",") + "'" + c.band + "'";
+                }
+            }
+            if (total_points) *total_points = total;
+            
+            if (!any_long) {
+                max_points = 0;               // nothing to reduce: plain read below
+            } else {
+                string and_where = where.empty() ? " WHERE " : where + " AND ";
+                bool pushed = true;
+                for (const auto& c : counts) {
+                    if (c.count > max_points && pushed) {
+                        pushed = get_lightcurve_minmax(table_name, and_where + "band = '" + c.band + "'",
+                                                       c.span_ms, max_points, points);
+                    }
+                }
+                if (pushed) {
+                    if (!short_bands.empty()) {
+                        string rest = "SELECT ts, mag, mag_error, flux, flux_error, band FROM " + table_name +
+                                      and_where + "band IN (" + short_bands + ")";
+                        ResultReader reader(taos_query(db(), rest.c_str()));
+                        if (!reader.ok()) {
+                            cerr << "[ERROR] Query failed: " << reader.error() << endl;
+                            return {};
+                        }
+                        read_lightcurve_rows(reader, points);
+                    }
+                    sort(points.begin(), points.end(), [](const LightcurvePoint& a, const LightcurvePoint& b) {
+                        return a.ts_ms != b.ts_ms ? a.ts_ms < b.ts_ms : a.band < b.band;
+                    });
+                    return points;
+                }
+                points.clear();               // reduce client-side below
+            }
         }
     }
     
     query += " ORDER BY ts";
     
-    TAOS_RES* res = taos_query(conn, query.c_str());
-    if (res == nullptr) {
-        cerr << "[ERROR] Query failed: " << taos_errstr(res) << endl;
+    ResultReader reader(taos_query(db(), query.c_str()));
+    if (!reader.ok()) {
+        cerr << "[ERROR] Query failed: " << reader.error() << endl;
         return points;
     }
+    read_lightcurve_rows(reader, points);
+    if (total_points) *total_points = points.size();
     
-    TAOS_ROW row;
-    int* lengths;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        lengths = taos_fetch_lengths(res);
-        LightcurvePoint point;
-        
-        TAOS_FIELD* fields = taos_fetch_fields(res);
-        if (fields[0].type == TSDB_DATA_TYPE_TIMESTAMP) {
-            int64_t ts = *(int64_t*)row[0];
-            time_t t = ts / 1000;
-            char buffer[32];
-            strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", gmtime(&t));
-            point.timestamp = string(buffer);
+    if (max_points > 0 && points.size() > max_points) {
+        vector<double> x(points.size()), y(points.size());
+        vector<string> bands(points.size());
+        for (size_t i = 0; i < points.size(); i++) {
+            x[i] = (double)points[i].ts_ms;
+            y[i] = points[i].mag;
+            bands[i] = points[i].band;
         }
-        
-        point.mag = *(double*)row[1];
-        point.mag_error = *(double*)row[2];
-        point.flux = *(double*)row[3];
-        point.flux_error = *(double*)row[4];
-        
-        // 获取 band 字段
-        if (row[5] != nullptr && lengths[5] > 0) {
-            point.band = string((char*)row[5], lengths[5]);
-        } else {
-            point.band = "G";  // 默认波段
+        vector<LightcurvePoint> reduced;
+        for (size_t i : downsample_groups(x, y, bands, max_points, method)) {
+            reduced.push_back(std::move(points[i]));
         }
-        
-        points.push_back(point);
+        points.swap(reduced);
     }
     
-    taos_free_result(res);
     return points;
 }
 
-vector<ObjectInfo> cone_search(double center_ra, double center_dec, double radius_deg) {
-    vector<ObjectInfo> results;
+bool cone_search(double center_ra, double center_dec, double radius_deg, const ObjectVisitor& visit) {
+    size_t found = 0;
     
     if (center_dec < -90.0 || center_dec > 90.0) {
         cerr << "[ERROR] Invalid DEC: " << center_dec << endl;
-        return results;
+        return false;
     }
     
     if (center_ra < 0.0 || center_ra > 360.0) {
         cerr << "[ERROR] Invalid RA: " << center_ra << endl;
-        return results;
+        return false;
     }
     
     int nside = 64;
@@ -646,7 +1005,35 @@ vector<ObjectInfo> cone_search(double center_ra, double center_dec, double radiu
          << healpix_pixels.size() << endl;
     
     if (healpix_pixels.empty()) {
-        return results;
+        return true;
+    }
+    
+    if (auto catalog = current_catalog()) {
+        for (int pixel : healpix_pixels) {
+            auto range = catalog->pixel(pixel);
+            for (const CatalogObject* o = range.first; o != range.second; ++o) {
+                if (angular_distance(center_ra, center_dec, o->ra, o->dec) <= radius_deg) {
+                    visit(catalog_object_info(*catalog, *o));
+                    found++;
+                }
+            }
+        }
+        cout << "[INFO] Found " << found << " objects (catalog)." << endl;
+        return true;
+    }
+    
+    // Candidate objects of the same pixel set are reused until the next import
+    string cache_key = config.db_name + "|" + pixel_set_key(healpix_pixels, "");
+    uint64_t generation = import_generation(config.db_name);
+    if (auto cached = cone_cache.get(cache_key, generation)) {
+        for (const auto& obj : *cached) {
+            if (angular_distance(center_ra, center_dec, obj.ra, obj.dec) <= radius_deg) {
+                visit(obj);
+                found++;
+            }
+        }
+        cout << "[INFO] Found " << found << " objects (cached pixel set)." << endl;
+        return true;
     }
     
     string healpix_ids = "(";
@@ -661,104 +1048,265 @@ vector<ObjectInfo> cone_search(double center_ra, double center_dec, double radiu
                    "WHERE healpix_id IN " + healpix_ids + " "
                    "GROUP BY healpix_id, source_id";
     
-    TAOS_RES* res = taos_query(conn, query.c_str());
-    if (res == nullptr) {
-        cerr << "[ERROR] Cone search query failed: " << taos_errstr(res) << endl;
-        return results;
+    ResultReader reader(taos_query(db(), query.c_str()));
+    if (!reader.ok()) {
+        cerr << "[ERROR] Cone search query failed: " << reader.error() << endl;
+        return false;
     }
     
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        ObjectInfo obj;
-        int* lengths = taos_fetch_lengths(res);
-        
-        obj.healpix_id = *(long long*)row[0];
-        obj.source_id = *(long long*)row[1];
-        obj.ra = *(double*)row[2];
-        obj.dec = *(double*)row[3];
-        obj.data_count = *(int*)row[4];
-        obj.table_name = "sensor_data_" + to_string(obj.healpix_id) + "_" + to_string(obj.source_id);
-        
-        if (row[5] && lengths[5] > 0) obj.object_class = string((char*)row[5], lengths[5]);
-        else obj.object_class = "UNKNOWN";
-        
-        if (row[6] && lengths[6] > 0) obj.band = string((char*)row[6], lengths[6]);
-        else obj.band = "Unknown";
-        
-        double distance = angular_distance(center_ra, center_dec, obj.ra, obj.dec);
-        if (distance <= radius_deg) {
-            results.push_back(obj);
+    auto candidates = make_shared<vector<ObjectInfo>>();
+    size_t bytes = 0;
+    while (int n = reader.next_block()) {
+        for (int r = 0; r < n; r++) {
+            candidates->push_back(read_object_row(reader, r, "UNKNOWN", "Unknown"));
+            const ObjectInfo& obj = candidates->back();
+            bytes += sizeof(ObjectInfo) + obj.table_name.size() + obj.object_class.size() + obj.band.size();
+            if (angular_distance(center_ra, center_dec, obj.ra, obj.dec) <= radius_deg) {
+                visit(obj);
+                found++;
+            }
         }
     }
+    if (!reader.ok()) {
+        cerr << "[ERROR] Cone search fetch failed: " << reader.error() << endl;
+        return false;
+    }
+    cone_cache.put(cache_key, move(candidates), bytes, generation);
     
-    taos_free_result(res);
-    cout << "[INFO] Found " << results.size() << " objects." << endl;
-    return results;
+    cout << "[INFO] Found " << found << " objects." << endl;
+    return true;
 }
 
-vector<ObjectInfo> random_search(int limit) {
-    return get_objects(limit);
+bool random_search(int limit, const ObjectVisitor& visit) {
+    return get_objects(limit, visit);
 }
 
-vector<ObjectInfo> region_search(double ra_min, double ra_max, double dec_min, double dec_max) {
-    vector<ObjectInfo> results;
+// Objects in an RA/Dec box; ra_min > ra_max wraps through RA 0. The box
+// becomes a set of NESTED pixels (runs of consecutive ids), only those
+// pixels are read and each candidate is then tested exactly.
+bool region_search(double ra_min, double ra_max, double dec_min, double dec_max, const ObjectVisitor& visit) {
+    unique_ptr<SkyBox> box;
+    try {
+        box = make_unique<SkyBox>(ra_min, ra_max, dec_min, dec_max);
+    } catch (const invalid_argument& e) {
+        cerr << "[ERROR] Region search: " << e.what() << endl;
+        return false;
+    }
+    
+    T_Healpix_Base<int> healpix(64, NEST, SET_NSIDE);
+    vector<int> pixels = box->pixels(healpix);
+    cout << "[INFO] Region search: " << box->describe() << ", Pixels=" << pixels.size() << endl;
+    if (pixels.empty()) {
+        return true;
+    }
     
+    if (auto catalog = current_catalog()) {
+        vector<const CatalogObject*> hits;
+        for (size_t i = 0; i < pixels.size();) {
+            size_t j = i;
+            while (j + 1 < pixels.size() && pixels[j + 1] == pixels[j] + 1) j++;
+            auto range = catalog->pixel_range(pixels[i], pixels[j]);
+            for (const CatalogObject* o = range.first; o != range.second; ++o) {
+                uint8_t inside;
+                box->contains(&o->ra, &o->dec, 1, &inside);
+                if (inside) hits.push_back(o);
+            }
+            i = j + 1;
+        }
+        sort(hits.begin(), hits.end(), [](const CatalogObject* a, const CatalogObject* b) {
+            return a->source_id < b->source_id;
+        });
+        for (const CatalogObject* o : hits) visit(catalog_object_info(*catalog, *o));
+        cout << "[INFO] Found " << hits.size() << " objects (catalog)." << endl;
+        return true;
+    }
+    
+    // The whole sky needs no pixel condition at all
+    string where = (int)pixels.size() == healpix.Npix() ? "" : "WHERE " + pixel_condition(pixels) + " ";
     string query = "SELECT healpix_id, source_id, FIRST(ra) as ra, FIRST(dec) as dec, COUNT(*) as data_count, FIRST(cls) as cls, FIRST(band) as band "
-                   "FROM sensor_data "
-                   "WHERE ra >= " + to_string(ra_min) + " AND ra <= " + to_string(ra_max) + " "
-                   "AND dec >= " + to_string(dec_min) + " AND dec <= " + to_string(dec_max) + " "
+                   "FROM sensor_data " + where +
                    "GROUP BY healpix_id, source_id "
                    "ORDER BY source_id";
     
-    TAOS_RES* res = taos_query(conn, query.c_str());
-    if (res == nullptr) {
-        cerr << "[ERROR] Query failed: " << taos_errstr(res) << endl;
-        return results;
+    ResultReader reader(taos_query(db(), query.c_str()));
+    if (!reader.ok()) {
+        cerr << "[ERROR] Query failed: " << reader.error() << endl;
+        return false;
     }
     
-    TAOS_ROW row;
-    while ((row = taos_fetch_row(res)) != nullptr) {
-        ObjectInfo obj;
-        int* lengths = taos_fetch_lengths(res);
-        
-        obj.healpix_id = *(long long*)row[0];
-        obj.source_id = *(long long*)row[1];
-        obj.ra = *(double*)row[2];
-        obj.dec = *(double*)row[3];
-        obj.data_count = *(int*)row[4];
-        obj.table_name = "sensor_data_" + to_string(obj.healpix_id) + "_" + to_string(obj.source_id);
-        
-        if (row[5] && lengths[5] > 0) obj.object_class = string((char*)row[5], lengths[5]);
-        else obj.object_class = "UNKNOWN";
-        
-        if (row[6] && lengths[6] > 0) obj.band = string((char*)row[6], lengths[6]);
-        else obj.band = "Unknown";
-        
-        results.push_back(obj);
+    size_t found = 0;
+    while (int n = reader.next_block()) {
+        for (int r = 0; r < n; r++) {
+            ObjectInfo obj = read_object_row(reader, r, "UNKNOWN", "Unknown");
+            uint8_t inside;
+            box->contains(&obj.ra, &obj.dec, 1, &inside);
+            if (inside) {
+                visit(obj);
+                found++;
+            }
+        }
+    }
+    if (!reader.ok()) {
+        cerr << "[ERROR] Region search fetch failed: " << reader.error() << endl;
+        return false;
     }
+    cout << "[INFO] Found " << found << " objects." << endl;
+    return true;
+}
+
+// k nearest objects to (ra, dec): HEALPix discs grow until the K-th
+// distance is inside the radius already read (see <tdlight/knn.h>)
+vector<pair<double, ObjectInfo>> knn_search(double center_ra, double center_dec, int k, double max_radius_deg) {
+    if (center_dec < -90.0 || center_dec > 90.0 || center_ra < 0.0 || center_ra > 360.0) {
+        cerr << "[ERROR] Invalid KNN target: RA=" << center_ra << ", DEC=" << center_dec << endl;
+        return {};
+    }
+    
+    T_Healpix_Base<int> healpix(64, NEST, SET_NSIDE);
+    KnnHeap<ObjectInfo> heap(k);
+    bool failed = false;
+    shared_ptr<const ObjectCatalog> catalog = current_catalog();
+    
+    KnnProgress progress = expand_rings(healpix, center_ra, center_dec, heap,
+        [&](const vector<int>& pixels) {
+            if (failed || pixels.empty()) return;
+            if (catalog) {
+                for (int pixel : pixels) {
+                    auto range = catalog->pixel(pixel);
+                    for (const CatalogObject* o = range.first; o != range.second; ++o) {
+                        double distance = angular_distance(center_ra, center_dec, o->ra, o->dec);
+                        if (distance > max_radius_deg || !heap.accepts(distance)) continue;
+                        heap.offer(distance, catalog_object_info(*catalog, *o));
+                    }
+                }
+                return;
+            }
+            // Outer rings cover long runs of consecutive ids: BETWEEN ranges instead of a huge IN list
+            vector<int> sorted(pixels);
+            sort(sorted.begin(), sorted.end());
+            string query = "SELECT healpix_id, source_id, FIRST(ra) as ra, FIRST(dec) as dec, COUNT(*) as data_count, FIRST(cls) as cls, FIRST(band) as band "
+                           "FROM sensor_data "
+                           "WHERE " + pixel_condition(sorted) + " "
+                           "GROUP BY healpix_id, source_id";
+            
+            ResultReader reader(taos_query(db(), query.c_str()));
+            if (!reader.ok()) {
+                cerr << "[ERROR] KNN query failed: " << reader.error() << endl;
+                failed = true;
+                return;
+            }
+            while (int n = reader.next_block()) {
+                for (int r = 0; r < n; r++) {
+                    double ra = reader.is_null(2, r) ? 0.0 : reader.get_double(2, r);
+                    double dec = reader.is_null(3, r) ? 0.0 : reader.get_double(3, r);
+                    double distance = angular_distance(center_ra, center_dec, ra, dec);
+                    if (distance > max_radius_deg || !heap.accepts(distance)) continue;
+                    heap.offer(distance, read_object_row(reader, r, "UNKNOWN", "Unknown"));
+                }
+            }
+        }, max_radius_deg);
     
-    taos_free_result(res);
-    return results;
+    cout << "[INFO] KNN search: RA=" << center_ra << ", DEC=" << center_dec << ", K=" << k
+         << ", rings=" << progress.rings << ", pixels=" << progress.pixels
+         << ", radius=" << progress.radius_deg << " deg" << endl;
+    
+    if (failed) return {};
+    return heap.take_sorted();
 }
 
 // Input sanitization & JSON escape are now provided by <tdlight/sanitize.h>
 // via `using namespace tdlight;` above.
 
+// One element of an "objects" array
+void put_object_json(BufferedWriter& out, const ObjectInfo& obj) {
+    out.put("{\"table_name\":\"").put(json_escape(obj.table_name))
+       .put("\",\"source_id\":\"").put_int(obj.source_id)
+       .put("\",\"data_count\":").put_int(obj.data_count)
+       .put(",\"healpix_id\":\"").put_int(obj.healpix_id)
+       .put("\",\"ra\":").put_double(obj.ra)
+       .put(",\"dec\":").put_double(obj.dec)
+       .put(",\"object_class\":");
+    if (obj.object_class.empty()) out.put("null");
+    else out.put('"').put(json_escape(obj.object_class)).put('"');
+    out.put(",\"band\":");
+    if (obj.band.empty()) out.put("null");
+    else out.put('"').put(json_escape(obj.band)).put('"');
+    out.put('}');
+}
+
+// {"objects":[...]} with the rows produced by @p search(visit); false
+// (and no closing "]}") if the search failed
+template<typename Search>
+bool put_objects_json(BufferedWriter& out, Search search) {
+    out.put("{\"objects\":[");
+    bool first = true;
+    bool ok = search([&](const ObjectInfo& obj) {
+        if (!first) out.put(',');
+        first = false;
+        put_object_json(out, obj);
+    });
+    if (ok) out.put("]}");
+    return ok;
+}
+
+// Text produced by @p write(BufferedWriter&)
+template<typename Write>
+string write_to_string(Write write) {
+    string text;
+    {
+        BufferedWriter out([&text](const char* data, size_t size) {
+            text.append(data, size);
+            return true;
+        }, 64 << 10);
+        write(out);
+    }
+    return text;
+}
+
+// JSON body written by @p write (false if the query failed): chunked
+// straight to the client when @p stream is set, otherwise returned as a
+// complete response. A failure before the first chunk went out is still
+// a 500; after that the connection is cut so the body cannot pass for
+// a complete result.
+template<typename Write>
+string respond_json(ChunkedResponse* stream, Write write) {
+    if (stream) {
+        if (!write(stream->begin("application/json")) && !stream->discard()) {
+            stream->abort();
+        }
+        return stream->started() ? "" : http::json_error(500, "Query failed");
+    }
+    bool ok = true;
+    string body = write_to_string([&](BufferedWriter& out) { ok = write(out); });
+    return ok ? http::json_ok(body) : http::json_error(500, "Query failed");
+}
+
 string objects_to_json(const vector<ObjectInfo>& objects) {
+    return write_to_string([&](BufferedWriter& out) {
+        put_objects_json(out, [&](const ObjectVisitor& visit) {
+            for (const auto& obj : objects) visit(obj);
+            return true;
+        });
+    });
+}
+
+string neighbours_to_json(const vector<pair<double, ObjectInfo>>& neighbours) {
     stringstream json;
     json << "{\"objects\":[";
     
-    for (size_t i = 0; i < objects.size(); i++) {
+    for (size_t i = 0; i < neighbours.size(); i++) {
+        const ObjectInfo& obj = neighbours[i].second;
         if (i > 0) json << ",";
         json << "{"
-             << "\"table_name\":\"" << json_escape(objects[i].table_name) << "\","
-             << "\"source_id\":\"" << objects[i].source_id << "\","
-             << "\"data_count\":" << objects[i].data_count << ","
-             << "\"healpix_id\":\"" << objects[i].healpix_id << "\","
-             << "\"ra\":" << objects[i].ra << ","
-             << "\"dec\":" << objects[i].dec << ","
-             << "\"object_class\":" << (objects[i].object_class.empty() ? "null" : "\"" + json_escape(objects[i].object_class) + "\"") << ","
-             << "\"band\":" << (objects[i].band.empty() ? "null" : "\"" + json_escape(objects[i].band) + "\"")
+             << "\"table_name\":\"" << json_escape(obj.table_name) << "\","
+             << "\"source_id\":\"" << obj.source_id << "\","
+             << "\"data_count\":" << obj.data_count << ","
+             << "\"healpix_id\":\"" << obj.healpix_id << "\","
+             << "\"ra\":" << obj.ra << ","
+             << "\"dec\":" << obj.dec << ","
+             << "\"distance_arcsec\":" << neighbours[i].first * 3600.0 << ","
+             << "\"object_class\":" << (obj.object_class.empty() ? "null" : "\"" + json_escape(obj.object_class) + "\"") << ","
+             << "\"band\":" << (obj.band.empty() ? "null" : "\"" + json_escape(obj.band) + "\"")
              << "}";
     }
     
@@ -766,29 +1314,162 @@ string objects_to_json(const vector<ObjectInfo>& objects) {
     return json.str();
 }
 
-string lightcurve_to_json(const vector<LightcurvePoint>& points) {
-    stringstream json;
-    json << "{\"metadata\":{\"healpix_id\":null,\"source_id\":null,\"ra\":null,\"dec\":null,\"object_class\":\"UNKNOWN\",\"band\":\"Unknown\"},\"data\":[";
-    
-    for (size_t i = 0; i < points.size(); i++) {
-        if (i > 0) json << ",";
-        json << "{"
-             << "\"ts\":\"" << json_escape(points[i].timestamp) << "\","
-             << "\"mag\":" << points[i].mag << ","
-             << "\"mag_err\":" << points[i].mag_error << ","
-             << "\"flux\":" << points[i].flux << ","
-             << "\"flux_err\":" << points[i].flux_error << ","
-             << "\"band\":\"" << json_escape(points[i].band) << "\""
-             << "}";
+void put_lightcurve_point_json(BufferedWriter& out, int64_t ts_ms, double mag, double mag_error,
+                               double flux, double flux_error, string_view band) {
+    time_t t = ts_ms / 1000;
+    struct tm tm_utc;
+    char ts[32];
+    strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", gmtime_r(&t, &tm_utc));
+    out.put("{\"ts\":\"").put(ts)
+       .put("\",\"mag\":").put_double(mag)
+       .put(",\"mag_err\":").put_double(mag_error)
+       .put(",\"flux\":").put_double(flux)
+       .put(",\"flux_err\":").put_double(flux_error)
+       .put(",\"band\":\"").put(json_escape(string(band))).put("\"}");
+}
+
+void put_lightcurve_header_json(BufferedWriter& out, size_t points, size_t total_points) {
+    out.put("{\"metadata\":{\"healpix_id\":null,\"source_id\":null,\"ra\":null,\"dec\":null,\"object_class\":\"UNKNOWN\",\"band\":\"Unknown\"");
+    if (total_points > points) {
+        out.put(",\"downsampled\":true,\"total_points\":").put_int((int64_t)total_points);
     }
-    
-    json << "]}";
-    return json.str();
+    out.put("},\"data\":[");
+}
+
+string lightcurve_to_json(const vector<LightcurvePoint>& points, size_t total_points = 0) {
+    return write_to_string([&](BufferedWriter& out) {
+        put_lightcurve_header_json(out, points.size(), total_points);
+        for (size_t i = 0; i < points.size(); i++) {
+            if (i > 0) out.put(',');
+            const LightcurvePoint& p = points[i];
+            put_lightcurve_point_json(out, p.ts_ms, p.mag, p.mag_error, p.flux, p.flux_error, p.band);
+        }
+        out.put("]}");
+    });
+}
+
+// Full-resolution curve serialized straight from the fetch loop, so a long
+// curve is never held in memory; same JSON as lightcurve_to_json().
+// @p reader holds the result of lightcurve_rows_query(); false if fetching
+// failed part way, leaving the JSON incomplete.
+string lightcurve_rows_query(const string& table_name, const string& where) {
+    return "SELECT ts, mag, mag_error, flux, flux_error, band FROM " + table_name + where + " ORDER BY ts";
+}
+
+bool put_lightcurve_json_rows(BufferedWriter& out, ResultReader& reader) {
+    put_lightcurve_header_json(out, 0, 0);
+    bool first = true;
+    while (int n = reader.next_block()) {
+        auto ts = reader.column<int64_t>(0);
+        auto mag = reader.column<double>(1);
+        auto mag_error = reader.column<double>(2);
+        auto flux = reader.column<double>(3);
+        auto flux_error = reader.column<double>(4);
+        for (int r = 0; r < n; r++) {
+            if (!first) out.put(',');
+            first = false;
+            string_view band = reader.str(5, r);
+            put_lightcurve_point_json(out, ts[r], mag[r], mag_error[r], flux[r], flux_error[r],
+                                      band.empty() ? string_view("G") : band);
+        }
+    }
+    if (!reader.ok()) return false;
+    out.put("]}");
+    return true;
+}
+
+// Columnar light curve for /api/lightcurve_bin (little-endian):
+//   0  "TDLC"        4  u16 version (1)   6  u16 flags (bit 0: downsampled)
+//   8  u32 points    12 u32 total_points  16 u16 bands     18 u16 data offset
+//   20 band names (u8 length + bytes each), zero-padded to a multiple of 8
+//   then f64 ts (ms since epoch), f32 mag, f32 mag_err, f32 flux, f32 flux_err
+//   and u8 band (index into the band names), each holding `points` values.
+// Returns "" if the curve has more than 256 distinct bands.
+string lightcurve_to_binary(const vector<LightcurvePoint>& points, size_t total_points = 0) {
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "binary light curves are written in host order");
+    
+    vector<string> bands;
+    map<string, uint8_t> band_codes;
+    vector<uint8_t> codes(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        auto it = band_codes.find(points[i].band);
+        if (it == band_codes.end()) {
+            if (bands.size() == 256) return "";
+            it = band_codes.emplace(points[i].band, (uint8_t)bands.size()).first;
+            bands.push_back(points[i].band.substr(0, 255));
+        }
+        codes[i] = it->second;
+    }
+    
+    size_t header = 20;
+    for (const auto& b : bands) header += 1 + b.size();
+    header = (header + 7) & ~size_t(7);
+    size_t n = points.size();
+    
+    string out(header + n * (8 + 4 * 4 + 1), '\0');
+    char* p = &out[0];
+    auto put = [&p](const void* v, size_t len) { memcpy(p, v, len); p += len; };
+    uint16_t version = 1, flags = total_points > n ? 1 : 0;
+    uint32_t count = (uint32_t)n, total = (uint32_t)max(total_points, n);
+    uint16_t band_count = (uint16_t)bands.size(), offset = (uint16_t)header;
+    put("TDLC", 4);
+    put(&version, 2);
+    put(&flags, 2);
+    put(&count, 4);
+    put(&total, 4);
+    put(&band_count, 2);
+    put(&offset, 2);
+    for (const auto& b : bands) {
+        uint8_t len = (uint8_t)b.size();
+        put(&len, 1);
+        put(b.data(), len);
+    }
+    
+    p = &out[header];
+    for (const auto& pt : points) { double v = (double)pt.ts_ms; put(&v, 8); }
+    for (const auto& pt : points) { float v = (float)pt.mag; put(&v, 4); }
+    for (const auto& pt : points) { float v = (float)pt.mag_error; put(&v, 4); }
+    for (const auto& pt : points) { float v = (float)pt.flux; put(&v, 4); }
+    for (const auto& pt : points) { float v = (float)pt.flux_error; put(&v, 4); }
+    if (n) put(codes.data(), n);
+    return out;
+}
+
+// Requests that change config.db_* or reconnect the pool
+bool changes_database_config(const string& method, const string& path) {
+    string route = path.substr(0, path.find('?'));
+    return route == "/api/switch_database" || route == "/api/config/reload" ||
+           (route == "/api/config" && method == "POST");
+}
+
+// Database each background job ("import", "classify", "auto_classify")
+// writes to. A job bumps the import generation when it finishes; one that
+// is killed may already have written rows or tags, so whoever kills it
+// bumps the generation instead, or cached results outlive the data.
+std::mutex job_database_mutex;
+map<string, string> job_databases;
+
+void job_started(const string& job, const string& database) {
+    std::lock_guard<std::mutex> lock(job_database_mutex);
+    job_databases[job] = database;
+}
+
+void job_killed(const string& job) {
+    string database;
+    {
+        std::lock_guard<std::mutex> lock(job_database_mutex);
+        auto it = job_databases.find(job);
+        database = it != job_databases.end() ? it->second : config.db_name;
+    }
+    bump_import_generation(database);
 }
 
-string handle_request(const string& request) {
-    std::lock_guard<std::mutex> lock(db_mutex);
+// index.html, app.js, ... (in memory, precompressed)
+StaticFileCache static_files;
 
+// Large JSON results are written to @p stream (when given) as they are
+// fetched and "" is returned; everything else returns a complete response
+string route_request(const string& request, ChunkedResponse* stream) {
     vector<string> lines = split(request, '\n');
     if (lines.empty()) return "";
     
@@ -820,14 +1501,9 @@ string handle_request(const string& request) {
             limit = stoi(params["limit"]);
         }
         
-        vector<ObjectInfo> objects = get_objects(limit);
-        string json_response = objects_to_json(objects);
-        
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: application/json\r\n"
-               "Access-Control-Allow-Origin: *\r\n"
-               "Content-Length: " + to_string(json_response.length()) + "\r\n"
-               "\r\n" + json_response;
+        return respond_json(stream, [&](BufferedWriter& out) {
+            return put_objects_json(out, [&](const ObjectVisitor& visit) { return get_objects(limit, visit); });
+        });
     }
     else if (path.find("/api/object/") == 0) {
         string table_name = path.substr(12);
@@ -841,7 +1517,7 @@ string handle_request(const string& request) {
         }
         
         string tag_query = "SELECT healpix_id, source_id, ra, dec, cls, band FROM " + table_name + " LIMIT 1";
-        TAOS_RES* tag_res = taos_query(conn, tag_query.c_str());
+        ResultReader tag_reader(taos_query(db(), tag_query.c_str()));
         
         ObjectInfo obj;
         obj.table_name = table_name;
@@ -853,28 +1529,19 @@ string handle_request(const string& request) {
         obj.object_class = "UNKNOWN";
         obj.band = "Unknown";
         
-        if (tag_res != nullptr) {
-            TAOS_ROW tag_row = taos_fetch_row(tag_res);
-            if (tag_row != nullptr) {
-                int* tag_lengths = taos_fetch_lengths(tag_res);
-                obj.healpix_id = *(long long*)tag_row[0];
-                obj.source_id = *(long long*)tag_row[1];
-                obj.ra = *(double*)tag_row[2];
-                obj.dec = *(double*)tag_row[3];
-                obj.object_class = tag_row[4] ? string((char*)tag_row[4], tag_lengths[4]) : "UNKNOWN";
-                obj.band = tag_row[5] ? string((char*)tag_row[5], tag_lengths[5]) : "Unknown";
-                
-                string count_query = "SELECT COUNT(*) FROM " + table_name;
-                TAOS_RES* count_res = taos_query(conn, count_query.c_str());
-                if (count_res != nullptr) {
-                    TAOS_ROW count_row = taos_fetch_row(count_res);
-                    if (count_row != nullptr) {
-                        obj.data_count = *(int*)count_row[0];
-                    }
-                    taos_free_result(count_res);
-                }
+        if (tag_reader.ok() && tag_reader.next_block() > 0) {
+            obj.healpix_id = tag_reader.get_int64(0, 0);
+            obj.source_id = tag_reader.get_int64(1, 0);
+            obj.ra = tag_reader.get_double(2, 0);
+            obj.dec = tag_reader.get_double(3, 0);
+            if (!tag_reader.is_null(4, 0)) obj.object_class = string(tag_reader.str(4, 0));
+            if (!tag_reader.is_null(5, 0)) obj.band = string(tag_reader.str(5, 0));
+            
+            string count_query = "SELECT COUNT(*) FROM " + table_name;
+            ResultReader count_reader(taos_query(db(), count_query.c_str()));
+            if (count_reader.ok() && count_reader.next_block() > 0) {
+                obj.data_count = (int)count_reader.get_int64(0, 0);
             }
-            taos_free_result(tag_res);
         }
         
         string json_response = objects_to_json({obj});
@@ -885,8 +1552,9 @@ string handle_request(const string& request) {
                "Content-Length: " + to_string(json_response.length()) + "\r\n"
                "\r\n" + json_response;
     }
-    else if (path.find("/api/lightcurve/") == 0) {
-        string table_name = path.substr(16);
+    else if (path.find("/api/lightcurve/") == 0 || path.find("/api/lightcurve_bin/") == 0) {
+        bool binary = path.find("/api/lightcurve_bin/") == 0;
+        string table_name = path.substr(binary ? 20 : 16);
         if (!is_valid_sql_identifier(table_name)) {
             string error = "{\"error\":\"Invalid table name\"}";
             return "HTTP/1.1 400 Bad Request\r\n"
@@ -899,14 +1567,73 @@ string handle_request(const string& request) {
         string time_start = params.find("time_start") != params.end() ? params["time_start"] : "";
         string time_end = params.find("time_end") != params.end() ? params["time_end"] : "";
         
-        vector<LightcurvePoint> points = get_lightcurve(table_name, time_start, time_end);
-        string json_response = lightcurve_to_json(points);
+        size_t max_points = 0;
+        DownsampleMethod downsample = DownsampleMethod::LTTB;
+        if (params.count("max_points")) {
+            if (!is_valid_numeric(params["max_points"]) || !parse_downsample_method(params["downsample"], downsample)) {
+                return "HTTP/1.1 400 Bad Request\r\n\r\nInvalid downsampling parameters";
+            }
+            max_points = (size_t)max(4.0, min(1e6, stod(params["max_points"])));
+        }
         
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: application/json\r\n"
-               "Access-Control-Allow-Origin: *\r\n"
-               "Content-Length: " + to_string(json_response.length()) + "\r\n"
-               "\r\n" + json_response;
+        string band = params.count("band") ? params["band"] : "";
+        if (!band.empty() && !is_valid_sql_identifier(band)) {
+            return "HTTP/1.1 400 Bad Request\r\n\r\nInvalid band";
+        }
+        
+        // Responses are reused until the next import/classification of this database
+        string cache_key = string(binary ? "bin|" : "json|") + config.db_name + "|" + table_name + "|" + band + "|" + time_start + "|" + time_end +
+                           "|" + to_string(max_points) + "|" + (downsample == DownsampleMethod::MinMax ? "minmax" : "lttb");
+        uint64_t generation = import_generation(config.db_name);
+        string body;
+        if (auto cached = lightcurve_cache->get(cache_key, generation)) {
+            body = *cached;
+        } else if (stream && !binary && max_points == 0) {
+            // Full-resolution curves can be long: stream them instead of caching
+            // Nothing is sent until the query has started, so a failure is
+            // still a proper 500; a failure mid-body cuts the connection
+            // instead of ending the chunked body as if it were complete
+            string where = lightcurve_where(band, time_start, time_end);
+            ResultReader reader(taos_query(db(), lightcurve_rows_query(table_name, where).c_str()));
+            if (!reader.ok()) {
+                cerr << "[ERROR] Query failed: " << reader.error() << endl;
+                return http::json_error(500, "Query failed");
+            }
+            if (!put_lightcurve_json_rows(stream->begin("application/json"), reader)) {
+                cerr << "[ERROR] Light curve fetch failed: " << reader.error() << endl;
+                if (stream->discard()) return http::json_error(500, "Query failed");
+                stream->abort();
+            }
+            return "";
+        } else {
+            size_t total_points = 0;
+            vector<LightcurvePoint> points = get_lightcurve(table_name, time_start, time_end, band,
+                                                            max_points, downsample, &total_points);
+            if (binary) {
+                body = lightcurve_to_binary(points, total_points);
+                if (body.empty()) return http::json_error(500, "Too many bands for binary light curve");
+            } else {
+                body = lightcurve_to_json(points, total_points);
+            }
+            if (!points.empty()) {
+                lightcurve_cache->put(cache_key, make_shared<const string>(body),
+                                      sizeof(string) + body.size(), generation);
+            }
+        }
+        
+        return http::response(200, binary ? "application/octet-stream" : "application/json", body);
+    }
+    else if (path == "/api/cache_stats") {
+        auto stats_json = [](const CacheStats& st) {
+            uint64_t lookups = st.hits + st.misses;
+            return "{\"hits\":" + to_string(st.hits) + ",\"misses\":" + to_string(st.misses) +
+                   ",\"hit_rate\":" + to_string(lookups ? (double)st.hits / lookups : 0.0) +
+                   ",\"evictions\":" + to_string(st.evictions) + ",\"entries\":" + to_string(st.entries) +
+                   ",\"bytes\":" + to_string(st.bytes) + ",\"budget\":" + to_string(st.budget) + "}";
+        };
+        string json = "{\"lightcurve\":" + stats_json(lightcurve_cache->stats()) +
+                      ",\"cone\":" + stats_json(cone_cache.stats()) + "}";
+        return http::json_ok(json);
     }
     else if (path == "/api/cone_search") {
         if (params.find("ra") == params.end() || params.find("dec") == params.end() || params.find("radius") == params.end()) {
@@ -920,9 +1647,33 @@ string handle_request(const string& request) {
         double ra = stod(params["ra"]);
         double dec = stod(params["dec"]);
         double radius = stod(params["radius"]);
+        if (dec < -90.0 || dec > 90.0 || ra < 0.0 || ra > 360.0) {
+            return "HTTP/1.1 400 Bad Request\r\n\r\nRA must be in [0, 360] and DEC in [-90, 90]";
+        }
         
-        vector<ObjectInfo> results = cone_search(ra, dec, radius);
-        string json_response = objects_to_json(results);
+        return respond_json(stream, [&](BufferedWriter& out) {
+            return put_objects_json(out, [&](const ObjectVisitor& visit) { return cone_search(ra, dec, radius, visit); });
+        });
+    }
+    else if (path == "/api/knn") {
+        if (params.find("ra") == params.end() || params.find("dec") == params.end() || params.find("k") == params.end()) {
+            return "HTTP/1.1 400 Bad Request\r\n\r\nMissing parameters";
+        }
+        
+        if (!is_valid_numeric(params["ra"]) || !is_valid_numeric(params["dec"]) || !is_valid_numeric(params["k"]) ||
+            (params.count("max_radius") && !is_valid_numeric(params["max_radius"]))) {
+            return "HTTP/1.1 400 Bad Request\r\n\r\nInvalid numeric parameters";
+        }
+        
+        double ra = stod(params["ra"]);
+        double dec = stod(params["dec"]);
+        int k = max(1, min(1000, (int)stod(params["k"])));
+        double max_radius = params.count("max_radius") ? stod(params["max_radius"]) : 180.0;
+        if (!(max_radius > 0.0 && max_radius <= 180.0)) {
+            return "HTTP/1.1 400 Bad Request\r\n\r\nmax_radius must be in (0, 180]";
+        }
+        
+        string json_response = neighbours_to_json(knn_search(ra, dec, k, max_radius));
         
         return "HTTP/1.1 200 OK\r\n"
                "Content-Type: application/json\r\n"
@@ -940,15 +1691,15 @@ string handle_request(const string& request) {
         double ra_max = stod(params["ra_max"]);
         double dec_min = stod(params["dec_min"]);
         double dec_max = stod(params["dec_max"]);
+        if (!(dec_min >= -90.0 && dec_max <= 90.0 && dec_min <= dec_max) || !isfinite(ra_min) || !isfinite(ra_max)) {
+            return "HTTP/1.1 400 Bad Request\r\n\r\nBox needs -90 <= dec_min <= dec_max <= 90";
+        }
         
-        vector<ObjectInfo> results = region_search(ra_min, ra_max, dec_min, dec_max);
-        string json_response = objects_to_json(results);
-        
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: application/json\r\n"
-               "Access-Control-Allow-Origin: *\r\n"
-               "Content-Length: " + to_string(json_response.length()) + "\r\n"
-               "\r\n" + json_response;
+        return respond_json(stream, [&](BufferedWriter& out) {
+            return put_objects_json(out, [&](const ObjectVisitor& visit) {
+                return region_search(ra_min, ra_max, dec_min, dec_max, visit);
+            });
+        });
     }
     else if (path == "/api/sky_map") {
         int limit = 200;
@@ -956,15 +1707,26 @@ string handle_request(const string& request) {
             limit = stoi(params["limit"]);
         }
         
-        vector<ObjectInfo> results = random_search(limit);
-        
-        string json_response = objects_to_json(results);
+        return respond_json(stream, [&](BufferedWriter& out) {
+            return put_objects_json(out, [&](const ObjectVisitor& visit) { return random_search(limit, visit); });
+        });
+    }
+    else if (path == "/api/density") {
+        auto density = current_density();
+        if (!density) return http::json_error(500, "Density map unavailable");
         
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: application/json\r\n"
-               "Access-Control-Allow-Origin: *\r\n"
-               "Content-Length: " + to_string(json_response.length()) + "\r\n"
-               "\r\n" + json_response;
+        // Up to the table's order (at most 8); default 4 or the finest there is
+        int order = min(4, density->max_order());
+        if (params.find("order") != params.end()) {
+            const string& text = params["order"];
+            int max_order = density->max_order();
+            if (text.empty() || text.size() > 2 || !all_of(text.begin(), text.end(), ::isdigit) ||
+                stoi(text) > max_order) {
+                return http::json_error(400, "order must be 0-" + to_string(max_order));
+            }
+            order = stoi(text);
+        }
+        return http::response(200, "application/octet-stream", density->encoded(order));
     }
     else if (path == "/api/object_by_id") {
         if (params.find("id") == params.end()) {
@@ -981,6 +1743,19 @@ string handle_request(const string& request) {
                    "\r\n" + error;
         }
         
+        if (auto catalog = current_catalog()) {
+            vector<ObjectInfo> results;
+            if (const CatalogObject* o = catalog->find_source(strtoll(source_id.c_str(), nullptr, 10))) {
+                results.push_back(catalog_object_info(*catalog, *o));
+            }
+            string json_response = objects_to_json(results);
+            return "HTTP/1.1 200 OK\r\n"
+                   "Content-Type: application/json\r\n"
+                   "Access-Control-Allow-Origin: *\r\n"
+                   "Content-Length: " + to_string(json_response.length()) + "\r\n"
+                   "\r\n" + json_response;
+        }
+        
         string query = "SELECT healpix_id, source_id, FIRST(ra) as ra, FIRST(dec) as dec, COUNT(*) as data_count, "
                        "FIRST(cls) as cls, FIRST(band) as band "
                        "FROM sensor_data "
@@ -988,48 +1763,17 @@ string handle_request(const string& request) {
                        "GROUP BY healpix_id, source_id "
                        "LIMIT 1";
         
-        TAOS_RES* res = taos_query(conn, query.c_str());
-        if (res == nullptr) {
-            cerr << "[ERROR] Query failed: " << taos_errstr(res) << endl;
+        ResultReader reader(taos_query(db(), query.c_str()));
+        if (!reader.ok()) {
+            cerr << "[ERROR] Query failed: " << reader.error() << endl;
             return "HTTP/1.1 500 Internal Server Error\r\n\r\nQuery failed";
         }
         
         vector<ObjectInfo> results;
-        TAOS_ROW row = taos_fetch_row(res);
-        if (row != nullptr) {
-            ObjectInfo obj;
-            
-            obj.healpix_id = *(long long*)row[0];
-            obj.source_id = *(long long*)row[1];
-            obj.ra = *(double*)row[2];
-            obj.dec = *(double*)row[3];
-            obj.data_count = *(int*)row[4];
-            
-            int* lengths = taos_fetch_lengths(res);
-            if (lengths != nullptr) {
-                if (row[5] != nullptr && lengths[5] > 0) {
-                    obj.object_class = string((char*)row[5], lengths[5]);
-                } else {
-                    obj.object_class = "UNKNOWN";
-                }
-                
-                if (row[6] != nullptr && lengths[6] > 0) {
-                    obj.band = string((char*)row[6], lengths[6]);
-                } else {
-                    obj.band = "Unknown";
-                }
-            } else {
-                obj.object_class = "UNKNOWN";
-                obj.band = "Unknown";
-            }
-            
-            obj.table_name = "sensor_data_" + to_string(obj.healpix_id) + "_" + to_string(obj.source_id);
-            
-            results.push_back(obj);
+        if (reader.next_block() > 0) {
+            results.push_back(read_object_row(reader, 0, "UNKNOWN", "Unknown"));
         }
         
-        taos_free_result(res);
-        
         string json_response = objects_to_json(results);
         
         return "HTTP/1.1 200 OK\r\n"
@@ -1038,65 +1782,14 @@ string handle_request(const string& request) {
                "Content-Length: " + to_string(json_response.length()) + "\r\n"
                "\r\n" + json_response;
     }
-    else if (path == "/") {
-        FILE* file = fopen("index.html", "r");
-        if (file == nullptr) {
-            return "HTTP/1.1 500 Internal Server Error\r\n\r\nCannot read index.html";
-        }
-        
-        string html;
-        char buffer[4096];
-        while (fgets(buffer, sizeof(buffer), file) != nullptr) {
-            html += buffer;
+    else if (path == "/" || path == "/app.js" || path == "/lang.js" || path == "/sse_test.html") {
+        string name = path == "/" ? "index.html" : path.substr(1);
+        auto file = static_files.get(name, path == "/" || path == "/sse_test.html"
+                                               ? "text/html; charset=utf-8" : "application/javascript; charset=utf-8");
+        if (!file) {
+            return "HTTP/1.1 404 Not Found\r\n\r\n" + name + " not found";
         }
-        fclose(file);
-        
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: text/html\r\n"
-               "Cache-Control: no-cache, no-store, must-revalidate\r\n"
-               "Pragma: no-cache\r\n"
-               "Expires: 0\r\n"
-               "Content-Length: " + to_string(html.length()) + "\r\n"
-               "\r\n" + html;
-    }
-    else if (path == "/sse_test.html") {
-        FILE* file = fopen("sse_test.html", "r");
-        if (file == nullptr) {
-            return "HTTP/1.1 404 Not Found\r\n\r\nsse_test.html not found";
-        }
-        
-        string html;
-        char buffer[4096];
-        while (fgets(buffer, sizeof(buffer), file) != nullptr) {
-            html += buffer;
-        }
-        fclose(file);
-        
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: text/html\r\n"
-               "Content-Length: " + to_string(html.length()) + "\r\n"
-               "\r\n" + html;
-    }
-    else if (path == "/app.js") {
-        FILE* file = fopen("app.js", "r");
-        if (file == nullptr) {
-            return "HTTP/1.1 404 Not Found\r\n\r\napp.js not found";
-        }
-        
-        string js;
-        char buffer[4096];
-        while (fgets(buffer, sizeof(buffer), file) != nullptr) {
-            js += buffer;
-        }
-        fclose(file);
-        
-        return "HTTP/1.1 200 OK\r\n"
-               "Content-Type: application/javascript\r\n"
-               "Cache-Control: no-cache, no-store, must-revalidate\r\n"
-               "Pragma: no-cache\r\n"
-               "Expires: 0\r\n"
-               "Content-Length: " + to_string(js.length()) + "\r\n"
-               "\r\n" + js;
+        return static_response(*file, request);
     }
     else if (path == "/api/databases") {
         vector<string> dbs = get_databases();
@@ -1179,6 +1872,7 @@ string handle_request(const string& request) {
         usleep(500000);  // 500ms
         
         system("pkill -9 -f 'classify_pipeline.py' 2>/dev/null");
+        job_killed("classify");
         
         remove("/tmp/classid.txt");
         remove("/tmp/class_progress.json");
@@ -1264,6 +1958,7 @@ string handle_request(const string& request) {
         }
         
         system("pkill -9 -f 'classify_pipeline.py' 2>/dev/null");
+        job_killed("classify");
         
         string task_id = "";
         if (params.find("task_id") != params.end()) {
@@ -1301,6 +1996,7 @@ string handle_request(const string& request) {
                      "--web-mode"
                      "' > /tmp/classify_pipeline.log 2>&1 &";
         
+        job_started("classify", config.db_name);
         system(cmd.c_str());
         
         cout << "[INFO] Started classification background task." << endl;
@@ -1442,10 +2138,6 @@ string handle_request(const string& request) {
         load_config();
         
         // Reconnect to database
-        if (conn) {
-            taos_close(conn);
-            conn = nullptr;
-        }
         connect_to_database();
         
         string result = "{\"success\":true,\"message\":\"Config reloaded and database reconnected.\",\"config\":" + config_to_json() + "}";
@@ -1491,13 +2183,14 @@ string handle_request(const string& request) {
         }
         
         string sql = "DROP DATABASE IF EXISTS " + db_name;
-        TAOS_RES* res = taos_query(conn, sql.c_str());
+        TAOS_RES* res = taos_query(db(), sql.c_str());
         int code = taos_errno(res);
         string errmsg = taos_errstr(res);
         taos_free_result(res);
         
         string result;
         if (code == 0) {
+            bump_import_generation(db_name);
             result = "{\"success\":true,\"message\":\"Database " + db_name + " dropped\"}";
         } else {
             result = "{\"success\":false,\"error\":\"" + errmsg + "\"}";
@@ -1554,6 +2247,7 @@ string handle_request(const string& request) {
         // Stop previous import task
         system("pkill -9 -f 'catalog_importer' 2>/dev/null");
         system("pkill -9 -f 'lightcurve_importer' 2>/dev/null");
+        job_killed("import");
         remove("/tmp/import_progress.json");
         remove("/tmp/import.log");
         remove("/tmp/import_stop");
@@ -1596,6 +2290,7 @@ string handle_request(const string& request) {
                   "' > /tmp/import.log 2>&1 &";
         }
         
+        job_started("import", db_name.empty() ? config.db_name : db_name);
         system(cmd.c_str());
         
         string result = "{\"success\":true,\"message\":\"Import task started\"}";
@@ -1627,6 +2322,7 @@ string handle_request(const string& request) {
         
         system("pkill -9 -f 'catalog_importer' 2>/dev/null");
         system("pkill -9 -f 'lightcurve_importer' 2>/dev/null");
+        job_killed("import");
         
         // Explicitly update progress to stopped
         {
@@ -1713,6 +2409,7 @@ string handle_request(const string& request) {
         
         // Stop previous task
         system("pkill -9 -f 'auto_classify.py' 2>/dev/null");
+        job_killed("auto_classify");
         remove("/tmp/auto_classify_progress.json");
         remove("/tmp/auto_classify_stop");
         
@@ -1741,6 +2438,7 @@ string handle_request(const string& request) {
                      (resume ? " --resume" : "") +
                      "' > /tmp/auto_classify.log 2>&1 &";
         
+        job_started("auto_classify", db_name);
         system(cmd.c_str());
         
         string result = "{\"success\":true,\"count\":" + to_string(count) + ",\"message\":\"Auto-classification task started\",\"db_name\":\"" + db_name + "\"}";
@@ -1759,6 +2457,7 @@ string handle_request(const string& request) {
         usleep(500000);  // 500ms
         
         system("pkill -9 -f 'auto_classify.py' 2>/dev/null");
+        job_killed("auto_classify");
         
         string result = "{\"success\":true,\"message\":\"Stop signal sent\"}";
         return "HTTP/1.1 200 OK\r\n"
@@ -1815,7 +2514,65 @@ string handle_request(const string& request) {
     return "HTTP/1.1 404 Not Found\r\n\r\nNot Found";
 }
 
-void handle_sse_stream(int client_socket, const string& request) {
+// Progress of classification, import and auto-classification jobs, pushed
+// to SSE clients by one hub thread when the jobs rewrite their files
+ProgressHub progress_hub;
+int classify_topic = -1;
+int import_topic = -1;
+int auto_classify_topic = -1;
+
+const char* const CLASSIFY_PROGRESS_FILE = "/tmp/class_progress.json";
+const char* const IMPORT_PROGRESS_FILE = "/tmp/import_progress.json";
+const char* const IMPORT_LOG_FILE = "/tmp/import.log";
+const char* const AUTO_CLASSIFY_PROGRESS_FILE = "/tmp/auto_classify_progress.json";
+
+bool read_progress_file(const char* path, string& content, struct stat* st = nullptr) {
+    if (st && stat(path, st) != 0) return false;
+    ifstream file(path);
+    if (!file.is_open()) return false;
+    stringstream ss;
+    ss << file.rdbuf();
+    content = ss.str();
+    return true;
+}
+
+bool progress_has(const string& json, const char* key, const char* value) {
+    return json.find(string("\"") + key + "\":\"" + value + "\"") != string::npos ||
+           json.find(string("\"") + key + "\": \"" + value + "\"") != string::npos;
+}
+
+bool classify_complete(const string& json) {
+    return json.find("\"percent\": 100") != string::npos || json.find("\"percent\":100") != string::npos ||
+           progress_has(json, "step", "done");
+}
+
+// Runs on the hub thread only
+ProgressHub::Snapshot read_classify_progress() {
+    static string last_content;
+    ProgressHub::Snapshot snapshot;
+    struct stat st;
+    string content;
+    snapshot.exists = stat(CLASSIFY_PROGRESS_FILE, &st) == 0;
+    if (!snapshot.exists) {
+        snapshot.data = "{\"percent\":0, \"message\":\"Starting...\", \"step\":\"init\"}";
+        return snapshot;
+    }
+    snapshot.mtime = st.st_mtim;
+    if (read_progress_file(CLASSIFY_PROGRESS_FILE, content) && !content.empty()) {
+        // A reader can catch the file between truncation and rewrite
+        last_content = content;
+        snapshot.data = content;
+    } else if (!last_content.empty()) {
+        snapshot.data = last_content;
+    } else {
+        snapshot.data = "{\"percent\":0, \"message\":\"Waiting...\", \"step\":\"\"}";
+    }
+    return snapshot;
+}
+
+// ?task_id=... follows one task; otherwise a completed file left over from
+// before the client connected is not replayed
+ProgressHub::Filter classify_filter(const string& request) {
     string target_task_id = "";
     size_t q_pos = request.find("?");
     if (q_pos != string::npos) {
@@ -1826,345 +2583,183 @@ void handle_sse_stream(int client_socket, const string& request) {
             target_task_id = request.substr(id_pos + 8, end - (id_pos + 8));
         }
     }
-
-    string header = "HTTP/1.1 200 OK\r\n"
-                   "Content-Type: text/event-stream\r\n"
-                   "Cache-Control: no-cache\r\n"
-                   "Connection: keep-alive\r\n"
-                   "Access-Control-Allow-Origin: *\r\n"
-                   "\r\n";
-    send(client_socket, header.c_str(), header.length(), 0);
-    
-    string last_content;
-    string last_sent_data = "";
     
     struct timespec start_ts;
     clock_gettime(CLOCK_REALTIME, &start_ts);
     
-    time_t last_heartbeat = time(nullptr);
-    
-    while (true) {
-        struct stat st;
-        bool file_exists = (stat("/tmp/class_progress.json", &st) == 0);
-        
-        string json_data;
-        
-        if (file_exists) {
-            ifstream file("/tmp/class_progress.json");
-            if (file.is_open()) {
-                stringstream ss;
-                ss << file.rdbuf();
-                string content = ss.str();
-                if (!content.empty()) {
-                    json_data = content;
-                    last_content = content;
-                } else if (!last_content.empty()) {
-                    json_data = last_content;
-                } else {
-                    json_data = "{\"percent\":0, \"message\":\"Waiting...\", \"step\":\"\"}";
-                }
-            } else if (!last_content.empty()) {
-                json_data = last_content;
-            } else {
-                json_data = "{\"percent\":0, \"message\":\"Waiting...\", \"step\":\"\"}";
-            }
-        } else {
-            json_data = "{\"percent\":0, \"message\":\"Starting...\", \"step\":\"init\"}";
-        }
-        
+    return [target_task_id, start_ts](const ProgressHub::Snapshot& snapshot) {
+        bool is_complete = classify_complete(snapshot.data);
         if (!target_task_id.empty()) {
-            string file_task_id = json_get_string(json_data, "task_id");
-            if (file_task_id != target_task_id) {
-                usleep(50000);
-                continue;
-            }
-        } else {
-            bool is_complete = (json_data.find("\"percent\": 100") != string::npos || 
-                               json_data.find("\"percent\":100") != string::npos ||
-                               json_data.find("\"step\":\"done\"") != string::npos ||
-                               json_data.find("\"step\": \"done\"") != string::npos);
-            
-            if (file_exists && is_complete) {
-                bool is_old = false;
-                if (st.st_mtim.tv_sec < start_ts.tv_sec) {
-                    is_old = true;
-                } else if (st.st_mtim.tv_sec == start_ts.tv_sec) {
-                    if (st.st_mtim.tv_nsec <= start_ts.tv_nsec) {
-                        is_old = true;
-                    }
-                }
-                
-                if (is_old) {
-                    usleep(50000);
-                    continue;
-                }
+            if (json_get_string(snapshot.data, "task_id") != target_task_id) {
+                return ProgressHub::Verdict::Skip;
             }
+        } else if (snapshot.exists && is_complete) {
+            bool is_old = snapshot.mtime.tv_sec < start_ts.tv_sec ||
+                          (snapshot.mtime.tv_sec == start_ts.tv_sec && snapshot.mtime.tv_nsec <= start_ts.tv_nsec);
+            if (is_old) return ProgressHub::Verdict::Skip;
         }
-        
-        if (json_data == last_sent_data) {
-            time_t now = time(nullptr);
-            if (now - last_heartbeat >= 2) { 
-                string heartbeat = ": keep-alive\n\n";
-                ssize_t sent = send(client_socket, heartbeat.c_str(), heartbeat.length(), MSG_NOSIGNAL);
-                if (sent < 0) {
-                    break;
-                }
-                last_heartbeat = now;
-            }
-            usleep(50000);
-            continue;
-        }
-        
-        last_sent_data = json_data;
-        last_heartbeat = time(nullptr); 
-        
-        string event = "data: " + json_data + "\n\n";
-        ssize_t sent = send(client_socket, event.c_str(), event.length(), MSG_NOSIGNAL);
-        if (sent < 0) {
-            break;
-        }
-        
-        bool is_complete_now = (json_data.find("\"percent\": 100") != string::npos || 
-                               json_data.find("\"percent\":100") != string::npos ||
-                               json_data.find("\"step\":\"done\"") != string::npos ||
-                               json_data.find("\"step\": \"done\"") != string::npos);
+        return is_complete ? ProgressHub::Verdict::SendAndClose : ProgressHub::Verdict::Send;
+    };
+}
 
-        if (is_complete_now) {
-            usleep(500000);
-            break;
-        }
-        
-        usleep(50000);
+ProgressHub::Snapshot read_auto_classify_progress() {
+    ProgressHub::Snapshot snapshot;
+    snapshot.exists = read_progress_file(AUTO_CLASSIFY_PROGRESS_FILE, snapshot.data);
+    if (snapshot.data.empty()) {
+        snapshot.data = "{\"percent\":0,\"message\":\"Waiting...\",\"status\":\"idle\"}";
     }
+    return snapshot;
 }
 
-void handle_auto_classify_stream(int client_socket, const string& request) {
-    string header = "HTTP/1.1 200 OK\r\n"
-                   "Content-Type: text/event-stream\r\n"
-                   "Cache-Control: no-cache\r\n"
-                   "Connection: keep-alive\r\n"
-                   "Access-Control-Allow-Origin: *\r\n"
-                   "\r\n";
-    send(client_socket, header.c_str(), header.length(), 0);
+ProgressHub::Verdict auto_classify_filter(const ProgressHub::Snapshot& snapshot) {
+    const string& json = snapshot.data;
+    bool finished = progress_has(json, "status", "completed") || progress_has(json, "status", "paused") ||
+                    progress_has(json, "status", "error");
+    return finished ? ProgressHub::Verdict::SendAndClose : ProgressHub::Verdict::Send;
+}
+
+// Import progress plus the last 4 KB of the import log (while it is recent)
+ProgressHub::Snapshot read_import_progress() {
+    ProgressHub::Snapshot snapshot;
+    string& json_data = snapshot.data;
     
-    string last_sent_data = "";
-    time_t last_heartbeat = time(nullptr);
+    // A completed/stopped file older than 60 s belongs to a previous import
+    struct stat file_stat;
+    if (read_progress_file(IMPORT_PROGRESS_FILE, json_data, &file_stat)) {
+        snapshot.exists = true;
+        snapshot.mtime = file_stat.st_mtim;
+        bool file_is_recent = difftime(time(nullptr), file_stat.st_mtime) < 60;
+        if (!file_is_recent && (progress_has(json_data, "status", "completed") ||
+                                progress_has(json_data, "status", "stopped"))) {
+            json_data = "{\"percent\":0,\"message\":\"Ready to import...\",\"status\":\"idle\"}";
+        }
+    }
     
-    while (true) {
-        string json_data;
-        
-        ifstream file("/tmp/auto_classify_progress.json");
-        if (file.is_open()) {
+    if (json_data.empty()) {
+        json_data = "{\"percent\":0,\"message\":\"Waiting...\",\"status\":\"idle\"}";
+    }
+    
+    string log_tail;
+    struct stat log_stat;
+    if (stat(IMPORT_LOG_FILE, &log_stat) == 0 && difftime(time(nullptr), log_stat.st_mtime) < 60) {
+        ifstream log(IMPORT_LOG_FILE, ios::binary);
+        if (log.is_open()) {
+            log.seekg(max<off_t>(0, log_stat.st_size - 4096));
             stringstream ss;
-            ss << file.rdbuf();
-            json_data = ss.str();
-            file.close();
-        }
-        
-        if (json_data.empty()) {
-            json_data = "{\"percent\":0,\"message\":\"Waiting...\",\"status\":\"idle\"}";
-        }
-        
-        if (json_data != last_sent_data) {
-            string event = "data: " + json_data + "\n\n";
-            ssize_t sent = send(client_socket, event.c_str(), event.length(), MSG_NOSIGNAL);
-            if (sent < 0) break;
-            
-            last_sent_data = json_data;
-            last_heartbeat = time(nullptr);
-            
-            // Check if completed or paused
-            if (json_data.find("\"status\":\"completed\"") != string::npos ||
-                json_data.find("\"status\":\"paused\"") != string::npos ||
-                json_data.find("\"status\":\"error\"") != string::npos) {
-                usleep(500000);
-                break;
-            }
-        } else {
-            if (time(nullptr) - last_heartbeat >= 2) {
-                string heartbeat = ": keep-alive\n\n";
-                if (send(client_socket, heartbeat.c_str(), heartbeat.length(), MSG_NOSIGNAL) < 0) break;
-                last_heartbeat = time(nullptr);
-            }
+            ss << log.rdbuf();
+            log_tail = ss.str();
         }
-        usleep(100000);
     }
+    
+    if (!log_tail.empty() && json_data.back() == '}') {
+        json_data.pop_back();
+        json_data += ",\"log\":\"" + json_escape(log_tail) + "\"}";
+    }
+    return snapshot;
 }
 
-void handle_import_stream(int client_socket, const string& request) {
-    string header = "HTTP/1.1 200 OK\r\n"
-                   "Content-Type: text/event-stream\r\n"
-                   "Cache-Control: no-cache\r\n"
-                   "Connection: keep-alive\r\n"
-                   "Access-Control-Allow-Origin: *\r\n"
-                   "\r\n";
-    send(client_socket, header.c_str(), header.length(), 0);
+ProgressHub::Verdict import_filter(const ProgressHub::Snapshot& snapshot) {
+    const string& json = snapshot.data;
+    bool finished = progress_has(json, "status", "completed") || progress_has(json, "status", "stopped");
+    return finished ? ProgressHub::Verdict::SendAndClose : ProgressHub::Verdict::Send;
+}
+
+bool start_progress_hub() {
+    classify_topic = progress_hub.add_topic({CLASSIFY_PROGRESS_FILE}, read_classify_progress);
+    import_topic = progress_hub.add_topic({IMPORT_PROGRESS_FILE, IMPORT_LOG_FILE}, read_import_progress);
+    auto_classify_topic = progress_hub.add_topic({AUTO_CLASSIFY_PROGRESS_FILE}, read_auto_classify_progress);
+    string error;
+    if (!progress_hub.start(error)) {
+        cerr << "[ERROR] Failed to start progress hub: " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+// Ordinary requests run concurrently, each on its own pooled connection
+// (leased by db() on first use); config changes wait until they have
+// finished. Routes that never call db() work while TDengine is down.
+string handle_request(const string& request, ChunkedResponse* stream = nullptr) {
+    string first_line = request.substr(0, request.find('\n'));
+    vector<string> parts = split(first_line, ' ');
+    if (parts.size() < 2) return "";
     
-    string last_sent_data = "";
-    time_t last_heartbeat = time(nullptr);
-    time_t stream_start_time = time(nullptr);
+    std::shared_lock<std::shared_mutex> shared_config(config_mutex, std::defer_lock);
+    std::unique_lock<std::shared_mutex> exclusive_config(config_mutex, std::defer_lock);
+    if (changes_database_config(parts[0], parts[1])) {
+        exclusive_config.lock();
+    } else {
+        shared_config.lock();
+    }
     
-    while (true) {
-        string json_data;
-        
-        // Check if progress file exists and is recent (within last 60 seconds)
-        struct stat file_stat;
-        bool file_is_recent = false;
-        if (stat("/tmp/import_progress.json", &file_stat) == 0) {
-            file_is_recent = (difftime(time(nullptr), file_stat.st_mtime) < 60);
-        }
-        
-        ifstream file("/tmp/import_progress.json");
-        if (file.is_open()) {
-            stringstream ss;
-            ss << file.rdbuf();
-            json_data = ss.str();
-            file.close();
-            
-            // If file is old and shows completed, treat as idle (waiting for new import)
-            if (!file_is_recent && 
-                (json_data.find("\"status\":\"completed\"") != string::npos ||
-                 json_data.find("\"status\":\"stopped\"") != string::npos)) {
-                json_data = "{\"percent\":0,\"message\":\"Ready to import...\",\"status\":\"idle\"}";
-            }
-        }
-        
-        if (json_data.empty()) {
-            json_data = "{\"percent\":0,\"message\":\"Waiting...\",\"status\":\"idle\"}";
-        }
-        
-        // Read Log Tail (only if log file is recent - within 60 seconds)
-        string log_tail = "";
-        struct stat log_stat;
-        bool log_is_recent = false;
-        if (stat("/tmp/import.log", &log_stat) == 0) {
-            log_is_recent = (difftime(time(nullptr), log_stat.st_mtime) < 60);
-        }
-        
-        if (log_is_recent) {
-            // Read last 4KB bytes to ensure we get the latest progress
-            FILE* pipe = popen("tail -c 4096 /tmp/import.log 2>/dev/null", "r");
-            if (pipe) {
-                char buffer[8192];
-                size_t n = fread(buffer, 1, sizeof(buffer)-1, pipe);
-                if (n > 0) {
-                    buffer[n] = '\0';
-                    log_tail = string(buffer);
-                }
-                pclose(pipe);
-            }
-        }
-        
-        if (!log_tail.empty() && json_data.length() > 0 && json_data.back() == '}') {
-            json_data.pop_back();
-            json_data += ",\"log\":\"" + json_escape(log_tail) + "\"}";
-        }
-        
-        if (json_data != last_sent_data) {
-            string event = "data: " + json_data + "\n\n";
-            ssize_t sent = send(client_socket, event.c_str(), event.length(), MSG_NOSIGNAL);
-            if (sent < 0) break;
-            
-            last_sent_data = json_data;
-            last_heartbeat = time(nullptr);
-            
-            if (json_data.find("\"status\":\"completed\"") != string::npos || 
-                json_data.find("\"status\": \"completed\"") != string::npos ||
-                json_data.find("\"status\":\"stopped\"") != string::npos) {
-                usleep(500000);
-                break;
-            }
-        } else {
-            if (time(nullptr) - last_heartbeat >= 2) {
-                string heartbeat = ": keep-alive\n\n";
-                if (send(client_socket, heartbeat.c_str(), heartbeat.length(), MSG_NOSIGNAL) < 0) break;
-                last_heartbeat = time(nullptr);
-            }
+    // Return the connection before the config lock is released, also
+    // when a route throws
+    struct LeaseRelease {
+        ~LeaseRelease() {
+            request_lease.reset();
+            request_lease_failed = false;
         }
-        usleep(100000);
-    }
+    } release_lease;
+    string response = route_request(request, stream);
+    if (request_lease_failed && !response.empty()) return http::json_error(503, "Database unavailable");
+    return response;
 }
 
-void handle_client(int client_socket) {
-    try {
-        string request;
-        char buffer[8192];
-        
-        int bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-        if (bytes_received <= 0) {
-            close(client_socket);
-            return;
-        }
-        buffer[bytes_received] = '\0';
-        request = string(buffer);
-        
-        cout << "[INFO] Received request: " << request.substr(0, request.find('\n')) << endl;
-        
-        if (request.find("GET /api/classify_stream") != string::npos) {
-            handle_sse_stream(client_socket, request);
-            close(client_socket);
-            return;
-        }
-        
-        if (request.find("GET /api/import/stream") != string::npos) {
-            handle_import_stream(client_socket, request);
-            close(client_socket);
-            return;
-        }
-        
-        if (request.find("GET /api/auto_classify/stream") != string::npos) {
-            handle_auto_classify_stream(client_socket, request);
-            close(client_socket);
-            return;
-        }
-        
-        if (request.find("POST") == 0 || request.find("post") == 0) {
-            size_t cl_pos = request.find("Content-Length:");
-            if (cl_pos == string::npos) cl_pos = request.find("content-length:");
-            
-            int content_length = 0;
-            if (cl_pos != string::npos) {
-                size_t cl_end = request.find("\r\n", cl_pos);
-                string cl_str = request.substr(cl_pos + 15, cl_end - cl_pos - 15);
-                content_length = stoi(cl_str);
-            }
-            
-            size_t body_start = request.find("\r\n\r\n");
-            if (body_start != string::npos) {
-                body_start += 4;
-                int body_received = request.length() - body_start;
-                
-                while (body_received < content_length) {
-                    bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-                    if (bytes_received <= 0) break;
-                    buffer[bytes_received] = '\0';
-                    request += string(buffer);
-                    body_received += bytes_received;
-                }
-            }
-        }
-        
-        string response = handle_request(request);
-        
-        const char* data = response.c_str();
-        size_t total_sent = 0;
-        size_t total_size = response.length();
-        
-        while (total_sent < total_size) {
-            ssize_t sent = send(client_socket, data + total_sent, total_size - total_sent, 0);
-            if (sent < 0) {
-                cerr << "[ERROR] Failed to send response" << endl;
-                break;
-            }
-            total_sent += sent;
+// Runs on an HttpServer worker with one complete request (body included);
+// the connection stays open for the next request unless the client closes it
+HttpServer::Disposition handle_client(int client_socket, string& request) {
+    cout << "[INFO] Received request: " << request.substr(0, request.find('\n')) << endl;
+    
+    // Progress streams are handed to the hub, which owns the socket from now on
+    if (request.find("GET /api/classify_stream") == 0) {
+        progress_hub.subscribe(client_socket, classify_topic, classify_filter(request));
+        return HttpServer::Disposition::Detached;
+    }
+    
+    if (request.find("GET /api/import/stream") == 0) {
+        progress_hub.subscribe(client_socket, import_topic, import_filter);
+        return HttpServer::Disposition::Detached;
+    }
+    
+    if (request.find("GET /api/auto_classify/stream") == 0) {
+        progress_hub.subscribe(client_socket, auto_classify_topic, auto_classify_filter);
+        return HttpServer::Disposition::Detached;
+    }
+    
+    // Every response is length-delimited (or chunked) so the connection can
+    // be reused; HTTP/1.0 clients do not understand chunked bodies
+    bool keep_alive = http_keep_alive(request);
+    bool gzip = http_accepts_gzip(request);
+    string_view request_line = string_view(request).substr(0, request.find("\r\n"));
+    bool http11 = request_line.size() >= 8 && request_line.substr(request_line.size() - 8) == "HTTP/1.1";
+    ChunkedResponse stream(client_socket, keep_alive, gzip);
+    
+    string response = handle_request(request, http11 ? &stream : nullptr);
+    if (stream.started()) {
+        if (!stream.finish()) {
+            if (!stream.aborted()) cerr << "[ERROR] Failed to send response" << endl;
+            return HttpServer::Disposition::Close;
         }
-    } catch (const std::exception& e) {
-        cerr << "[ERROR] Exception handling client: " << e.what() << endl;
-    } catch (...) {
-        cerr << "[ERROR] Unknown exception handling client" << endl;
+        return keep_alive ? HttpServer::Disposition::KeepAlive : HttpServer::Disposition::Close;
     }
+    if (response.empty()) return HttpServer::Disposition::Close;
+    
+    http_compress_response(response, gzip);
+    http_frame_response(response, keep_alive);
+    
+    const char* data = response.c_str();
+    size_t total_sent = 0;
+    size_t total_size = response.length();
     
-    close(client_socket);
+    while (total_sent < total_size) {
+        ssize_t sent = send(client_socket, data + total_sent, total_size - total_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            cerr << "[ERROR] Failed to send response" << endl;
+            return HttpServer::Disposition::Close;
+        }
+        total_sent += sent;
+    }
+    return keep_alive ? HttpServer::Disposition::KeepAlive : HttpServer::Disposition::Close;
 }
 
 int main() {
@@ -2176,59 +2771,37 @@ int main() {
     
     load_config();
     
-    if (!connect_to_database()) {
-        return 1;
-    }
+    HttpServerLimits limits;
+    limits.workers = config.web_workers > 0 ? config.web_workers : 0;
+    limits.max_connections = max(1, config.web_max_connections);
+    limits.max_inflight = max(1, config.web_max_inflight);
     
-    int     server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket < 0) {
-        cerr << "[ERROR] Failed to create socket" << endl;
-        return 1;
-    }
+    HttpServer server(limits, handle_client);
+    lightcurve_cache = make_unique<ShardedQueryCache<string>>((size_t)max(0, config.lightcurve_cache_mb) << 20);
     
-    // Prevent child processes (like importers) from inheriting the socket
-    int flags = fcntl(server_socket, F_GETFD);
-    if (flags != -1) {
-        fcntl(server_socket, F_SETFD, flags | FD_CLOEXEC);
+    // A worker handles one request at a time, so it never waits for a
+    // connection; the extra one loads the object catalog
+    db_pool_size = config.db_connections > 0 ? config.db_connections : server.limits().workers + 1;
+    if (!connect_to_database()) {
+        return 1;
     }
-    
-    int opt = 1;
-    setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
-    setsockopt(server_socket, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
-    
-    struct sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(config.web_port);
-    
-    if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        cerr << "[ERROR] Failed to bind port " << config.web_port << ": " << strerror(errno) << endl;
+    current_catalog();
+    if (!start_progress_hub()) {
         return 1;
     }
     
-    if (listen(server_socket, 128) < 0) {
-        cerr << "[ERROR] Failed to listen" << endl;
+    string error;
+    if (!server.listen(config.web_host, config.web_port, error)) {
+        cerr << "[ERROR] Failed to start server: " << error << endl;
         return 1;
     }
     
-    cout << "[INFO] Web API listening on port " << config.web_port << endl;
+    cout << "[INFO] Web API listening on port " << config.web_port
+         << " (" << server.limits().workers << " workers, max " << limits.max_connections
+         << " connections, " << limits.max_inflight << " in flight)" << endl;
     
-    while (true) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        
-        int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
-        if (client_socket < 0) {
-            cerr << "[ERROR] Failed to accept connection" << endl;
-            continue;
-        }
-        
-        thread client_thread(handle_client, client_socket);
-        client_thread.detach();
-    }
+    server.run();
     
-    close(server_socket);
-    taos_close(conn);
+    db_pool.reset();
     return 0;
 }
\ No newline at end of file